@@ -29,6 +29,9 @@
 #include "runway.hxx"
 #include "output.hxx"
 
+// further than clustering ( 2.5e-6 deg ) or finger extension ( 5 m ) reach
+#define GENAPT_CLEAN_CELL_OVERLAP   (0.0001)
+
 Airport::Airport( int c, char* def)
 {
     int   numParams;
@@ -124,6 +127,13 @@ Airport::Airport( int c, char* def)
         
         sprintf(ig_ds, "%s_runways", icao.c_str() ); 
         rm_ig = new tgIntersectionGenerator(ig_ds, 0, 0, LinearFeature::GetTextureInfo );
+
+        // only the linear features are cleaned, so only they are partitioned
+        if ( clean_cell_size > 0.0 ) {
+            for ( unsigned int i=0; i<8; i++ ) {
+                lf_ig[i]->SetCleanPartitions( clean_cell_size, GENAPT_CLEAN_CELL_OVERLAP, clean_cell_threads );
+            }
+        }
     }
 
     TG_LOG( SG_GENERAL, SG_DEBUG, "Read airport with icao " << icao << ", control tower " << ct << ", and description " << description );
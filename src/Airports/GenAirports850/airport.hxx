@@ -102,6 +102,21 @@ public:
         return features.size();
     }
 
+    int NumRunways( void )
+    {
+        return runways.size();
+    }
+
+    int NumPavements( void )
+    {
+        return pavements.size();
+    }
+
+    int NumTaxiways( void )
+    {
+        return taxiways.size();
+    }
+
     void AddBoundary( ClosedPoly* bndry )
     {
         boundary.push_back( bndry );
@@ -0,0 +1,421 @@
+// apt_index.cxx -- persistent icao / position index of an apt.dat file
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <zlib.h>
+
+#include <simgear/debug/logstream.hxx>
+#include <simgear/io/lowlevel.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+#include "airport.hxx"
+#include "helipad.hxx"
+#include "parser.hxx"
+#include "runway.hxx"
+#include "apt_index.hxx"
+
+// bytes at the head of apt.dat that are hashed into the stamp - the
+// header lines carry the data cycle and build date
+#define APT_INDEX_HASH_BYTES    (64*1024)
+
+static const int32_t apt_index_magic = 0x54474149; // 'TGAI'
+
+bool AptIndexEntry::IsInside( const tgRectangle& rect ) const
+{
+    if ( anchors.empty() || !bounds.intersects( rect ) ) {
+        return false;
+    }
+
+    for ( unsigned int i = 0; i < anchors.size(); i++ ) {
+        if ( rect.isInside( anchors[i] ) ) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool AptIndex::GetStamp( const std::string& datafile, FileStamp& stamp )
+{
+    struct stat st;
+
+    if ( stat( datafile.c_str(), &st ) != 0 ) {
+        return false;
+    }
+
+    stamp.size  = (long)st.st_size;
+    stamp.mtime = (long)st.st_mtime;
+
+    std::ifstream in( datafile.c_str(), std::ios::binary );
+    if ( !in.is_open() ) {
+        return false;
+    }
+
+    std::vector<char> head( APT_INDEX_HASH_BYTES );
+    in.read( &head[0], head.size() );
+
+    // FNV-1a
+    stamp.hash = 2166136261u;
+    for ( std::streamsize i = 0; i < in.gcount(); i++ ) {
+        stamp.hash = ( stamp.hash ^ (unsigned char)head[i] ) * 16777619u;
+    }
+
+    return true;
+}
+
+bool AptIndex::Open( const std::string& datafile, const std::string& indexfile )
+{
+    FileStamp stamp;
+
+    if ( !GetStamp( datafile, stamp ) ) {
+        TG_LOG( SG_GENERAL, SG_ALERT, "Cannot open file: " << datafile );
+        return false;
+    }
+
+    if ( !indexfile.empty() && Load( indexfile, stamp ) ) {
+        TG_LOG( SG_GENERAL, SG_INFO, "Loaded index of " << entries.size() << " airports from " << indexfile );
+    } else {
+        SGTimeStamp start = SGTimeStamp::now();
+
+        if ( !Build( datafile ) ) {
+            return false;
+        }
+
+        TG_LOG( SG_GENERAL, SG_INFO, "Indexed " << entries.size() << " airports in " << datafile << " in " << ( SGTimeStamp::now() - start ) );
+
+        if ( !indexfile.empty() && !Save( indexfile, stamp ) ) {
+            TG_LOG( SG_GENERAL, SG_WARN, "Could not save apt.dat index to " << indexfile );
+        }
+    }
+
+    BuildLookup();
+
+    return true;
+}
+
+void AptIndex::BuildLookup( void )
+{
+    byIcao.clear();
+
+    // keep the first definition of an icao, as the linear search did
+    for ( unsigned int i = 0; i < entries.size(); i++ ) {
+        byIcao.insert( std::make_pair( entries[i].icao, i ) );
+    }
+}
+
+const AptIndexEntry* AptIndex::Find( const std::string& icao ) const
+{
+    std::map<std::string, unsigned int>::const_iterator it = byIcao.find( icao );
+
+    if ( it == byIcao.end() ) {
+        return NULL;
+    }
+
+    return &entries[it->second];
+}
+
+static bool EntryBefore( const AptIndexEntry& e, long pos )
+{
+    return e.pos < pos;
+}
+
+void AptIndex::Find( const tgRectangle& rect, long start_pos, std::vector<const AptIndexEntry*>& list ) const
+{
+    std::vector<AptIndexEntry>::const_iterator it;
+
+    it = std::lower_bound( entries.begin(), entries.end(), start_pos, EntryBefore );
+    for ( ; it != entries.end(); ++it ) {
+        if ( it->IsInside( rect ) ) {
+            list.push_back( &(*it) );
+        }
+    }
+}
+
+static void AddAnchor( AptIndexEntry& e, const SGGeod& p )
+{
+    if ( e.anchors.empty() ) {
+        e.bounds = tgRectangle( p, p );
+    } else {
+        e.bounds.expandBy( p );
+    }
+    e.anchors.push_back( p );
+}
+
+bool AptIndex::Build( const std::string& datafile )
+{
+    std::ifstream in( datafile.c_str(), std::ios::binary );
+    if ( !in.is_open() ) {
+        TG_LOG( SG_GENERAL, SG_ALERT, "Cannot open file: " << datafile );
+        return false;
+    }
+
+    std::string     str;
+    char            line[2048];
+    long            cur_pos = 0;
+    AptIndexEntry*  cur     = NULL;
+
+    entries.clear();
+
+    while ( std::getline( in, str ) ) {
+        long line_pos = cur_pos;
+
+        // getline doesn't count the newline it consumed
+        cur_pos += str.size() + ( in.eof() ? 0 : 1 );
+
+        strncpy( line, str.c_str(), sizeof(line)-1 );
+        line[sizeof(line)-1] = '\0';
+
+        char* def = &line[0];
+        char* tok = strtok( def, " \t\r\n" );
+
+        if ( !tok ) {
+            continue;
+        }
+
+        def += strlen(tok)+1;
+        int code = atoi(tok);
+
+        if ( code == LAND_AIRPORT_CODE || code == SEA_AIRPORT_CODE || code == HELIPORT_CODE ) {
+            if ( cur ) {
+                cur->length = line_pos - cur->pos;
+            }
+
+            Airport airport( code, def );
+
+            entries.push_back( AptIndexEntry() );
+            cur = &entries.back();
+
+            cur->icao = airport.GetIcao();
+            cur->code = code;
+            cur->pos  = line_pos;
+            continue;
+        }
+
+        if ( code == END_OF_FILE ) {
+            if ( cur ) {
+                cur->length = line_pos - cur->pos;
+                cur = NULL;
+            }
+            break;
+        }
+
+        // anything before the first airport is the file header
+        if ( !cur ) {
+            continue;
+        }
+
+        cur->numLines++;
+
+        switch ( code ) {
+            case LAND_RUNWAY_CODE:
+            {
+                Runway runway( NULL, def );
+                AddAnchor( *cur, runway.GetStart() );
+                AddAnchor( *cur, runway.GetEnd() );
+                cur->numRunways++;
+            }
+            break;
+
+            case WATER_RUNWAY_CODE:
+            {
+                WaterRunway runway( def );
+                AddAnchor( *cur, runway.GetStart() );
+                AddAnchor( *cur, runway.GetEnd() );
+                cur->numWaterRunways++;
+            }
+            break;
+
+            case HELIPAD_CODE:
+            {
+                Helipad helipad( def );
+                AddAnchor( *cur, helipad.GetLoc() );
+                cur->numHelipads++;
+            }
+            break;
+
+            case TAXIWAY_CODE:
+                cur->numTaxiways++;
+                break;
+
+            case PAVEMENT_CODE:
+                cur->numPavements++;
+                break;
+
+            case LINEAR_FEATURE_CODE:
+                cur->numFeatures++;
+                break;
+
+            case BOUNDRY_CODE:
+                cur->numBoundaries++;
+                break;
+
+            case NODE_CODE:
+            case BEZIER_NODE_CODE:
+            case CLOSE_NODE_CODE:
+            case CLOSE_BEZIER_NODE_CODE:
+            case TERM_NODE_CODE:
+            case TERM_BEZIER_NODE_CODE:
+                cur->numNodes++;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    // no end of file marker
+    if ( cur ) {
+        cur->length = cur_pos - cur->pos;
+    }
+
+    return true;
+}
+
+bool AptIndex::Save( const std::string& indexfile, const FileStamp& stamp ) const
+{
+    gzFile fp;
+
+    if ( (fp = gzopen( indexfile.c_str(), "wb1" )) == NULL ) {
+        return false;
+    }
+
+    sgClearWriteError();
+
+    sgWriteLong( fp, apt_index_magic );
+    sgWriteInt( fp, APT_INDEX_VERSION );
+    sgWriteLongLong( fp, stamp.size );
+    sgWriteLongLong( fp, stamp.mtime );
+    sgWriteUInt( fp, stamp.hash );
+    sgWriteUInt( fp, entries.size() );
+
+    for ( unsigned int i = 0; i < entries.size(); i++ ) {
+        const AptIndexEntry& e = entries[i];
+
+        sgWriteString( fp, e.icao.c_str() );
+        sgWriteInt( fp, e.code );
+        sgWriteLongLong( fp, e.pos );
+        sgWriteLongLong( fp, e.length );
+
+        sgWriteInt( fp, e.numRunways );
+        sgWriteInt( fp, e.numWaterRunways );
+        sgWriteInt( fp, e.numHelipads );
+        sgWriteInt( fp, e.numTaxiways );
+        sgWriteInt( fp, e.numPavements );
+        sgWriteInt( fp, e.numFeatures );
+        sgWriteInt( fp, e.numBoundaries );
+        sgWriteInt( fp, e.numNodes );
+        sgWriteInt( fp, e.numLines );
+
+        // the bounds are recalculated on load
+        sgWriteUInt( fp, e.anchors.size() );
+        for ( unsigned int j = 0; j < e.anchors.size(); j++ ) {
+            sgWriteGeod( fp, e.anchors[j] );
+        }
+    }
+
+    gzclose( fp );
+
+    if ( sgWriteError() ) {
+        std::remove( indexfile.c_str() );
+        return false;
+    }
+
+    return true;
+}
+
+bool AptIndex::Load( const std::string& indexfile, const FileStamp& stamp )
+{
+    gzFile fp;
+
+    if ( (fp = gzopen( indexfile.c_str(), "rb" )) == NULL ) {
+        return false;
+    }
+
+    sgClearReadError();
+
+    int32_t      magic;
+    int          version;
+    int64_t      size, mtime;
+    unsigned int hash, count;
+
+    sgReadLong( fp, &magic );
+    sgReadInt( fp, &version );
+    sgReadLongLong( fp, &size );
+    sgReadLongLong( fp, &mtime );
+    sgReadUInt( fp, &hash );
+    sgReadUInt( fp, &count );
+
+    if ( sgReadError() || magic != apt_index_magic || version != APT_INDEX_VERSION ||
+         size != stamp.size || mtime != stamp.mtime || hash != stamp.hash ) {
+        TG_LOG( SG_GENERAL, SG_INFO, "Index " << indexfile << " is out of date" );
+        gzclose( fp );
+        return false;
+    }
+
+    entries.clear();
+    entries.resize( count );
+
+    for ( unsigned int i = 0; i < count && !sgReadError(); i++ ) {
+        AptIndexEntry& e = entries[i];
+        char*          strbuff = NULL;
+        int64_t        pos, length;
+        unsigned int   num_anchors = 0;
+
+        sgReadString( fp, &strbuff );
+        if ( strbuff ) {
+            e.icao = strbuff;
+            delete[] strbuff;
+        }
+        sgReadInt( fp, &e.code );
+        sgReadLongLong( fp, &pos );
+        sgReadLongLong( fp, &length );
+        e.pos    = (long)pos;
+        e.length = (long)length;
+
+        sgReadInt( fp, &e.numRunways );
+        sgReadInt( fp, &e.numWaterRunways );
+        sgReadInt( fp, &e.numHelipads );
+        sgReadInt( fp, &e.numTaxiways );
+        sgReadInt( fp, &e.numPavements );
+        sgReadInt( fp, &e.numFeatures );
+        sgReadInt( fp, &e.numBoundaries );
+        sgReadInt( fp, &e.numNodes );
+        sgReadInt( fp, &e.numLines );
+
+        sgReadUInt( fp, &num_anchors );
+        for ( unsigned int j = 0; j < num_anchors && !sgReadError(); j++ ) {
+            SGGeod p;
+            sgReadGeod( fp, p );
+            AddAnchor( e, p );
+        }
+    }
+
+    gzclose( fp );
+
+    if ( sgReadError() ) {
+        TG_LOG( SG_GENERAL, SG_WARN, "Index " << indexfile << " is corrupt" );
+        entries.clear();
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,109 @@
+// apt_index.hxx -- persistent icao / position index of an apt.dat file
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+
+#ifndef _APT_INDEX_HXX_
+#define _APT_INDEX_HXX_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <simgear/math/SGMath.hxx>
+#include <terragear/tg_rectangle.hxx>
+
+// Finding an airport, or the airports in an area, used to mean reading
+// the whole apt.dat - over 300 MB for the global file - once per request.
+// The index is built with a single pass over the file, and saved next to
+// it.  Later runs load the index instead, as long as the size, mtime and
+// a hash of the head of apt.dat still match.
+//
+// Each entry holds the position and length of the airport record, the
+// runway ends and helipads used for area selection ( and their bounding
+// box ), and the number of records of each type.
+
+#define APT_INDEX_VERSION   (1)
+
+class AptIndexEntry
+{
+public:
+    AptIndexEntry() : code(0), pos(0), length(0),
+        numRunways(0), numWaterRunways(0), numHelipads(0),
+        numTaxiways(0), numPavements(0), numFeatures(0),
+        numBoundaries(0), numNodes(0), numLines(0)
+    {
+    }
+
+    // true if a runway end or helipad is inside the rectangle - the same
+    // test a full scan of the file makes
+    bool IsInside( const tgRectangle& rect ) const;
+
+    std::string         icao;
+    int                 code;       // land, sea or heliport
+    long                pos;        // of the airport line
+    long                length;     // up to the next airport line
+
+    tgRectangle         bounds;     // of the anchors
+    std::vector<SGGeod> anchors;    // runway ends and helipads
+
+    int                 numRunways;
+    int                 numWaterRunways;
+    int                 numHelipads;
+    int                 numTaxiways;
+    int                 numPavements;
+    int                 numFeatures;
+    int                 numBoundaries;
+    int                 numNodes;
+    int                 numLines;
+};
+
+class AptIndex
+{
+public:
+    AptIndex() {}
+
+    // load the index for datafile from indexfile, or rebuild it ( and
+    // try to save it ) if it is missing or out of date.
+    bool Open( const std::string& datafile, const std::string& indexfile );
+
+    // the first airport with this icao - NULL if it is not in the file
+    const AptIndexEntry* Find( const std::string& icao ) const;
+
+    // the airports at or after start_pos with a runway end or helipad in
+    // rect, in file order
+    void Find( const tgRectangle& rect, long start_pos, std::vector<const AptIndexEntry*>& list ) const;
+
+    unsigned int size( void ) const { return entries.size(); }
+
+private:
+    struct FileStamp {
+        long                size;
+        long                mtime;
+        unsigned int        hash;
+    };
+
+    static bool GetStamp( const std::string& datafile, FileStamp& stamp );
+
+    bool Build( const std::string& datafile );
+    bool Load( const std::string& indexfile, const FileStamp& stamp );
+    bool Save( const std::string& indexfile, const FileStamp& stamp ) const;
+
+    void BuildLookup( void );
+
+    std::vector<AptIndexEntry>                  entries;    // in file order
+    std::map<std::string, unsigned int>         byIcao;
+};
+
+#endif
@@ -0,0 +1,179 @@
+// apt_reader.cxx -- line readers for apt.dat
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+
+#include <string.h>
+#include <stdio.h>
+
+#ifndef _MSC_VER
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#endif
+
+#include <simgear/debug/logstream.hxx>
+
+#include "apt_reader.hxx"
+
+AptMappedFile::AptMappedFile() :
+    base( NULL ),
+    length( 0 ),
+    mapped( false )
+{
+}
+
+AptMappedFile::~AptMappedFile()
+{
+    Close();
+}
+
+bool AptMappedFile::Open( const std::string& filename )
+{
+    Close();
+
+#ifndef _MSC_VER
+    int fd = ::open( filename.c_str(), O_RDONLY );
+    if ( fd < 0 ) {
+        TG_LOG( SG_GENERAL, SG_ALERT, "Cannot open file: " << filename );
+        return false;
+    }
+
+    struct stat st;
+    if ( fstat( fd, &st ) == 0 && st.st_size > 0 ) {
+        void* p = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if ( p != MAP_FAILED ) {
+            base   = static_cast<const char*>( p );
+            length = st.st_size;
+            mapped = true;
+
+            // parsers jump from airport to airport, but each airport is
+            // read front to back
+            madvise( p, st.st_size, MADV_WILLNEED );
+        }
+    }
+    ::close( fd );
+#endif
+
+    // no mmap ( or it failed ) - read the whole file instead
+    if ( !base ) {
+        FILE* fp = fopen( filename.c_str(), "rb" );
+        if ( !fp ) {
+            TG_LOG( SG_GENERAL, SG_ALERT, "Cannot open file: " << filename );
+            return false;
+        }
+
+        fseek( fp, 0, SEEK_END );
+        long size = ftell( fp );
+        fseek( fp, 0, SEEK_SET );
+
+        if ( size > 0 ) {
+            buffer.resize( size );
+            if ( fread( &buffer[0], size, 1, fp ) == 1 ) {
+                base   = &buffer[0];
+                length = size;
+            }
+        }
+        fclose( fp );
+    }
+
+    return base != NULL;
+}
+
+void AptMappedFile::Close( void )
+{
+#ifndef _MSC_VER
+    if ( mapped && base ) {
+        munmap( const_cast<char*>( base ), length );
+    }
+#endif
+
+    buffer.clear();
+    base   = NULL;
+    length = 0;
+    mapped = false;
+}
+
+AptReader* AptReader::Create( const std::string& filename, const AptMappedFile* mapped )
+{
+    if ( mapped ) {
+        return new AptMappedReader( *mapped );
+    } else {
+        return new AptStreamReader( filename );
+    }
+}
+
+bool AptReader::GetLine( char* line, int size )
+{
+    const char* begin;
+    const char* end;
+
+    if ( !GetLine( begin, end ) ) {
+        line[0] = '\0';
+        return false;
+    }
+
+    // truncate lines that don't fit, like istream::getline
+    long len = ( end - begin < size-1 ) ? ( end - begin ) : size-1;
+    memcpy( line, begin, len );
+    line[len] = '\0';
+
+    return true;
+}
+
+void AptStreamReader::Seek( long pos )
+{
+    in.clear();
+    in.seekg( pos, std::ios::beg );
+}
+
+bool AptStreamReader::GetLine( const char*& begin, const char*& end )
+{
+    // only a read at the end gets nothing, not even the newline
+    if ( !std::getline( in, buffer ) ) {
+        return false;
+    }
+
+    begin = buffer.c_str();
+    end   = begin + buffer.size();
+
+    return true;
+}
+
+bool AptMappedReader::GetLine( const char*& begin, const char*& end )
+{
+    const char* data = file.GetData();
+    long        size = file.GetSize();
+
+    if ( cur >= size ) {
+        return false;
+    }
+
+    const char* start = data + cur;
+    const char* nl    = static_cast<const char*>( memchr( start, '\n', size - cur ) );
+
+    if ( nl ) {
+        begin = start;
+        end   = nl;
+        cur  += ( nl - start ) + 1;
+    } else {
+        tail.assign( start, size - cur );
+        begin = tail.c_str();
+        end   = begin + tail.size();
+        cur   = size;
+    }
+
+    return true;
+}
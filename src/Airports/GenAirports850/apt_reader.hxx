@@ -0,0 +1,105 @@
+// apt_reader.hxx -- line readers for apt.dat
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+
+#ifndef _APT_READER_HXX_
+#define _APT_READER_HXX_
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+// apt.dat mapped into memory once, and shared read only by every parser.
+// Where mmap is not available the file is read into memory instead.
+class AptMappedFile
+{
+public:
+    AptMappedFile();
+    ~AptMappedFile();
+
+    bool        Open( const std::string& filename );
+    void        Close( void );
+
+    const char* GetData( void ) const   { return base; }
+    long        GetSize( void ) const   { return length; }
+
+private:
+    // not copyable
+    AptMappedFile( const AptMappedFile& );
+    AptMappedFile& operator=( const AptMappedFile& );
+
+    const char*         base;
+    long                length;
+    bool                mapped;
+    std::vector<char>   buffer;
+};
+
+// Each parser reads its airports through a reader.  GetLine returns the
+// next line, without the newline, as a read only span - straight from the
+// mapping where there is one.  The span is always followed by a newline or
+// a NUL, so strtod and strtol stop at its end.  Records that are tokenized
+// in place with strtok are copied into the parser's buffer instead.
+class AptReader
+{
+public:
+    virtual ~AptReader() {}
+
+    virtual bool IsOpen( void ) const = 0;
+    virtual void Seek( long pos ) = 0;
+
+    // false once the end of the file is reached
+    virtual bool GetLine( const char*& begin, const char*& end ) = 0;
+
+    // the next line copied, and truncated, into line
+    bool GetLine( char* line, int size );
+
+    // a mapped reader if the file is mapped, an ifstream otherwise
+    static AptReader* Create( const std::string& filename, const AptMappedFile* mapped );
+};
+
+class AptStreamReader : public AptReader
+{
+public:
+    AptStreamReader( const std::string& filename ) : in( filename.c_str() ) {}
+
+    virtual bool IsOpen( void ) const   { return in.is_open(); }
+    virtual void Seek( long pos );
+    virtual bool GetLine( const char*& begin, const char*& end );
+    using AptReader::GetLine;
+
+private:
+    std::ifstream   in;
+    std::string     buffer;
+};
+
+class AptMappedReader : public AptReader
+{
+public:
+    AptMappedReader( const AptMappedFile& f ) : file( f ), cur( 0 ) {}
+
+    virtual bool IsOpen( void ) const   { return file.GetData() != NULL; }
+    virtual void Seek( long pos )       { cur = pos; }
+    virtual bool GetLine( const char*& begin, const char*& end );
+    using AptReader::GetLine;
+
+private:
+    const AptMappedFile&    file;
+    long                    cur;
+
+    // a last line without a newline, copied so it can be NUL terminated
+    std::string             tail;
+};
+
+#endif
@@ -29,9 +29,15 @@
 extern int nudge;
 
 // Each polygon vertex is snapped to a grid with this resolution (~1cm by default)
-extern double gSnap;
+// Per thread, so a parser can retry an airport with a larger snap
+extern thread_local double gSnap;
 
 extern double slope_max;
 extern double slope_eps;
 
+// Linear feature networks are cleaned in cells of this size ( degrees ) on
+// clean_cell_threads threads.  0 cleans each network in one arrangement
+extern double       clean_cell_size;
+extern unsigned int clean_cell_threads;
+
 #endif
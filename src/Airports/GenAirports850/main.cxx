@@ -25,6 +25,9 @@
 
 #include <Include/version.h>
 
+#include <terragear/tg_array_cache.hxx>
+#include <terragear/tg_polygon.hxx>
+
 #include "scheduler.hxx"
 #include "beznode.hxx"
 #include "closedpoly.hxx"
@@ -37,10 +40,11 @@ using namespace std;
 // Display usage
 static void usage( int argc, char **argv ) {
     TG_LOG(SG_GENERAL, SG_ALERT, "Usage: " << argv[0] << "\n--input=<apt_file>"
-    << "\n--work=<work_dir>\n[ --start-id=abcd ] [ --restart-id=abcd ] [ --nudge=n ] "
+    << "\n--work=<work_dir>\n[ --index=<index_file> ] [ --start-id=abcd ] [ --restart-id=abcd ] [ --nudge=n ] "
     << "[--min-lon=<deg>] [--max-lon=<deg>] [--min-lat=<deg>] [--max-lat=<deg>] "
     << "[ --airport=abcd ] [--max-slope=<decimal>] [--tile=<tile>] [--threads] [--threads=x]"
-    << "[--chunk=<chunk>] [--dem-path=<path>] [--verbose] [--help]");
+    << "[--chunk=<chunk>] [--dem-path=<path>] [--retries=n] [--retry-backoff=<sec>] [--summary=<csv_file>] [--mmap] [--parse-only] "
+    << "[--clean-cells=<deg>] [--clean-cell-threads=n] [--verbose] [--help]");
 }
 
 // Display help and usage
@@ -68,6 +72,17 @@ static void help( int argc, char **argv, const string_list& elev_src ) {
     cout << "\nAn input area may be specified by lat and lon extent using min and max lat and lon.  \n";
     cout << "Alternatively, you may specify a chunk (10 x 10 degrees) or tile (1 x 1 degree) using a string \n";
     cout << "such as eg. w080n40, e000s27.  \n";
+    cout << "\nThe position and extent of every airport in the input file is indexed on the first run, and the \n";
+    cout << "index is saved to <apt_file>.idx, or the file given with --index=.  Later runs reuse it until \n";
+    cout << "the input file changes.\n";
+    cout << "\nAn airport that fails to build is retried with twice the snap up to --retries times, waiting \n";
+    cout << "--retry-backoff seconds ( doubled each attempt ) first.  The result, timings and any failure \n";
+    cout << "reason of every airport are written to the csv file given with --summary.\n";
+    cout << "\nWith --mmap the input file is mapped into memory once and shared by all threads, instead of \n";
+    cout << "each thread reading it through its own stream.  --parse-only reads the selected airports \n";
+    cout << "without building them, and reports the number of records parsed per second.\n";
+    cout << "\nWith --clean-cells the linear feature networks are cleaned in square cells of the given size \n";
+    cout << "in degrees, on --clean-cell-threads threads each, instead of in one arrangement.  \n";
     cout << "\nAn input file containing only a subset of the world's \n";
     cout << "airports may of course be used.\n";
     cout << "\n\n";
@@ -85,9 +100,11 @@ static void help( int argc, char **argv, const string_list& elev_src ) {
 
 // TODO: where do these belong
 int nudge = 10;
-double gSnap = 0.00000001;      // approx 1 mm
+thread_local double gSnap = 0.00000001;      // approx 1 mm
 double slope_max = 0.02;
 double slope_eps = 0.00001;
+double       clean_cell_size    = 0.0;
+unsigned int clean_cell_threads = 1;
 
 int main(int argc, char **argv)
 {
@@ -111,12 +128,17 @@ int main(int argc, char **argv)
     // parse arguments
     std::string work_dir = "";
     std::string input_file = "";
+    std::string index_file = "";
     std::string summary_file = "./genapt850.csv";
     std::string start_id = "";
     std::string restart_id = "";
     std::string airport_id = "";
     std::string last_apt_file = "./last_apt.txt";
     int         num_threads    =  1;
+    int         num_retries    =  GENAPT_DEFAULT_RETRIES;
+    double      retry_backoff  =  GENAPT_DEFAULT_BACKOFF;
+    bool        use_mmap       =  false;
+    bool        parse_only     =  false;
 
     int arg_pos;
     for (arg_pos = 1; arg_pos < argc; arg_pos++)
@@ -130,6 +152,10 @@ int main(int argc, char **argv)
         {
             input_file = arg.substr(8);
         }
+        else if ( arg.find("--index=") == 0 )
+        {
+            index_file = arg.substr(8);
+        }
         else if ( arg.find("--start-id=") == 0 )
         {
             start_id = arg.substr(11);
@@ -190,6 +216,34 @@ int main(int argc, char **argv)
         {
             num_threads = boost::thread::hardware_concurrency();
         }
+        else if ( (arg.find("--retries=") == 0) )
+        {
+            num_retries = atoi( arg.substr(10).c_str() );
+        }
+        else if ( (arg.find("--retry-backoff=") == 0) )
+        {
+            retry_backoff = atof( arg.substr(16).c_str() );
+        }
+        else if ( (arg.find("--summary=") == 0) )
+        {
+            summary_file = arg.substr(10);
+        }
+        else if ( arg == "--mmap" )
+        {
+            use_mmap = true;
+        }
+        else if ( arg.find("--clean-cells=") == 0 )
+        {
+            clean_cell_size = atof( arg.substr(14).c_str() );
+        }
+        else if ( arg.find("--clean-cell-threads=") == 0 )
+        {
+            clean_cell_threads = atoi( arg.substr(21).c_str() );
+        }
+        else if ( arg == "--parse-only" )
+        {
+            parse_only = true;
+        }
         else if (arg.find("--debug-dir=") == 0)
         {
             debug_dir = arg.substr(12);
@@ -260,6 +314,11 @@ int main(int argc, char **argv)
         exit(-1);
     }
 
+    if ( index_file == "" )
+    {
+        index_file = input_file + ".idx";
+    }
+
     if ( elev_src.empty() )
     {
         TG_LOG( SG_GENERAL, SG_WARN,  "Warning: no elevation source - airport will be at sea level." );
@@ -284,7 +343,15 @@ int main(int argc, char **argv)
     }
 
     // Create the scheduler
-    Scheduler* scheduler = new Scheduler(input_file, work_dir, elev_src);
+    Scheduler* scheduler = new Scheduler(input_file, index_file, work_dir, elev_src);
+
+    scheduler->SetRetries( num_retries, retry_backoff );
+    scheduler->SetParseOnly( parse_only );
+
+    if ( use_mmap && !scheduler->SetMappedInput() )
+    {
+        TG_LOG( SG_GENERAL, SG_WARN, "Could not map " << input_file << " - reading it as a stream" );
+    }
 
     // Add any debug 
     scheduler->set_debug( debug_dir, debug_runway_defs, debug_pavement_defs, debug_taxiway_defs, debug_feature_defs );
@@ -325,6 +392,9 @@ int main(int argc, char **argv)
         }
     }
 
+    tgArrayCache::instance().logStats();
+    tgPolygon::LogTesselateStats();
+
     TG_LOG(SG_GENERAL, SG_INFO, "Genapts finished successfully");
 
     return 0;
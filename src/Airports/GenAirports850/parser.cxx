@@ -1,9 +1,14 @@
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <exception>
 
 #include <simgear/debug/logstream.hxx>
 #include <simgear/misc/sgstream.hxx>
 #include <simgear/timing/timestamp.hxx>
 
+#include "global.hxx"
 #include "parser.hxx"
 
 bool Parser::GetAirportDefinition( char* line, std::string& icao )
@@ -170,6 +175,8 @@ void Parser::set_debug( std::string path, std::vector<std::string> runway_defs,
 void Parser::run()
 {
     char line[2048];
+    const char* begin;
+    const char* end;
     std::string icao;
 
     SGTimeStamp parse_start;
@@ -181,54 +188,69 @@ void Parser::run()
     time_t      log_time;
     long        pos;
 
-    std::ifstream in( filename.c_str() );
-    if ( !in.is_open() ) 
+    AptReader* in = AptReader::Create( filename, scheduler->GetMappedInput() );
+    if ( !in->IsOpen() )
     {
         TG_LOG( SG_GENERAL, SG_ALERT, "Cannot open file: " << filename );
         exit(-1);
     }
 
     // as long as we have airports to parse, do so
-    while (!global_workQueue.empty()) {
-        AirportInfo ai = global_workQueue.pop();
-
+    AirportInfo ai;
+    while ( scheduler->GetAirport( ai ) ) {
         if ( ai.GetIcao() == "NZSP" ) {
+            scheduler->AirportFailed( ai, "excluded", false );
             continue;
         }
 
         DebugRegisterPrefix( ai.GetIcao() );
         pos = ai.GetPos();
-        in.seekg(pos, std::ios::beg);
+        in->Seek(pos);
 
         // get a line
-        in.getline(line, 2048);
+        in->GetLine(line, sizeof(line));
 
         // Verify this is and airport definition and get the icao
-        if( GetAirportDefinition( line, icao ) ) {
-            TG_LOG( SG_GENERAL, SG_INFO, "Found airport " << icao << " at " << pos );
+        if( !GetAirportDefinition( line, icao ) ) {
+            TG_LOG( SG_GENERAL, SG_INFO, "Not an airport at pos " << pos << " line is: " << line );
+            scheduler->AirportFailed( ai, "not an airport definition", false );
+            continue;
+        }
+
+        TG_LOG( SG_GENERAL, SG_INFO, "Found airport " << icao << " at " << pos );
+
+        // retries are built with a larger snap
+        gSnap = ai.GetSnap();
 
+        try {
             // Start parse at pos
             SetState(STATE_NONE);
-            in.clear();
 
             parse_start.stamp();
             log_time = time(0);
             TG_LOG( SG_GENERAL, SG_ALERT, "\n*******************************************************************" );
             TG_LOG( SG_GENERAL, SG_ALERT, "Start airport " << icao << " at " << pos << ": start time " << ctime(&log_time) );
 
-            in.seekg(pos, std::ios::beg);
-            while ( !in.eof() && (cur_state != STATE_DONE ) ) {
-                in.getline(line, 2048);
-
+            in->Seek(pos);
+            while ( (cur_state != STATE_DONE) && in->GetLine(begin, end) ) {
                 // Parse the line
-                ParseLine(line);
+                ParseLine(begin, end);
+                numRecords++;
             }
 
             parse_end.stamp();
             parse_time = parse_end - parse_start;
+            ai.SetParseTime( parse_time );
 
             // write the airport BTG
             if (cur_airport) {
+                ai.SetRunways( cur_airport->NumRunways() );
+                ai.SetPavements( cur_airport->NumPavements() );
+                ai.SetFeats( cur_airport->NumFeatures() );
+                ai.SetTaxiways( cur_airport->NumTaxiways() );
+            }
+
+            if (cur_airport && !scheduler->GetParseOnly()) {
                 cur_airport->set_debug( debug_path, debug_runways, debug_pavements, debug_taxiways, debug_features );
                 TG_LOG( SG_GENERAL, SG_ALERT, "Build Airport " << icao );
 
@@ -238,21 +260,129 @@ void Parser::run()
                 cur_airport->GetCleanupTime( clean_time );
                 cur_airport->GetTriangulationTime( triangulation_time );
 
-                delete cur_airport;
-                cur_airport = NULL;
+                ai.SetBuildTime( build_time );
+                ai.SetCleanTime( clean_time );
+                ai.SetTessTime( triangulation_time );
             }
 
-            log_time = time(0);
-            TG_LOG( SG_GENERAL, SG_ALERT, "Finished airport " << icao << 
-                " : parse " << parse_time << " : build " << build_time << 
-                " : clean " << clean_time << " : tesselate " << triangulation_time );
-        } else {
-            TG_LOG( SG_GENERAL, SG_INFO, "Not an airport at pos " << pos << " line is: " << line );  
+            Reset();
+        } catch ( std::exception& e ) {
+            Reset();
+            scheduler->AirportFailed( ai, e.what(), true );
+            continue;
+        } catch ( ... ) {
+            Reset();
+            scheduler->AirportFailed( ai, "unknown exception", true );
+            continue;
         }
+
+        log_time = time(0);
+        TG_LOG( SG_GENERAL, SG_ALERT, "Finished airport " << icao <<
+            " : parse " << parse_time << " : build " << build_time <<
+            " : clean " << clean_time << " : tesselate " << triangulation_time );
+
+        scheduler->AirportComplete( ai );
+    }
+
+    delete in;
+}
+
+// forget the current airport, built or not.  Everything added to the
+// airport is owned, and deleted, by it.  The parser only owns what it
+// hasn't handed over yet :
+//  - cur_pavement and cur_boundary, until the state changes
+//  - cur_feat, until its close or termination node
+//  - prev_node, until the next node - or a close node - adds it
+// the other cur_ pointers are only references into the airport.
+void Parser::Reset( void )
+{
+    delete cur_pavement;
+    delete cur_boundary;
+    delete cur_feat;
+    delete prev_node;
+    delete cur_airport;
+
+    cur_airport     = NULL;
+    cur_runway      = NULL;
+    cur_waterrunway = NULL;
+    cur_helipad     = NULL;
+    cur_taxiway     = NULL;
+    cur_pavement    = NULL;
+    cur_boundary    = NULL;
+    cur_feat        = NULL;
+    cur_object      = NULL;
+    cur_windsock    = NULL;
+    cur_beacon      = NULL;
+    cur_sign        = NULL;
+    prev_node       = NULL;
+    cur_state       = STATE_NONE;
+}
+
+// The next number of a record.  Only spaces and tabs are skipped, so a
+// short record doesn't run into the next line - the readers end every line
+// with a newline or NUL, so strtod and strtol stop there.
+static bool NextDouble( const char*& p, const char* end, double& val )
+{
+    while ( p < end && ( *p == ' ' || *p == '\t' ) ) {
+        p++;
+    }
+    if ( p >= end || isspace( *p ) ) {
+        return false;
+    }
+
+    char* next;
+    val = strtod( p, &next );
+    if ( next == p ) {
+        return false;
+    }
+    p = next;
+
+    return true;
+}
+
+static bool NextInt( const char*& p, const char* end, int& val )
+{
+    while ( p < end && ( *p == ' ' || *p == '\t' ) ) {
+        p++;
+    }
+    if ( p >= end || isspace( *p ) ) {
+        return false;
+    }
+
+    char* next;
+    val = strtol( p, &next, 10 );
+    if ( next == p ) {
+        return false;
+    }
+    p = next;
+
+    return true;
+}
+
+// the number of values read, like sscanf
+static int ScanNode( const char* p, const char* end, bool hasCtrl, double& lat, double& lon, double& ctrl_lat, double& ctrl_lon, int& feat_type1, int& feat_type2 )
+{
+    int numParams = 0;
+
+    if ( !NextDouble( p, end, lat ) )                   return numParams;
+    numParams++;
+    if ( !NextDouble( p, end, lon ) )                   return numParams;
+    numParams++;
+    if ( hasCtrl ) {
+        if ( !NextDouble( p, end, ctrl_lat ) )          return numParams;
+        numParams++;
+        if ( !NextDouble( p, end, ctrl_lon ) )          return numParams;
+        numParams++;
     }
+    if ( !NextInt( p, end, feat_type1 ) )               return numParams;
+    numParams++;
+    if ( !NextInt( p, end, feat_type2 ) )               return numParams;
+    numParams++;
+
+    return numParams;
 }
 
-BezNode* Parser::ParseNode( int type, char* line, BezNode* prevNode )
+BezNode* Parser::ParseNode( int type, const char* line, const char* end, BezNode* prevNode )
 {
     double lat, lon;
     double ctrl_lat, ctrl_lon;
@@ -308,7 +438,7 @@ BezNode* Parser::ParseNode( int type, char* line, BezNode* prevNode )
     // parse the line
     if (hasCtrl)
     {
-        numParams = sscanf(line, "%lf %lf %lf %lf %d %d", &lat, &lon, &ctrl_lat, &ctrl_lon, &feat_type1, &feat_type2);
+        numParams = ScanNode(line, end, true, lat, lon, ctrl_lat, ctrl_lon, feat_type1, feat_type2);
         if (numParams > 4)
         {
             hasFeat1 = true;
@@ -320,7 +450,7 @@ BezNode* Parser::ParseNode( int type, char* line, BezNode* prevNode )
     }
     else
     {
-        numParams = sscanf(line, "%lf %lf %d %d", &lat, &lon, &feat_type1, &feat_type2);
+        numParams = ScanNode(line, end, false, lat, lon, ctrl_lat, ctrl_lon, feat_type1, feat_type2);
         if (numParams > 2)
         {
             hasFeat1 = true;
@@ -486,13 +616,197 @@ int Parser::SetState( int state )
 }
 
 // TODO: This should be a loop here, and main should just pass the file name and airport code...
-int Parser::ParseLine(char* line)
+int Parser::ParseLine( const char* begin, const char* end )
 {
-    char*  tok;
-    int    code;
+    const char* p = begin;
+    int         code;
+
+    // comments and blank lines
+    if ( !NextInt( p, end, code ) ) {
+        return cur_state;
+    }
+
+    // skip the separator, like the strtok below
+    if ( p < end ) {
+        p++;
+    }
 
+    // the nodes are most of the file, so they are read straight from the
+    // line.  everything else is tokenized in place, on a copy
+    switch ( code )
+    {
+        case NODE_CODE:
+        case BEZIER_NODE_CODE:
+        case CLOSE_NODE_CODE:
+        case CLOSE_BEZIER_NODE_CODE:
+        case TERM_NODE_CODE:
+        case TERM_BEZIER_NODE_CODE:
+            ParseNodeRecord( code, p, end );
+            break;
+
+        default:
+        {
+            char line[2048];
+            long len = ( end - begin < (long)sizeof(line)-1 ) ? ( end - begin ) : sizeof(line)-1;
+
+            memcpy( line, begin, len );
+            line[len] = '\0';
+
+            ParseRecord( line );
+            break;
+        }
+    }
+
+    return cur_state;
+}
+
+void Parser::ParseNodeRecord( int code, const char* line, const char* end )
+{
     BezNode* cur_node = NULL;
 
+    switch(code)
+    {
+        case NODE_CODE:
+        case BEZIER_NODE_CODE:
+            TG_LOG(SG_GENERAL, SG_DEBUG, "Parsing node: " << std::string(line, end));
+            cur_node = ParseNode( code, line, end, prev_node );
+
+            if ( prev_node && (cur_node != prev_node) )
+            {
+                // prev node is done - process it
+                if ( cur_state == STATE_PARSE_PAVEMENT )
+                {
+                    cur_pavement->AddNode( prev_node );
+                }
+                else if ( cur_state == STATE_PARSE_FEATURE )
+                {
+                    cur_feat->AddNode( prev_node );
+                }
+                else if ( cur_state == STATE_PARSE_BOUNDARY )
+                {
+                    cur_boundary->AddNode( prev_node );
+                }
+                else
+                {
+                    // a node outside of any shape
+                    delete prev_node;
+                }
+            }
+
+            prev_node = cur_node;
+            break;
+
+        case CLOSE_NODE_CODE:
+        case CLOSE_BEZIER_NODE_CODE:
+            TG_LOG(SG_GENERAL, SG_DEBUG, "Parsing close loop node: " << std::string(line, end));
+            cur_node = ParseNode( code, line, end, prev_node );
+
+            if ( cur_state == STATE_PARSE_PAVEMENT && prev_node )
+            {
+                if (cur_node != prev_node)
+                {
+                    cur_pavement->AddNode( prev_node );
+                    cur_pavement->AddNode( cur_node );
+                }
+                else
+                {
+                    cur_pavement->AddNode( cur_node );
+                }
+                cur_pavement->CloseCurContour( cur_airport );
+            }
+            else if ( cur_state == STATE_PARSE_BOUNDARY )
+            {
+                if (cur_node != prev_node)
+                {
+                    cur_boundary->AddNode( prev_node );
+                    cur_boundary->AddNode( cur_node );
+                }
+                else
+                {
+                    cur_boundary->AddNode( cur_node );
+                }
+                cur_boundary->CloseCurContour( cur_airport );
+            }
+            else if ( cur_state == STATE_PARSE_FEATURE )
+            {
+                if (cur_node != prev_node)
+                {
+                    cur_feat->AddNode( prev_node );
+                    cur_feat->AddNode( cur_node );
+                }
+                else
+                {
+                    cur_feat->AddNode( cur_node );
+                }
+                if (cur_airport)
+                {
+                    cur_feat->Finish( cur_airport, true );
+                    cur_airport->AddFeature( cur_feat );
+                }
+                else
+                {
+                    delete cur_feat;
+                }
+                cur_feat = NULL;
+                SetState( STATE_PARSE_SIMPLE );
+            }
+            prev_node = NULL;
+            cur_node  = NULL;
+            break;
+
+        case TERM_NODE_CODE:
+        case TERM_BEZIER_NODE_CODE:
+            TG_LOG(SG_GENERAL, SG_DEBUG, "Parsing termination node: " << std::string(line, end));
+
+            if ( cur_state == STATE_PARSE_FEATURE )
+            {
+                // we have some bad data - termination nodes right after the
+                // linear feature declaration - can't do anything with a
+                // single point - detect and delete.
+                if ( prev_node )
+                {
+                    cur_node = ParseNode( code, line, end, prev_node );
+
+                    if (cur_node != prev_node)
+                    {
+                        cur_feat->AddNode( prev_node );
+                        cur_feat->AddNode( cur_node );
+                    }
+                    else
+                    {
+                        cur_feat->AddNode( cur_node );
+                    }
+                    if (cur_airport)
+                    {
+                        cur_feat->Finish( cur_airport, false );
+                        cur_airport->AddFeature( cur_feat );
+                    }
+                    else
+                    {
+                        delete cur_feat;
+                    }
+                }
+                else
+                {
+                    TG_LOG(SG_GENERAL, SG_ALERT, "Parsing termination node with no previous nodes!!!" );
+
+                    // this feature is bogus...
+                    delete cur_feat;
+                }
+                cur_feat = NULL;
+                SetState( STATE_PARSE_SIMPLE );
+            }
+            prev_node = NULL;
+            cur_node  = NULL;
+            break;
+    }
+}
+
+void Parser::ParseRecord( char* line )
+{
+    char*  tok;
+    int    code;
+
     if (*line != '#')
     {
         // Get the number code
@@ -577,6 +891,11 @@ int Parser::ParseLine(char* line)
                     break;
     
                 case LINEAR_FEATURE_CODE:
+                    // a feature without a close or termination node is dropped
+                    delete cur_feat;
+                    delete prev_node;
+                    prev_node = NULL;
+
                     SetState( STATE_PARSE_FEATURE );
                     TG_LOG(SG_GENERAL, SG_DEBUG, "Linear Feature: " << line);
                     cur_feat = ParseFeature( line );
@@ -588,127 +907,6 @@ int Parser::ParseLine(char* line)
                     cur_boundary = ParseBoundary( line ); 
                     break;
     
-                case NODE_CODE:
-                case BEZIER_NODE_CODE:
-                    TG_LOG(SG_GENERAL, SG_DEBUG, "Parsing node: " << line);
-                    cur_node = ParseNode( code, line, prev_node );
-    
-                    if ( prev_node && (cur_node != prev_node) )
-                    {
-                        // prev node is done - process it
-                        if ( cur_state == STATE_PARSE_PAVEMENT )
-                        {
-                            cur_pavement->AddNode( prev_node );
-                        }
-                        else if ( cur_state == STATE_PARSE_FEATURE )
-                        {
-                            cur_feat->AddNode( prev_node );
-                        }
-                        else if ( cur_state == STATE_PARSE_BOUNDARY )
-                        {
-                            cur_boundary->AddNode( prev_node );
-                        }
-                    }
-
-                    prev_node = cur_node;
-                    break;
-    
-                case CLOSE_NODE_CODE:
-                case CLOSE_BEZIER_NODE_CODE:
-                    TG_LOG(SG_GENERAL, SG_DEBUG, "Parsing close loop node: " << line);
-                    cur_node = ParseNode( code, line, prev_node );
-
-                    if ( cur_state == STATE_PARSE_PAVEMENT && prev_node )
-                    {
-                        if (cur_node != prev_node)
-                        {
-                            cur_pavement->AddNode( prev_node );
-                            cur_pavement->AddNode( cur_node );
-                        }
-                        else
-                        {
-                            cur_pavement->AddNode( cur_node );
-                        }
-                        cur_pavement->CloseCurContour( cur_airport );
-                    }
-                    else if ( cur_state == STATE_PARSE_BOUNDARY )
-                    {
-                        if (cur_node != prev_node)
-                        {
-                            cur_boundary->AddNode( prev_node );
-                            cur_boundary->AddNode( cur_node );
-                        }
-                        else
-                        {
-                            cur_boundary->AddNode( cur_node );
-                        }
-                        cur_boundary->CloseCurContour( cur_airport );
-                    }
-                    else if ( cur_state == STATE_PARSE_FEATURE )
-                    {
-                        if (cur_node != prev_node)
-                        {
-                            cur_feat->AddNode( prev_node );
-                            cur_feat->AddNode( cur_node );
-                        }
-                        else
-                        {
-                            cur_feat->AddNode( cur_node );
-                        }
-                        if (cur_airport)
-                        {
-                            cur_feat->Finish( cur_airport, true );
-                            cur_airport->AddFeature( cur_feat );
-                        }
-                        cur_feat = NULL;
-                        SetState( STATE_PARSE_SIMPLE );
-                    }
-                    prev_node = NULL;
-                    cur_node  = NULL;
-                    break;
-    
-                case TERM_NODE_CODE:
-                case TERM_BEZIER_NODE_CODE:
-                    TG_LOG(SG_GENERAL, SG_DEBUG, "Parsing termination node: " << line);
-    
-                    if ( cur_state == STATE_PARSE_FEATURE )
-                    {
-                        // we have some bad data - termination nodes right after the
-                        // linear feature declaration - can't do anything with a
-                        // single point - detect and delete.
-                        if ( prev_node )
-                        {
-                            cur_node = ParseNode( code, line, prev_node );
-    
-                            if (cur_node != prev_node)
-                            {
-                                cur_feat->AddNode( prev_node );
-                                cur_feat->AddNode( cur_node );
-                            }
-                            else
-                            {
-                                cur_feat->AddNode( cur_node );
-                            }
-                            if (cur_airport)
-                            {
-                                cur_feat->Finish( cur_airport, false );
-                                cur_airport->AddFeature( cur_feat );
-                            }
-                        }
-                        else
-                        {
-                            TG_LOG(SG_GENERAL, SG_ALERT, "Parsing termination node with no previous nodes!!!" );
-    
-                            // this feature is bogus...
-                            delete cur_feat;
-                        }
-                        cur_feat = NULL;
-                        SetState( STATE_PARSE_SIMPLE );
-                    }
-                    prev_node = NULL;
-                    cur_node  = NULL;
-                    break;
-    
                 case AIRPORT_VIEWPOINT_CODE:
                     SetState( STATE_PARSE_SIMPLE );
                     TG_LOG(SG_GENERAL, SG_DEBUG, "Parsing viewpoint: " << line);
@@ -776,6 +974,4 @@ int Parser::ParseLine(char* line)
             }
         }
     }
-    
-    return cur_state;
 }
@@ -63,9 +63,11 @@
 class Parser : public SGThread
 {
 public:
-    Parser(const std::string& datafile, const std::string& debug, const std::string& root, const string_list& elev_src )
+    Parser(Scheduler* sched, const std::string& datafile, const std::string& debug, const std::string& root, const string_list& elev_src )
     {
+        scheduler       = sched;
         filename        = datafile;
+        numRecords      = 0;
         debug_path      = debug;
         work_dir        = root;
         elevation       = elev_src;
@@ -92,6 +94,9 @@ public:
                                                  std::vector<std::string> taxiway_defs,
                                                  std::vector<std::string> feature_defs );
 
+    // apt.dat lines parsed so far
+    unsigned long   GetNumRecords( void ) const { return numRecords; }
+
 private:
     virtual void    run();
 
@@ -99,17 +104,22 @@ private:
     bool            GetAirportDefinition( char* line, std::string& icao );
 
     int             SetState( int state );
+    void            Reset( void );
 
-    BezNode*        ParseNode( int type, char* line, BezNode* prevNode );
+    BezNode*        ParseNode( int type, const char* line, const char* end, BezNode* prevNode );
     LinearFeature*  ParseFeature( char* line );
     ClosedPoly*     ParsePavement( char* line );
     ClosedPoly*     ParseBoundary( char* line );
 
-    int             ParseLine( char* line );
+    int             ParseLine( const char* begin, const char* end );
+    void            ParseNodeRecord( int code, const char* line, const char* end );
+    void            ParseRecord( char* line );
 
+    Scheduler*      scheduler;
     BezNode*        prev_node;
     int             cur_state;
     std::string     filename;
+    unsigned long   numRecords;
     string_list     elevation;
     std::string     work_dir;
 
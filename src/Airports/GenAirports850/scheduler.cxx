@@ -1,20 +1,20 @@
-#ifdef _MSC_VER
-#  include <windows.h>
-#  define sleep(x) Sleep(x*1000)
-#endif
-
+#include <algorithm>
 #include <cstring>
 
 #include <simgear/debug/logstream.hxx>
 #include <simgear/misc/sgstream.hxx>
+#include <simgear/threads/SGGuard.hxx>
 
 #include "airport.hxx"
+#include "global.hxx"
 #include "parser.hxx"
 #include "scheduler.hxx"
 
-extern double gSnap;
 
-SGLockedQueue<AirportInfo> global_workQueue;
+const char* AirportInfo::GetReportHeader( void )
+{
+    return "icao,runways,pavements,features,taxiways,parse,build,clean,tesselate,total,snap,attempts,status,error";
+}
 
 std::ostream& operator<< (std::ostream &out, const AirportInfo &ai)
 {
@@ -41,9 +41,18 @@ std::ostream& operator<< (std::ostream &out, const AirportInfo &ai)
     out << ",";
     out << ai.parseTime+ai.buildTime+ai.cleanTime+ai.tessTime;
     out << ",";
-    out << snap_string,
+    out << snap_string;
+    out << ",";
+    out << ai.numAttempts;
     out << ",";
-    out << ai.errString;
+    out << ai.status;
+    out << ",";
+
+    // keep the error in one csv field
+    std::string err = ai.errString;
+    std::replace( err.begin(), err.end(), ',', ';' );
+    std::replace( err.begin(), err.end(), '\n', ' ' );
+    out << err;
 
     return out;  // MSVC
 }
@@ -175,342 +184,238 @@ void Scheduler::set_debug( std::string path, std::vector<std::string> runway_def
     }
 }
 
-bool Scheduler::IsAirportDefinition( char* line, std::string icao )
+void Scheduler::AddAirport( std::string icao )
 {
-    char*    tok;
-    int      code;
-    bool     match = false;
+    const AptIndexEntry* e = index.Find( icao );
 
-    // Get the number code
-    tok = strtok(line, " \t\r\n");
-
-    if (tok)
+    TG_LOG( SG_GENERAL, SG_INFO, "Adding airport " << icao << " to parse list");
+    if ( e )
     {
-        line += strlen(tok)+1;
-        code = atoi(tok);
-
-        switch(code)
-        {
-            case LAND_AIRPORT_CODE:
-            case SEA_AIRPORT_CODE:
-            case HELIPORT_CODE:
-            {
-                Airport ap( code, line );
-                if ( ap.GetIcao() == icao )
-                {
-                    match = true;
-                }
-            }
-                break;
+        TG_LOG( SG_GENERAL, SG_DEBUG, "Found airport " << icao << " at " << e->pos );
 
-            case LAND_RUNWAY_CODE:
-            case WATER_RUNWAY_CODE:
-            case HELIPAD_CODE:
-            case PAVEMENT_CODE:
-            case LINEAR_FEATURE_CODE:
-            case BOUNDRY_CODE:
-            case NODE_CODE:
-            case BEZIER_NODE_CODE:
-            case CLOSE_NODE_CODE:
-            case CLOSE_BEZIER_NODE_CODE:
-            case TERM_NODE_CODE:
-            case TERM_BEZIER_NODE_CODE:
-            case AIRPORT_VIEWPOINT_CODE:
-            case AIRPLANE_STARTUP_LOCATION_CODE:
-            case LIGHT_BEACON_CODE:
-            case WINDSOCK_CODE:
-            case TAXIWAY_SIGN:
-            case LIGHTING_OBJECT:
-            case COMM_FREQ1_CODE:
-            case COMM_FREQ2_CODE:
-            case COMM_FREQ3_CODE:
-            case COMM_FREQ4_CODE:
-            case COMM_FREQ5_CODE:
-            case COMM_FREQ6_CODE:
-            case COMM_FREQ7_CODE:
-            case END_OF_FILE :
-                break;
-        }
+        workQueue.push_back( AirportInfo( icao, e->pos, gSnap ) );
+    }
+    else
+    {
+        TG_LOG( SG_GENERAL, SG_ALERT, "Airport " << icao << " not found in " << filename );
     }
-
-    return match;
 }
 
-void Scheduler::AddAirport( std::string icao )
+long Scheduler::FindAirport( std::string icao )
 {
-    char            line[2048];
-    long            cur_pos;
-    bool            found = false;
-    AirportInfo     ai;
+    const AptIndexEntry* e = index.Find( icao );
 
-    std::ifstream in( filename.c_str() );
-    if ( !in.is_open() )
+    TG_LOG( SG_GENERAL, SG_DEBUG, "Finding airport " << icao );
+    if ( e )
     {
-        TG_LOG( SG_GENERAL, SG_ALERT, "Cannot open file: " << filename );
-        exit(-1);
+        TG_LOG( SG_GENERAL, SG_DEBUG, "Found airport " << icao << " at " << e->pos );
+        return e->pos;
     }
-
-    TG_LOG( SG_GENERAL, SG_INFO, "Adding airport " << icao << " to parse list");
-    while ( !in.eof() && !found )
+    else
     {
-        // remember the position of this line
-        cur_pos = in.tellg();
+        return 0;
+    }
+}
 
-        // get a line
-    	in.getline(line, 2048);
+bool Scheduler::AddAirports( long start_pos, tgRectangle* boundingBox )
+{
+    std::vector<const AptIndexEntry*> found;
 
-        // this is and airport definition - remember it
-        if ( IsAirportDefinition( line, icao ) )
-        {
-            TG_LOG( SG_GENERAL, SG_DEBUG, "Found airport " << icao << " at " << cur_pos );
+    // push all airports from start_pos on where a runway start or end
+    // lies within the given min/max coordinates
+    index.Find( *boundingBox, start_pos, found );
 
-            ai = AirportInfo( icao, cur_pos, gSnap );
-            global_workQueue.push( ai );
+    for ( unsigned int i = 0; i < found.size(); i++ )
+    {
+        // Start off with given snap value
+        workQueue.push_back( AirportInfo( found[i]->icao, found[i]->pos, gSnap ) );
+    }
 
-            found = true;
-        }
+    // did we add airports to the parse list?
+    if ( !workQueue.empty() ) {
+        return true;
+    } else {
+        return false;
     }
 }
 
-long Scheduler::FindAirport( std::string icao )
+Scheduler::Scheduler(std::string& datafile, const std::string& indexfile, const std::string& root, const string_list& elev_src)
 {
-    char line[2048];
-    long cur_pos = 0;
-    bool found = false;
+    filename        = datafile;
+    work_dir        = root;
+    elevation       = elev_src;
 
-    std::ifstream in( filename.c_str() );
-    if ( !in.is_open() )
+    mapped          = false;
+    parseOnly       = false;
+    maxRetries      = GENAPT_DEFAULT_RETRIES;
+    retryBackoff    = GENAPT_DEFAULT_BACKOFF;
+    numActive       = 0;
+    numComplete     = 0;
+    numFailed       = 0;
+    numRetries      = 0;
+
+    // loads the index, or builds it with one pass over the file
+    if ( !index.Open( filename, indexfile ) )
     {
-        TG_LOG( SG_GENERAL, SG_ALERT, "Cannot open file: " << filename );
         exit(-1);
     }
+}
 
-    TG_LOG( SG_GENERAL, SG_DEBUG, "Finding airport " << icao );
-    while ( !in.eof() && !found )
+void Scheduler::SetRetries( int max_retries, double backoff )
+{
+    maxRetries   = max_retries;
+    retryBackoff = backoff;
+}
+
+bool Scheduler::SetMappedInput( void )
+{
+    mapped = mappedFile.Open( filename );
+
+    if ( mapped )
     {
-        // remember the position of this line
-        cur_pos = in.tellg();
+        TG_LOG( SG_GENERAL, SG_INFO, "Mapped " << filename << " ( " << mappedFile.GetSize() / (1024*1024) << " MB )" );
+    }
 
-        // get a line
-    	in.getline(line, 2048);
+    return mapped;
+}
+
+bool Scheduler::GetAirport( AirportInfo& ai )
+{
+    SGGuard<SGMutex> g(mutex);
 
-        // this is and airport definition - remember it
-        if ( IsAirportDefinition( line, icao ) )
+    while ( true )
+    {
+        if ( !workQueue.empty() )
         {
-            TG_LOG( SG_GENERAL, SG_DEBUG, "Found airport " << line << " at " << cur_pos );
-            found = true;
+            ai = workQueue.front();
+            workQueue.pop_front();
+            break;
         }
+
+        if ( !retryQueue.empty() )
+        {
+            SGTimeStamp now = SGTimeStamp::now();
+            SGTimeStamp due = retryQueue.top().GetRetryTime();
+
+            if ( !(now < due) )
+            {
+                ai = retryQueue.top();
+                retryQueue.pop();
+                break;
+            }
+
+            // sleep until the backoff expires, or a parser reports back
+            workReady.wait( mutex, (unsigned)( (due - now).toMSecs() ) + 1 );
+            continue;
+        }
+
+        // nothing queued, and nothing running that could be retried
+        if ( numActive == 0 )
+        {
+            workReady.broadcast();
+            return false;
+        }
+
+        workReady.wait( mutex );
     }
 
-	if (found)
-	{
-		return cur_pos;
-	}
-	else
-	{
-		return 0;
-	}
-}
+    ai.IncreaseAttempts();
+    ai.SetStatus( "running" );
+    numActive++;
 
-void Scheduler::RetryAirport( AirportInfo* pai )
-{
-    // retryList.push_back( *pai );
+    return true;
 }
 
-bool Scheduler::AddAirports( long start_pos, tgRectangle* boundingBox )
+void Scheduler::AirportComplete( AirportInfo& ai )
 {
-    char 	 line[2048];
-    char*	 def;
-    long 	 cur_pos;
-    long	 cur_apt_pos = 0;
-    std::string  cur_apt_name;
-    char*    tok;
-    int      code;
-    bool 	 match;
-    bool 	 done;
-
-    done  = false;
-    match = false;
-
-    // start from current position, and push all airports where a runway start or end
-    // lies within the given min/max coordinates
+    SGGuard<SGMutex> g(mutex);
 
-    std::ifstream in( filename.c_str() );
-    if ( !in.is_open() )
-    {
-        TG_LOG( SG_GENERAL, SG_ALERT, "Cannot open file: " << filename );
-        exit(-1);
-    }
+    ai.SetStatus( "ok" );
+    Report( ai );
 
-    if (start_pos)
-    {
-        in.seekg(start_pos, std::ios::beg);
-    }
+    numComplete++;
+    numActive--;
 
-    while (!done)
-    {
-        // remember the position of this line
-        cur_pos = in.tellg();
+    // the parsers waiting for retries may be able to exit now
+    workReady.broadcast();
+}
 
-        // get a line
-        in.getline(line, 2048);
-        def = &line[0];
+void Scheduler::AirportFailed( AirportInfo& ai, const std::string& reason, bool retry )
+{
+    SGGuard<SGMutex> g(mutex);
 
-        // Get the number code
-        tok = strtok(def, " \t\r\n");
+    ai.SetErrorString( reason );
 
-        if (tok)
-        {
-            def += strlen(tok)+1;
-            code = atoi(tok);
+    if ( retry && ai.GetAttempts() <= maxRetries )
+    {
+        double delay = retryBackoff * (double)( 1 << ( ai.GetAttempts() - 1 ) );
 
-            switch(code)
-            {
-                case LAND_AIRPORT_CODE:
-                case SEA_AIRPORT_CODE:
-                case HELIPORT_CODE:
-                {
-                    Airport* airport = new Airport( code, def );
-                    if (match)
-                    {
-                        // Start off with given snap value
-                        AirportInfo ai = AirportInfo( cur_apt_name, cur_apt_pos, gSnap );
-                        global_workQueue.push( ai );
-                    }
-                    // remember this new apt pos and name, and clear match
-                    cur_apt_pos  = cur_pos;
-                    cur_apt_name = airport->GetIcao();
-                    delete airport;
-
-                    match = false;
-                }
-                break;
+        TG_LOG( SG_GENERAL, SG_ALERT, "Airport " << ai.GetIcao() << " failed: " << reason << " - retrying in " << delay << " s" );
 
-                case END_OF_FILE:
-                    if (match)
-                    {
-                        // Start off with given snap value
-                        AirportInfo ai = AirportInfo( cur_apt_name, cur_apt_pos, gSnap );
-                        global_workQueue.push( ai );
-                    }
-                    done = true;
-                    break;
-
-                case LAND_RUNWAY_CODE:
-                    // if the the runway start / end  coords are within the rect,
-                    // we have a winner
-                    {
-                        Runway* runway = new Runway(NULL, def);
-                        if ( boundingBox->isInside(runway->GetStart()) ) {
-                            match = true;
-                        }
-                        else if ( boundingBox->isInside(runway->GetEnd()) ) {
-                            match = true;
-                        }
-                        delete runway;
-                    }
-                    break;
-
-                case WATER_RUNWAY_CODE:
-                    // if the the runway start / end  coords are within the rect,
-                    // we have a winner
-                    {
-                        WaterRunway* runway = new WaterRunway(def);
-                        if ( boundingBox->isInside(runway->GetStart()) ) {
-                            match = true;
-                        }
-                        else if ( boundingBox->isInside(runway->GetEnd()) ) {
-                            match = true;
-                        }
-                        delete runway;
-                    }
-                    break;
-
-                case HELIPAD_CODE:
-                    // if the heliport coords are within the rect, we have
-                    // a winner
-                    {
-                        Helipad* helipad = new Helipad(def);
-                        if ( boundingBox->isInside(helipad->GetLoc()) ) {
-                            match = true;
-                        }
-                        delete helipad;
-                    }
-                    break;
-
-                case TAXIWAY_CODE:
-                case PAVEMENT_CODE:
-                case LINEAR_FEATURE_CODE:
-                case BOUNDRY_CODE:
-                case NODE_CODE:
-                case BEZIER_NODE_CODE:
-                case CLOSE_NODE_CODE:
-                case CLOSE_BEZIER_NODE_CODE:
-                case TERM_NODE_CODE:
-                case TERM_BEZIER_NODE_CODE:
-                case AIRPORT_VIEWPOINT_CODE:
-                case AIRPLANE_STARTUP_LOCATION_CODE:
-                case LIGHT_BEACON_CODE:
-                case WINDSOCK_CODE:
-                case TAXIWAY_SIGN:
-                case LIGHTING_OBJECT:
-                case COMM_FREQ1_CODE:
-                case COMM_FREQ2_CODE:
-                case COMM_FREQ3_CODE:
-                case COMM_FREQ4_CODE:
-                case COMM_FREQ5_CODE:
-                case COMM_FREQ6_CODE:
-                case COMM_FREQ7_CODE:
-                    break;
-            }
-        }
+        ai.IncreaseSnap();
+        ai.SetStatus( "retry" );
+        ai.SetRetryTime( SGTimeStamp::now() + SGTimeStamp::fromSec( delay ) );
+        retryQueue.push( ai );
+        numRetries++;
     }
+    else
+    {
+        TG_LOG( SG_GENERAL, SG_ALERT, "Airport " << ai.GetIcao() << " failed: " << reason );
 
-    // did we add airports to the parse list?
-    if ( global_workQueue.size() ) {
-        return true;
-    } else {
-        return false;
+        ai.SetStatus( "failed" );
+        Report( ai );
+        numFailed++;
     }
+
+    numActive--;
+    workReady.broadcast();
 }
 
-Scheduler::Scheduler(std::string& datafile, const std::string& root, const string_list& elev_src)
+// mutex must be held
+void Scheduler::Report( AirportInfo& ai )
 {
-    filename        = datafile;
-    work_dir        = root;
-    elevation       = elev_src;
-
-    std::ifstream in( filename.c_str() );
-    if ( !in.is_open() )
+    if ( report.is_open() )
     {
-        TG_LOG( SG_GENERAL, SG_ALERT, "Cannot open file: " << filename );
-        exit(-1);
+        report << ai << std::endl;
     }
 }
 
 void Scheduler::Schedule( int num_threads, std::string& summaryfile )
 {
-//    std::ofstream   csvfile;
+    report.open( summaryfile.c_str(), std::ios_base::out | std::ios_base::trunc );
+    if ( report.is_open() )
+    {
+        report << AirportInfo::GetReportHeader() << std::endl;
+    }
+    else
+    {
+        TG_LOG( SG_GENERAL, SG_WARN, "Cannot open summary file " << summaryfile );
+    }
 
-    // open and truncate the summary file : monitor only appends
-//    csvfile.open( summaryfile.c_str(), std::ios_base::out | std::ios_base::trunc );
-//    csvfile.close();
+    TG_LOG( SG_GENERAL, SG_INFO, "Scheduling " << workQueue.size() << " airports on " << num_threads << " threads" );
+
+    SGTimeStamp start = SGTimeStamp::now();
 
     std::vector<Parser *> parsers;
     for (int i=0; i<num_threads; i++) {
-        Parser* parser = new Parser( filename, debug_path, work_dir, elevation );
-        // parser->set_debug();
+        Parser* parser = new Parser( this, filename, debug_path, work_dir, elevation );
         parser->start();
         parsers.push_back( parser );
     }
 
-    while (!global_workQueue.empty()) {
-        sleep(1);
-    }
-
-    // Then wait until they are finished
+    // the parsers exit once every airport is done
+    unsigned long num_records = 0;
     for (unsigned int i=0; i<parsers.size(); i++) {
         parsers[i]->join();
+        num_records += parsers[i]->GetNumRecords();
         delete parsers[i];
     }
+
+    double elapsed = ( SGTimeStamp::now() - start ).toSecs();
+    TG_LOG( SG_GENERAL, SG_ALERT, "Scheduler: parsed " << num_records << " records from " << ( mapped ? "mapped" : "streamed" ) <<
+                                  " input in " << elapsed << " s ( " << ( elapsed > 0.0 ? num_records / elapsed : 0.0 ) << " records/s )" );
+
+    report.close();
+
+    TG_LOG( SG_GENERAL, SG_ALERT, "Scheduler: " << numComplete << " airports complete, " << numFailed << " failed, " << numRetries << " retries - see " << summaryfile );
 }
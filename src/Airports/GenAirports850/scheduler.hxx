@@ -4,14 +4,18 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <deque>
+#include <queue>
+#include <vector>
 
 #include <simgear/compiler.h>
 #include <simgear/math/sg_types.hxx>
 #include <simgear/timing/timestamp.hxx>
 #include <simgear/threads/SGThread.hxx>
-#include <simgear/threads/SGQueue.hxx>
 #include <terragear/tg_rectangle.hxx>
 #include "airport.hxx"
+#include "apt_index.hxx"
+#include "apt_reader.hxx"
 
 #define P_STATE_INIT        (0)
 #define P_STATE_PARSE       (1)
@@ -27,6 +31,9 @@
 #define P_STATE_TRIANGULATE_TIME    ( 1*60)
 #define P_STATE_OUTPUT_TIME         (10*60)
 
+#define GENAPT_DEFAULT_RETRIES      (2)
+#define GENAPT_DEFAULT_BACKOFF      (5.0)   // seconds before the first retry
+
 #define GENAPT_PORT                 (12397)
 #define PL_STATE_INIT               (0)
 #define PL_STATE_WAIT_FOR_LAUNCH    (1)
@@ -54,11 +61,16 @@ public:
         numPavements = -1;
         numFeats = -1;
         numTaxiways = -1;
+        numAttempts = 0;
+        status = "queued";
     }
 
     std::string GetIcao( void )                     { return icao; }
     long    GetPos( void )                          { return pos; }
     double  GetSnap( void )                         { return snap; }
+    int     GetAttempts( void )                     { return numAttempts; }
+    const std::string& GetErrorString( void )       { return errString; }
+    const SGTimeStamp& GetRetryTime( void ) const   { return retryTime; }
 
     void    SetRunways( int r )                     { numRunways = r; }
     void    SetPavements( int p )                   { numPavements = p; }
@@ -68,9 +80,15 @@ public:
     void    SetBuildTime( SGTimeStamp t )           { buildTime = t; }
     void    SetCleanTime( SGTimeStamp t )           { cleanTime = t; }
     void    SetTessTime( SGTimeStamp t )            { tessTime = t; }
-    void    SetErrorString( char* e )               { errString = e; }
+    void    SetErrorString( const std::string& e )  { errString = e; }
+    void    SetStatus( const std::string& s )       { status = s; }
+    void    SetRetryTime( SGTimeStamp t )           { retryTime = t; }
 
     void    IncreaseSnap( void )                    { snap *= 2.0f; }
+    void    IncreaseAttempts( void )                { numAttempts++; }
+
+    // column names for operator<<
+    static const char* GetReportHeader( void );
 
     friend std::ostream& operator<<(std::ostream& output, const AirportInfo& ai);
 
@@ -82,30 +100,45 @@ private:
     int         numPavements;
     int         numFeats;
     int         numTaxiways;
+    int         numAttempts;
 
     SGTimeStamp parseTime;
     SGTimeStamp buildTime;
     SGTimeStamp cleanTime;
     SGTimeStamp tessTime;
+    SGTimeStamp retryTime;
 
     double      snap;
+    std::string status;
     std::string errString;
 };
 
-extern SGLockedQueue<AirportInfo> global_workQueue;
-
 class Scheduler
 {
 public:
-    Scheduler(std::string& datafile, const std::string& root, const string_list& elev_src);
+    Scheduler(std::string& datafile, const std::string& indexfile, const std::string& root, const string_list& elev_src);
 
     long            FindAirport( std::string icao );
     void            AddAirport(  std::string icao );
     bool            AddAirports( long start_pos, tgRectangle* boundingBox );
-    void            RetryAirport( AirportInfo* pInfo );
+    void            SetRetries( int max_retries, double backoff );
+
+    // map apt.dat once, and share it between the parsers
+    bool            SetMappedInput( void );
+    const AptMappedFile* GetMappedInput( void ) const   { return mapped ? &mappedFile : NULL; }
+
+    // parse the airports without building them, to time the input
+    void            SetParseOnly( bool p )              { parseOnly = p; }
+    bool            GetParseOnly( void ) const          { return parseOnly; }
 
     void            Schedule( int num_threads, std::string& summaryfile );
 
+    // called by the parsers.  GetAirport blocks until an airport is ready,
+    // and returns false once every airport is done
+    bool            GetAirport( AirportInfo& ai );
+    void            AirportComplete( AirportInfo& ai );
+    void            AirportFailed( AirportInfo& ai, const std::string& reason, bool retry );
+
     // Debug
     void            set_debug( std::string path, std::vector<std::string> runway_defs,
                                                  std::vector<std::string> pavement_defs,
@@ -113,9 +146,35 @@ public:
                                                  std::vector<std::string> feature_defs );
 
 private:
-    bool            IsAirportDefinition( char* line, std::string icao );
+    struct RetryOrder {
+        bool operator()( const AirportInfo& a, const AirportInfo& b ) const {
+            return b.GetRetryTime() < a.GetRetryTime();
+        }
+    };
+
+    typedef std::priority_queue<AirportInfo, std::vector<AirportInfo>, RetryOrder> RetryQueue;
+
+    // mutex must be held
+    void            Report( AirportInfo& ai );
 
     std::string     filename;
+    AptIndex        index;
+    AptMappedFile   mappedFile;
+    bool            mapped;
+    bool            parseOnly;
+
+    std::deque<AirportInfo> workQueue;
+    RetryQueue              retryQueue;
+    int                     maxRetries;
+    double                  retryBackoff;
+    int                     numActive;
+    int                     numComplete;
+    int                     numFailed;
+    int                     numRetries;
+    std::ofstream           report;
+
+    SGMutex                 mutex;
+    SGWaitCondition         workReady;
     string_list     elevation;
     std::string     work_dir;
 
@@ -35,10 +35,13 @@
 #include <Include/version.h>
 
 #include <terragear/tg_mutex.hxx>
+#include <terragear/tg_array_cache.hxx>
+#include <terragear/tg_polygon.hxx>
 
 #include "tgconstruct_stage1.hxx"
 #include "tgconstruct_stage2.hxx"
 #include "tgconstruct_stage3.hxx"
+#include "tgconstruct_scheduler.hxx"
 #include "priorities.hxx"
 
 // display usage and exit
@@ -59,6 +62,13 @@ static void usage( const std::string& name ) {
     SG_LOG(SG_GENERAL, SG_ALERT, "  --ignore-landmass");
     SG_LOG(SG_GENERAL, SG_ALERT, "  --threads");
     SG_LOG(SG_GENERAL, SG_ALERT, "  --threads=<numthreads>");
+    SG_LOG(SG_GENERAL, SG_ALERT, "  --intermediate-format=<binary|shapefile>");
+    SG_LOG(SG_GENERAL, SG_ALERT, "  --void-fill=<lines|nearest>");
+    SG_LOG(SG_GENERAL, SG_ALERT, "  --export-shapefiles");
+    SG_LOG(SG_GENERAL, SG_ALERT, "  --work-stealing");
+    SG_LOG(SG_GENERAL, SG_ALERT, "  --cost-priority");
+    SG_LOG(SG_GENERAL, SG_ALERT, "  --trusted-input");
+    SG_LOG(SG_GENERAL, SG_ALERT, "  --incremental-cleaning");
     SG_LOG(SG_GENERAL, SG_ALERT, " ]");
     exit(-1);
 }
@@ -123,11 +133,7 @@ void doStage3( int num_threads, std::vector<SGBucket>& bucketList,
     for (unsigned int i=0; i<constructs.size(); i++) {
         constructs[i]->start();
     }
-    // wait for workqueue to empty
-    while( wq.size() ) {
-        tgSleep( 5 );
-    }
-    // wait for all threads to complete
+    // wait for all threads to complete - they exit once the workqueue is empty
     for (unsigned int i=0; i<constructs.size(); i++) {
         constructs[i]->join();
     }
@@ -139,88 +145,162 @@ void doStage3( int num_threads, std::vector<SGBucket>& bucketList,
     constructs.clear();    
 }
 
-void doStage2( int num_threads, std::vector<SGBucket>& bucketList, 
-               const std::string& priorities_file,
-               const std::string& work_base, const std::string& dem_base, 
-               const std::string& share_base, const std::string& debug_base )
+// a worker runs whichever stage the scheduler hands it.  Stage processors
+// are created on first use, as they each load the priorities file.
+class tgConstructWorker : public SGThread
 {
-    SGLockedQueue<SGBucket> wq;
+public:
+    tgConstructWorker( unsigned int i, tgConstructScheduler& s, const std::string& pfile, tgMutex* l ) :
+        id(i), scheduler(s), priorities_file(pfile), lock(l), validate_input(true), incremental_cleaning(false), failures(0), first(NULL), second(NULL) {}
 
-    /* fill the workqueue */
-    for (unsigned int i=0; i<bucketList.size(); i++) {
-        wq.push( bucketList[i] );
+    ~tgConstructWorker() {
+        delete first;
+        delete second;
     }
 
-    // now create the worker threads for stage 1
-    std::vector<tgConstructSecond *> constructs;    
-    tgMutex filelock;
+    void setPaths( const std::string& work, const std::string& dem, const std::string& share, const std::string& debug ) {
+        work_base  = work;
+        dem_base   = dem;
+        share_base = share;
+        debug_base = debug;
+    }
 
-    for (int i=0; i<num_threads; i++) {
-        tgConstructSecond* construct = new tgConstructSecond( priorities_file, wq, &filelock );
-        construct->setPaths( work_base, dem_base, share_base, debug_base );
-        constructs.push_back( construct );
+    void setIntermediateFormat( tgMesh::IntermediateFormat f, bool exportShp ) {
+        format            = f;
+        export_shapefiles = exportShp;
     }
-    
-    // start all threads
-    for (unsigned int i=0; i<constructs.size(); i++) {
-        constructs[i]->start();
+
+    void setValidateInput( bool validate ) {
+        validate_input = validate;
     }
-    // wait for workqueue to empty
-    while( wq.size() ) {
-        tgSleep( 5 );
+
+    void setIncrementalCleaning( bool incremental ) {
+        incremental_cleaning = incremental;
     }
-    // wait for all threads to complete
-    for (unsigned int i=0; i<constructs.size(); i++) {
-        constructs[i]->join();
+
+    // jobs that couldn't save their output - read once joined
+    unsigned int getFailures( void ) const {
+        return failures;
     }
-    
-    // delete the stage 1 construct objects
-    for (unsigned int i=0; i<constructs.size(); i++) {
-        delete constructs[i];
+
+private:
+    virtual void run() {
+        tgConstructScheduler::Job job;
+
+        while ( scheduler.getJob( id, job ) ) {
+            bool ok = true;
+
+            switch( job.stage ) {
+                case 1:
+                    if ( !first ) {
+                        first = new tgConstructFirst( priorities_file, lock );
+                        first->setPaths( work_base, dem_base, share_base, debug_base );
+                        first->setIntermediateFormat( format, export_shapefiles );
+                        first->setValidateInput( validate_input );
+                        first->setIncrementalCleaning( incremental_cleaning );
+                    }
+                    ok = first->construct( job.bucket );
+                    break;
+
+                case 2:
+                    if ( !second ) {
+                        second = new tgConstructSecond( priorities_file, lock );
+                        second->setPaths( work_base, dem_base, share_base, debug_base );
+                        second->setIntermediateFormat( format, export_shapefiles );
+                    }
+                    ok = second->construct( job.bucket );
+                    break;
+
+                default:
+                    SG_LOG(SG_GENERAL, SG_ALERT, "tgConstructWorker: no stage " << job.stage );
+                    ok = false;
+                    break;
+            }
+
+            // don't run the next stage on output that was never saved
+            if ( ok ) {
+                scheduler.jobComplete( id, job );
+            } else {
+                failures++;
+                scheduler.jobFailed( id, job );
+            }
+        }
+
+        SG_LOG(SG_GENERAL, SG_DEBUG, "Worker " << id << " thread " << current() << " finished");
     }
-    constructs.clear();    
-}
 
-void doStage1( int num_threads, std::vector<SGBucket>& bucketList, 
+    unsigned int                id;
+    tgConstructScheduler&       scheduler;
+    std::string                 priorities_file;
+    tgMutex*                    lock;
+
+    std::string                 work_base;
+    std::string                 dem_base;
+    std::string                 share_base;
+    std::string                 debug_base;
+    tgMesh::IntermediateFormat  format;
+    bool                        export_shapefiles;
+    bool                        validate_input;
+    bool                        incremental_cleaning;
+    unsigned int                failures;
+
+    tgConstructFirst*           first;
+    tgConstructSecond*          second;
+};
+
+// run stages 1 and 2 through the dependency aware scheduler.  returns the
+// number of jobs that failed to save their output
+unsigned int doStages( int num_threads, std::vector<SGBucket>& bucketList,
+               int start_stage, int end_stage,
                const std::string& priorities_file,
-               const std::string& work_base, const std::string& dem_base, 
-               const std::string& share_base, const std::string& debug_base )
+               const std::string& work_base, const std::string& dem_base,
+               const std::string& share_base, const std::string& debug_base,
+               tgMesh::IntermediateFormat format, bool export_shapefiles,
+               bool work_stealing, bool cost_priority, bool validate_input,
+               bool incremental_cleaning )
 {
-    SGLockedQueue<SGBucket> wq;
+    if ( num_threads < 1 ) {
+        num_threads = 1;
+    }
 
-    /* fill the workqueue */
-    for (unsigned int i=0; i<bucketList.size(); i++) {
-        wq.push( bucketList[i] );
+    tgConstructScheduler scheduler( bucketList, start_stage, end_stage, num_threads );
+    scheduler.setWorkStealing( work_stealing );
+    if ( cost_priority ) {
+        scheduler.setCostPriority( work_base );
     }
+    scheduler.start();
 
-    // now create the worker threads for stage 1
-    std::vector<tgConstructFirst *> constructs;    
+    // now create the worker threads
+    std::vector<tgConstructWorker *> workers;
     tgMutex filelock;
 
     for (int i=0; i<num_threads; i++) {
-        tgConstructFirst* construct = new tgConstructFirst( priorities_file, wq, &filelock );
-        construct->setPaths( work_base, dem_base, share_base, debug_base );
-        constructs.push_back( construct );
+        tgConstructWorker* worker = new tgConstructWorker( i, scheduler, priorities_file, &filelock );
+        worker->setPaths( work_base, dem_base, share_base, debug_base );
+        worker->setIntermediateFormat( format, export_shapefiles );
+        worker->setValidateInput( validate_input );
+        worker->setIncrementalCleaning( incremental_cleaning );
+        workers.push_back( worker );
     }
 
     // start all threads
-    for (unsigned int i=0; i<constructs.size(); i++) {
-        constructs[i]->start();
+    for (unsigned int i=0; i<workers.size(); i++) {
+        workers[i]->start();
     }
-    // wait for workqueue to empty
-    while( wq.size() ) {
-        tgSleep( 5 );
-    }
-    // wait for all threads to complete
-    for (unsigned int i=0; i<constructs.size(); i++) {
-        constructs[i]->join();
+    // wait for all threads to complete - they exit when the last job is done
+    unsigned int failures = 0;
+    for (unsigned int i=0; i<workers.size(); i++) {
+        workers[i]->join();
+        failures += workers[i]->getFailures();
     }
 
-    // delete the stage 1 construct objects
-    for (unsigned int i=0; i<constructs.size(); i++) {
-        delete constructs[i];
+    // delete the worker objects
+    for (unsigned int i=0; i<workers.size(); i++) {
+        delete workers[i];
     }
-    constructs.clear();    
+    workers.clear();
+
+    return failures;
 }
 
 int main(int argc, char **argv) {
@@ -239,6 +319,14 @@ int main(int argc, char **argv) {
     int    start_stage = 1;
     int    end_stage   = 2;
 
+    tgMesh::IntermediateFormat intermediate_format = tgMesh::FORMAT_BINARY;
+    bool   export_shapefiles = false;
+    bool   work_stealing = false;
+    bool   cost_priority = false;
+    bool   validate_input = true;
+    bool   incremental_cleaning = false;
+    unsigned int failures = 0;
+
     sglog().setLogLevels( SG_ALL, SG_INFO );
 
     //
@@ -276,6 +364,34 @@ int main(int argc, char **argv) {
             num_threads = atoi( arg.substr(10).c_str() );
         } else if (arg.find("--threads") == 0) {
             num_threads = boost::thread::hardware_concurrency();
+        } else if (arg.find("--intermediate-format=") == 0) {
+            std::string format = arg.substr(22);
+            if ( format == "binary" ) {
+                intermediate_format = tgMesh::FORMAT_BINARY;
+            } else if ( format == "shapefile" ) {
+                intermediate_format = tgMesh::FORMAT_SHAPEFILE;
+            } else {
+                usage(argv[0]);
+            }
+        } else if (arg.find("--void-fill=") == 0) {
+            std::string method = arg.substr(12);
+            if ( method == "lines" ) {
+                tgArrayCache::instance().setVoidFill( tgArray::VOID_FILL_LINES );
+            } else if ( method == "nearest" ) {
+                tgArrayCache::instance().setVoidFill( tgArray::VOID_FILL_NEAREST );
+            } else {
+                usage(argv[0]);
+            }
+        } else if (arg.find("--export-shapefiles") == 0) {
+            export_shapefiles = true;
+        } else if (arg.find("--work-stealing") == 0) {
+            work_stealing = true;
+        } else if (arg.find("--cost-priority") == 0) {
+            cost_priority = true;
+        } else if (arg.find("--trusted-input") == 0) {
+            validate_input = false;
+        } else if (arg.find("--incremental-cleaning") == 0) {
+            incremental_cleaning = true;
         } else if (arg.find("--stage=") == 0) {
             start_stage = atoi( arg.substr(8).c_str() );
             end_stage   = start_stage;
@@ -332,13 +448,12 @@ int main(int argc, char **argv) {
     }
 #endif
 
-// STAGE 1
-    if ( ( start_stage <= 1 ) && ( end_stage >= 1 ) ) {
-        doStage1( num_threads, bucketList, priorities_file, work_dir, dem_dir, share_dir, debug_dir );
-    }
-    
-    if ( ( start_stage <= 2 ) && ( end_stage >= 2 ) ) {
-        doStage2( num_threads, bucketList, priorities_file, work_dir, dem_dir, share_dir, debug_dir );
+// STAGE 1 and 2 - a tile's stage 2 starts as soon as it and its neighbours finish stage 1
+    if ( ( start_stage <= 2 ) && ( end_stage >= 1 ) ) {
+        int first = ( start_stage < 1 ) ? 1 : start_stage;
+        int last  = ( end_stage   > 2 ) ? 2 : end_stage;
+
+        failures = doStages( num_threads, bucketList, first, last, priorities_file, work_dir, dem_dir, share_dir, debug_dir, intermediate_format, export_shapefiles, work_stealing, cost_priority, validate_input, incremental_cleaning );
     }
     
 // STAGE 2    
@@ -411,6 +526,14 @@ int main(int argc, char **argv) {
     constructs.clear();
 #endif
 
+    tgArrayCache::instance().logStats();
+    tgPolygon::LogTesselateStats();
+
+    if ( failures ) {
+        SG_LOG(SG_GENERAL, SG_ALERT, "[Finished with " << failures << " tiles not saved]");
+        return 1;
+    }
+
     SG_LOG(SG_GENERAL, SG_ALERT, "[Finished successfully]");
     return 0;
 }
@@ -0,0 +1,294 @@
+// tgconstruct_scheduler.cxx -- dependency aware tile / stage job scheduler
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <sys/stat.h>
+
+#include <boost/foreach.hpp>
+
+#include <simgear/misc/sg_dir.hxx>
+#include <simgear/misc/sg_path.hxx>
+#include <simgear/threads/SGGuard.hxx>
+#include <simgear/debug/logstream.hxx>
+
+#include "tgconstruct_scheduler.hxx"
+
+tgConstructScheduler::tgConstructScheduler( const std::vector<SGBucket>& buckets, int first, int last, unsigned int numWorkers ) :
+    ready( numWorkers ? numWorkers : 1 ),
+    firstStage( first ),
+    lastStage( last ),
+    numComplete( 0 ),
+    numQueued( 0 ),
+    nextSeq( 0 ),
+    workStealing( false )
+{
+    std::map<long, unsigned int> index;
+
+    for ( unsigned int i=0; i<buckets.size(); i++ ) {
+        Tile t;
+
+        t.bucket      = buckets[i];
+        t.cost        = 0.0;
+        t.stageDone   = firstStage-1;
+        t.stageQueued = firstStage-1;
+        t.stageLast   = lastStage;
+
+        index[buckets[i].gen_index()] = i;
+        tiles.push_back( t );
+    }
+
+    // the same neighbours loadStage1SharedEdge reads
+    for ( unsigned int i=0; i<tiles.size(); i++ ) {
+        std::vector<SGBucket> northBuckets, southBuckets;
+
+        tiles[i].bucket.siblings( 0,  1, northBuckets );
+        tiles[i].bucket.siblings( 0, -1, southBuckets );
+
+        for ( unsigned int j=0; j<northBuckets.size(); j++ ) {
+            addNeighbour( i, northBuckets[j], index );
+        }
+        for ( unsigned int j=0; j<southBuckets.size(); j++ ) {
+            addNeighbour( i, southBuckets[j], index );
+        }
+        addNeighbour( i, tiles[i].bucket.sibling( -1, 0 ), index );
+        addNeighbour( i, tiles[i].bucket.sibling(  1, 0 ), index );
+    }
+
+    numJobs = tiles.size() * ( lastStage - firstStage + 1 );
+}
+
+void tgConstructScheduler::addNeighbour( unsigned int tile, const SGBucket& b, const std::map<long, unsigned int>& index )
+{
+    std::map<long, unsigned int>::const_iterator it = index.find( b.gen_index() );
+
+    // neighbours outside of this run are already built - or never will be
+    if ( it == index.end() || it->second == tile ) {
+        return;
+    }
+
+    tiles[tile].neighbours.push_back( it->second );
+    tiles[it->second].dependents.push_back( tile );
+}
+
+void tgConstructScheduler::setCostPriority( const std::string& workBase )
+{
+    // stage 1 time is dominated by the landclass polygons, so the size of
+    // the tile's shapefiles is a reasonable estimate for every stage
+    for ( unsigned int i=0; i<tiles.size(); i++ ) {
+        simgear::Dir d( workBase + "/" + tiles[i].bucket.gen_base_path() + "/" + tiles[i].bucket.gen_index_str() );
+        double       cost = 0.0;
+
+        if ( d.exists() ) {
+            simgear::PathList files = d.children( simgear::Dir::TYPE_FILE );
+
+            BOOST_FOREACH( const SGPath& p, files ) {
+                struct stat st;
+                if ( stat( p.c_str(), &st ) == 0 ) {
+                    cost += (double)st.st_size;
+                }
+            }
+        }
+
+        tiles[i].cost = cost;
+    }
+}
+
+void tgConstructScheduler::start( void )
+{
+    SGGuard<SGMutex> g(mutex);
+
+    for ( unsigned int i=0; i<tiles.size(); i++ ) {
+        release( i % ready.size(), i, firstStage );
+    }
+
+    SG_LOG(SG_GENERAL, SG_ALERT, "Scheduler: " << tiles.size() << " tiles, stages " << firstStage << " to " << lastStage << " - " << numJobs << " jobs" );
+
+    jobReady.broadcast();
+}
+
+bool tgConstructScheduler::isReady( unsigned int tile, int stage ) const
+{
+    // earlier stages were built by a previous run
+    if ( stage == firstStage ) {
+        return true;
+    }
+
+    if ( tiles[tile].stageDone < stage-1 ) {
+        return false;
+    }
+
+    for ( unsigned int i=0; i<tiles[tile].neighbours.size(); i++ ) {
+        if ( tiles[tiles[tile].neighbours[i]].stageDone < stage-1 ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// mutex must be held
+void tgConstructScheduler::release( unsigned int worker, unsigned int tile, int stage )
+{
+    Job job;
+
+    job.bucket = tiles[tile].bucket;
+    job.stage  = stage;
+    job.cost   = tiles[tile].cost;
+    job.tile   = tile;
+    job.seq    = nextSeq++;
+
+    tiles[tile].stageQueued = stage;
+
+    ready[workStealing ? worker : 0].push( job );
+    numQueued++;
+}
+
+// mutex must be held
+bool tgConstructScheduler::takeJob( unsigned int worker, Job& job )
+{
+    unsigned int q = workStealing ? worker : 0;
+
+    if ( ready[q].empty() ) {
+        if ( !workStealing ) {
+            return false;
+        }
+
+        // steal from the busiest worker
+        unsigned int victim  = q;
+        size_t       longest = 0;
+        for ( unsigned int i=0; i<ready.size(); i++ ) {
+            if ( ready[i].size() > longest ) {
+                longest = ready[i].size();
+                victim  = i;
+            }
+        }
+
+        if ( !longest ) {
+            return false;
+        }
+        q = victim;
+    }
+
+    job = ready[q].top();
+    ready[q].pop();
+    numQueued--;
+
+    return true;
+}
+
+bool tgConstructScheduler::getJob( unsigned int worker, Job& job )
+{
+    SGGuard<SGMutex> g(mutex);
+
+    if ( worker >= ready.size() ) {
+        worker = worker % ready.size();
+    }
+
+    while ( !takeJob( worker, job ) ) {
+        if ( numComplete == numJobs ) {
+            return false;
+        }
+
+        jobReady.wait( mutex );
+    }
+
+    return true;
+}
+
+void tgConstructScheduler::jobComplete( unsigned int worker, const Job& job )
+{
+    SGGuard<SGMutex> g(mutex);
+    unsigned int     released = 0;
+
+    if ( worker >= ready.size() ) {
+        worker = worker % ready.size();
+    }
+
+    tiles[job.tile].stageDone = job.stage;
+    numComplete++;
+
+    SG_LOG(SG_GENERAL, SG_ALERT, job.bucket.gen_index_str() << " - Stage " << job.stage << " complete. " << numComplete << " of " << numJobs << " jobs done, " << numQueued << " ready" );
+
+    // this tile, and every tile that reads it, may be able to move on
+    if ( job.stage < lastStage ) {
+        int next = job.stage + 1;
+
+        if ( tiles[job.tile].stageQueued < next && next <= tiles[job.tile].stageLast && isReady( job.tile, next ) ) {
+            release( worker, job.tile, next );
+            released++;
+        }
+
+        for ( unsigned int i=0; i<tiles[job.tile].dependents.size(); i++ ) {
+            unsigned int d = tiles[job.tile].dependents[i];
+
+            if ( tiles[d].stageQueued < next && next <= tiles[d].stageLast && isReady( d, next ) ) {
+                release( worker, d, next );
+                released++;
+            }
+        }
+    }
+
+    // wake everyone at the end, so idle workers can exit
+    if ( released || numComplete == numJobs ) {
+        jobReady.broadcast();
+    }
+}
+
+// mutex must be held.  cancel stage and later of the tile, and the stages
+// of its dependents that read them.  Apart from the failed job itself, none
+// of these can have been released yet - each one waits on its output.
+// returns the number of jobs cancelled.
+unsigned int tgConstructScheduler::cancel( unsigned int tile, int stage )
+{
+    unsigned int cancelled = 0;
+
+    if ( stage > tiles[tile].stageLast ) {
+        return 0;
+    }
+
+    cancelled = tiles[tile].stageLast - stage + 1;
+    tiles[tile].stageLast = stage - 1;
+
+    SG_LOG(SG_GENERAL, SG_ALERT, tiles[tile].bucket.gen_index_str() << " - Stage " << stage << " to " << stage + cancelled - 1 << " cancelled" );
+
+    for ( unsigned int i=0; i<tiles[tile].dependents.size(); i++ ) {
+        cancelled += cancel( tiles[tile].dependents[i], stage + 1 );
+    }
+
+    return cancelled;
+}
+
+void tgConstructScheduler::jobFailed( unsigned int /* worker */, const Job& job )
+{
+    SGGuard<SGMutex> g(mutex);
+
+    SG_LOG(SG_GENERAL, SG_ALERT, job.bucket.gen_index_str() << " - Stage " << job.stage << " failed." );
+
+    // the failed job counts as done, but stageDone stays put so nothing
+    // waiting on its output is released
+    numComplete += cancel( job.tile, job.stage );
+
+    SG_LOG(SG_GENERAL, SG_ALERT, numComplete << " of " << numJobs << " jobs done, " << numQueued << " ready" );
+
+    // nothing was released - but this may have been the last job
+    if ( numComplete == numJobs ) {
+        jobReady.broadcast();
+    }
+}
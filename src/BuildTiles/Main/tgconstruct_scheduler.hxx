@@ -0,0 +1,123 @@
+// tgconstruct_scheduler.hxx -- dependency aware tile / stage job scheduler
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+
+#ifndef _TGCONSTRUCT_SCHEDULER_HXX
+#define _TGCONSTRUCT_SCHEDULER_HXX
+
+#ifndef __cplusplus
+# error This library requires C++
+#endif
+
+#include <map>
+#include <queue>
+#include <vector>
+
+#include <simgear/bucket/newbucket.hxx>
+#include <simgear/threads/SGThread.hxx>
+
+// Instead of running every tile through stage 1, waiting for the work
+// queue to drain, then starting stage 2, each ( bucket, stage ) pair is a
+// job.  Stage N of a bucket reads the stage N-1 output of the bucket and
+// its edge neighbours ( see tgMeshTriangulation::loadStage1SharedEdge ),
+// so it is released as soon as those jobs complete.  Neighbours that are
+// not part of this run are assumed to already be on disk.
+//
+// Ready jobs are ordered by estimated cost ( largest first ) when cost
+// priority is enabled, and first come first served otherwise.  With work
+// stealing, each worker has its own ready queue - jobs a worker releases
+// go to its own queue, and an idle worker steals from the longest queue.
+//
+// Workers block on a condition variable while no job is ready.
+//
+// When a job fails, the later stages of its tile - and of every tile that
+// reads it, directly or through another cancelled stage - are cancelled
+// instead of run against missing output.
+class tgConstructScheduler
+{
+public:
+    struct Job {
+        SGBucket        bucket;
+        int             stage;
+        double          cost;
+
+        // private to the scheduler
+        unsigned int    tile;
+        unsigned long   seq;
+    };
+
+    tgConstructScheduler( const std::vector<SGBucket>& buckets, int firstStage, int lastStage, unsigned int numWorkers );
+
+    void setWorkStealing( bool ws ) { workStealing = ws; }
+
+    // estimate tile cost from the size of its landclass input in work_base
+    void setCostPriority( const std::string& workBase );
+
+    // queue the first stage of every tile
+    void start( void );
+
+    // block until a job is ready.  returns false once every job is complete
+    bool getJob( unsigned int worker, Job& job );
+
+    // mark the job complete, and release the jobs that were waiting on it
+    void jobComplete( unsigned int worker, const Job& job );
+
+    // mark the job failed, and cancel the jobs that depend on its output
+    void jobFailed( unsigned int worker, const Job& job );
+
+private:
+    struct JobOrder {
+        bool operator()( const Job& a, const Job& b ) const {
+            if ( a.cost != b.cost ) {
+                return a.cost < b.cost;
+            }
+            return a.seq > b.seq;
+        }
+    };
+
+    typedef std::priority_queue<Job, std::vector<Job>, JobOrder> ReadyQueue;
+
+    struct Tile {
+        SGBucket                    bucket;
+        double                      cost;
+        int                         stageDone;      // last completed stage
+        int                         stageQueued;    // last stage released to a ready queue
+        int                         stageLast;      // last stage not cancelled by a failure
+        std::vector<unsigned int>   neighbours;     // tiles this one reads at the next stage
+        std::vector<unsigned int>   dependents;     // tiles that read this one
+    };
+
+    bool isReady( unsigned int tile, int stage ) const;
+    void release( unsigned int worker, unsigned int tile, int stage );
+    void addNeighbour( unsigned int tile, const SGBucket& b, const std::map<long, unsigned int>& index );
+    bool takeJob( unsigned int worker, Job& job );
+    unsigned int cancel( unsigned int tile, int stage );
+
+    std::vector<Tile>       tiles;
+    std::vector<ReadyQueue> ready;
+    int                     firstStage;
+    int                     lastStage;
+    unsigned int            numJobs;
+    unsigned int            numComplete;
+    unsigned int            numQueued;
+    unsigned long           nextSeq;
+    bool                    workStealing;
+
+    SGMutex                 mutex;
+    SGWaitCondition         jobReady;
+};
+
+#endif // _TGCONSTRUCT_SCHEDULER_HXX
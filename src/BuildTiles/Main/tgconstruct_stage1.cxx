@@ -31,15 +31,13 @@
 #include <simgear/misc/sg_path.hxx>
 #include <simgear/debug/logstream.hxx>
 
-#include <terragear/tg_array.hxx>
+#include <terragear/tg_array_cache.hxx>
 
 #include "tgconstruct_stage1.hxx"
 
 // Constructor
-tgConstructFirst::tgConstructFirst( const std::string& pfile, SGLockedQueue<SGBucket>& q, tgMutex* l) :
-        workQueue(q)
+tgConstructFirst::tgConstructFirst( const std::string& pfile, tgMutex* l)
 {
-    totalTiles = q.size();   
     lock = l;
 
     /* initialize tgMesh for the number of layers we have */
@@ -74,52 +72,47 @@ void tgConstructFirst::safeMakeDirectory( const std::string& directory )
     lock->unlock();
 }
 
-void tgConstructFirst::run()
+bool tgConstructFirst::construct( const SGBucket& b )
 {
-    unsigned int tilesComplete;
+    bucket = b;
 
-    // as long as we have feometry to parse, do so
-    while ( !workQueue.empty() ) {
-        bucket = workQueue.pop();
-        tilesComplete = totalTiles - workQueue.size();
+    SG_LOG(SG_GENERAL, SG_ALERT, bucket.gen_index_str() << " - Stage1 Construct in " << bucket.gen_base_path() << " using thread " << SGThread::current() );
 
-        SG_LOG(SG_GENERAL, SG_ALERT, bucket.gen_index_str() << " - Stage1 Construct in " << bucket.gen_base_path() << " tile " << tilesComplete << " of " << totalTiles << " using thread " << current() );
+    // assume non ocean tile until proven otherwise
+    isOcean = false;
 
-        // assume non ocean tile until proven otherwise
-        isOcean = false;
+    // clear mesh
+    tileMesh.clear();
 
-        // clear mesh
-        tileMesh.clear();
+    if ( !debugBase.empty() ) {
+        std::string debugPath = debugBase + "/tgconstruct_debug/stage1/" + bucket.gen_base_path() + "/" + bucket.gen_index_str();                
+        safeMakeDirectory( debugPath );
 
-        if ( !debugBase.empty() ) {
-            std::string debugPath = debugBase + "/tgconstruct_debug/stage1/" + bucket.gen_base_path() + "/" + bucket.gen_index_str();                
-            safeMakeDirectory( debugPath );
-
-            tileMesh.initDebug( debugPath );
-        }
+        tileMesh.initDebug( debugPath );
+    }
 
-        tileMesh.clipAgainstBucket( bucket );
+    tileMesh.clipAgainstBucket( bucket );
 
-        // STEP 1 - read in the polygon soup for this tile
-        loadLandclassPolys( workBase );
+    // STEP 1 - read in the polygon soup for this tile
+    loadLandclassPolys( workBase );
 
-        // Step 2 - add the fitted nodes ( important elevation points )
-        // add them to the mesh - which adds them in triangulation
-        loadElevation( demBase );
+    // Step 2 - add the fitted nodes ( important elevation points )
+    // add them to the mesh - which adds them in triangulation
+    loadElevation( demBase );
 
-        // generate the tile
-        tileMesh.generate();
+    // generate the tile
+    tileMesh.generate();
 
-        // save the intermediate data
-        std::string sharedPath = shareBase + "/stage1/" + bucket.gen_base_path() + "/" + bucket.gen_index_str();
-        safeMakeDirectory( sharedPath );
+    // save the intermediate data
+    std::string sharedPath = shareBase + "/stage1/" + bucket.gen_base_path() + "/" + bucket.gen_index_str();
+    safeMakeDirectory( sharedPath );
 
-        lock->lock();
-        tileMesh.save( sharedPath );
-        lock->unlock();
+    if ( !tileMesh.save( sharedPath ) ) {
+        SG_LOG(SG_GENERAL, SG_ALERT, bucket.gen_index_str() << " - Stage1 failed saving to " << sharedPath );
+        return false;
     }
 
-    SG_LOG(SG_GENERAL, SG_DEBUG, bucket.gen_index_str() << " Thread " << current() << " finished");
+    return true;
 }
 
 int tgConstructFirst::loadLandclassPolys( const std::string& path )
@@ -168,30 +161,25 @@ int tgConstructFirst::loadLandclassPolys( const std::string& path )
 }
 
 void tgConstructFirst::loadElevation( const std::string& path ) {        
-    std::string array_path = path + "/" + bucket.gen_base_path() + "/" + bucket.gen_index_str();
-    tgArray     array;
-
-    if ( array.open(array_path) ) {
-        std::vector<cgalPoly_Point>  elevationPoints;
-
-        SG_LOG(SG_GENERAL, SG_DEBUG, "Opened Array file " << array_path);
-
-        array.parse( bucket );
-        array.remove_voids( );
-
-        std::vector<SGGeod> const& corner_list = array.get_corner_list();
-        for (unsigned int i=0; i<corner_list.size(); i++) {
-            elevationPoints.push_back( cgalPoly_Point(corner_list[i].getLongitudeDeg(), corner_list[i].getLatitudeDeg()) );
-        }
+    // the array is shared with the neighbouring tiles through the cache.
+    // without an array file, there are no fitted nodes to add.
+    tgArrayPtr                  array = tgArrayCache::instance().get( path, bucket );
+    std::vector<cgalPoly_Point> elevationPoints;
+
+    std::vector<SGGeod> const& corner_list = array->get_corner_list();
+    for (unsigned int i=0; i<corner_list.size(); i++) {
+        elevationPoints.push_back( cgalPoly_Point(corner_list[i].getLongitudeDeg(), corner_list[i].getLatitudeDeg()) );
+    }
 
-        std::vector<SGGeod> const& fit_list = array.get_fitted_list();
-        for (unsigned int i=0; i<fit_list.size(); i++) {
-            elevationPoints.push_back( cgalPoly_Point(fit_list[i].getLongitudeDeg(), fit_list[i].getLatitudeDeg()) );
-        }
+    std::vector<SGGeod> const& fit_list = array->get_fitted_list();
+    for (unsigned int i=0; i<fit_list.size(); i++) {
+        elevationPoints.push_back( cgalPoly_Point(fit_list[i].getLongitudeDeg(), fit_list[i].getLatitudeDeg()) );
+    }
 
-        tileMesh.addPoints( elevationPoints );
+    if ( elevationPoints.empty() ) {
+        SG_LOG(SG_GENERAL, SG_INFO, "No fitted nodes for " << path << "/" << bucket.gen_base_path() << "/" << bucket.gen_index_str());
     } else {
-        SG_LOG(SG_GENERAL, SG_INFO, "Failed to open Array file " << array_path);
+        tileMesh.addPoints( elevationPoints );
     }
 }
 
@@ -30,18 +30,18 @@
 #endif                                   
 
 #include <simgear/threads/SGThread.hxx>
-#include <simgear/threads/SGQueue.hxx>
 
 #include <terragear/tg_mutex.hxx>
 #include <terragear/mesh/tg_mesh.hxx>
 
 #include "priorities.hxx"
 
-class tgConstructFirst : public SGThread
+// builds one tile at a time - tgConstructScheduler decides which, and when
+class tgConstructFirst
 {
 public:
     // Constructor
-    tgConstructFirst( const std::string& priorities_file, SGLockedQueue<SGBucket>& q, tgMutex* l );
+    tgConstructFirst( const std::string& priorities_file, tgMutex* l );
 
     // Destructor
     ~tgConstructFirst();
@@ -49,9 +49,19 @@ public:
     // paths
     void setPaths( const std::string& work, const std::string& dem, const std::string& share, const std::string& debug );
 
-private:
-    virtual void run();
+    // stage intermediate format
+    void setIntermediateFormat( tgMesh::IntermediateFormat format, bool exportShapefiles ) { tileMesh.setIntermediateFormat( format, exportShapefiles ); }
+
+    // skip polygon set validity checks while clipping
+    void setValidateInput( bool validate ) { tileMesh.setValidateInput( validate ); }
+
+    // clean the arrangement in place, rather than rebuilding it
+    void setIncrementalCleaning( bool incremental ) { tileMesh.setIncrementalCleaning( incremental ); }
 
+    // construct this stage of a single tile.  returns false if it couldn't be saved
+    bool construct( const SGBucket& b );
+
+private:
     // Ocean tile or not
     bool IsOceanTile()  { return isOcean; }
 
@@ -68,10 +78,6 @@ private:
 private:
     TGAreaDefinitions           areaDefs;
     
-    // construct stage to perform
-    SGLockedQueue<SGBucket>&    workQueue;
-    unsigned int                totalTiles;
-    
     // paths
     std::string                 workBase;
     std::string                 demBase;
@@ -31,15 +31,13 @@
 #include <simgear/misc/sg_path.hxx>
 #include <simgear/debug/logstream.hxx>
 
-#include <terragear/tg_array.hxx>
+#include <terragear/tg_array_cache.hxx>
 
 #include "tgconstruct_stage2.hxx"
 
 // Constructor
-tgConstructSecond::tgConstructSecond( const std::string& pfile, SGLockedQueue<SGBucket>& q, tgMutex* l) :
-        workQueue(q)
+tgConstructSecond::tgConstructSecond( const std::string& pfile, tgMutex* l)
 {
-    totalTiles = q.size();
     lock = l;
 
     /* initialize tgMesh for the number of layers we have */
@@ -74,73 +72,65 @@ void tgConstructSecond::safeMakeDirectory( const std::string& directory )
     lock->unlock();
 }
 
-void tgConstructSecond::run()
+bool tgConstructSecond::construct( const SGBucket& b )
 {
-    unsigned int tilesComplete;
+    bucket = b;
 
-    // as long as we have feometry to parse, do so
-    while ( !workQueue.empty() ) {
-        bucket = workQueue.pop();
-        tilesComplete = totalTiles - workQueue.size();
+    SG_LOG(SG_GENERAL, SG_ALERT, bucket.gen_index_str() << " - Stage 2 Construct in " << bucket.gen_base_path() << " using thread " << SGThread::current() );
 
-        SG_LOG(SG_GENERAL, SG_ALERT, bucket.gen_index_str() << " - Stage 2 Construct in " << bucket.gen_base_path() << " tile " << tilesComplete << " of " << totalTiles << " using thread " << current() );
+    // and clear
+    tileMesh.clear();
 
-        // and clear
-        tileMesh.clear();
+    if ( !debugBase.empty() ) {
+        std::string debugPath = debugBase + "/tgconstruct_debug/stage2/" + bucket.gen_base_path() + "/" + bucket.gen_index_str();
+        safeMakeDirectory( debugPath );
 
-        if ( !debugBase.empty() ) {
-            std::string debugPath = debugBase + "/tgconstruct_debug/stage2/" + bucket.gen_base_path() + "/" + bucket.gen_index_str();
-            safeMakeDirectory( debugPath );
-
-            tileMesh.initDebug( debugPath );
-        }
+        tileMesh.initDebug( debugPath );
+    }
 
-        std::string sharedStage1Base = shareBase + "/stage1/";
+    std::string sharedStage1Base = shareBase + "/stage1/";
 
-        // STEP 1 - read in the stage 1 tile mesh triangulation, and the shared edge nodes - remesh to fit shared edges
-        isOcean = tileMesh.loadStage1( sharedStage1Base, bucket );
+    // STEP 1 - read in the stage 1 tile mesh triangulation, and the shared edge nodes - remesh to fit shared edges
+    isOcean = tileMesh.loadStage1( sharedStage1Base, bucket );
 
-        if ( !isOcean ) {
+    if ( !isOcean ) {
 #if 0
-            // Step 2 - calculate elevation
-            tileMesh.calcElevation( demBase );
+        // Step 2 - calculate elevation
+        tileMesh.calcElevation( demBase );
 #endif
 
-            // save the intermediate data
-            std::string sharedStage2 = shareBase + "/stage2/" + bucket.gen_base_path() + "/" + bucket.gen_index_str();
-            safeMakeDirectory( sharedStage2 );
+        // save the intermediate data
+        std::string sharedStage2 = shareBase + "/stage2/" + bucket.gen_base_path() + "/" + bucket.gen_index_str();
+        safeMakeDirectory( sharedStage2 );
 
-            lock->lock();
-            tileMesh.save2( sharedStage2 );
-            lock->unlock();
+        if ( !tileMesh.save2( sharedStage2 ) ) {
+            SG_LOG(SG_GENERAL, SG_ALERT, bucket.gen_index_str() << " - Stage 2 failed saving to " << sharedStage2 );
+            return false;
         }
     }
+
+    return true;
 }
 
 void tgConstructSecond::loadElevation( const std::string& path ) {        
-    std::string array_path = path + "/" + bucket.gen_base_path() + "/" + bucket.gen_index_str();
-    tgArray     array;
-
-    if ( array.open(array_path) ) {
-        std::vector<cgalPoly_Point>  elevationPoints;
-
-        SG_LOG(SG_GENERAL, SG_DEBUG, "Opened Array file " << array_path);
-
-        array.parse( bucket );
-        array.remove_voids( );
-
-        std::vector<SGGeod> const& corner_list = array.get_corner_list();
-        for (unsigned int i=0; i<corner_list.size(); i++) {
-            elevationPoints.push_back( cgalPoly_Point(corner_list[i].getLongitudeDeg(), corner_list[i].getLatitudeDeg()) );
-        }
+    // the array is shared with the neighbouring tiles through the cache.
+    // without an array file, there are no fitted nodes to add.
+    tgArrayPtr                  array = tgArrayCache::instance().get( path, bucket );
+    std::vector<cgalPoly_Point> elevationPoints;
+
+    std::vector<SGGeod> const& corner_list = array->get_corner_list();
+    for (unsigned int i=0; i<corner_list.size(); i++) {
+        elevationPoints.push_back( cgalPoly_Point(corner_list[i].getLongitudeDeg(), corner_list[i].getLatitudeDeg()) );
+    }
 
-        std::vector<SGGeod> const& fit_list = array.get_fitted_list();
-        for (unsigned int i=0; i<fit_list.size(); i++) {
-            elevationPoints.push_back( cgalPoly_Point(fit_list[i].getLongitudeDeg(), fit_list[i].getLatitudeDeg()) );
-        }
+    std::vector<SGGeod> const& fit_list = array->get_fitted_list();
+    for (unsigned int i=0; i<fit_list.size(); i++) {
+        elevationPoints.push_back( cgalPoly_Point(fit_list[i].getLongitudeDeg(), fit_list[i].getLatitudeDeg()) );
+    }
 
-        tileMesh.addPoints( elevationPoints );        
+    if ( elevationPoints.empty() ) {
+        SG_LOG(SG_GENERAL, SG_INFO, "No fitted nodes for " << path << "/" << bucket.gen_base_path() << "/" << bucket.gen_index_str());
     } else {
-        SG_LOG(SG_GENERAL, SG_INFO, "Failed to open Array file " << array_path);
+        tileMesh.addPoints( elevationPoints );
     }
 }
\ No newline at end of file
@@ -30,27 +30,31 @@
 #endif                                   
 
 #include <simgear/threads/SGThread.hxx>
-#include <simgear/threads/SGQueue.hxx>
 
 #include <terragear/mesh/tg_mesh.hxx>
 
 #include "priorities.hxx"
 
-class tgConstructSecond : public SGThread
+// builds one tile at a time - tgConstructScheduler decides which, and when
+class tgConstructSecond
 {
 public:
     // Constructor
-    tgConstructSecond( const std::string& priorities_file, SGLockedQueue<SGBucket>& q, tgMutex* l );
+    tgConstructSecond( const std::string& priorities_file, tgMutex* l );
 
     // Destructor
     ~tgConstructSecond();
 
     // paths
     void setPaths( const std::string& work, const std::string& dem, const std::string& share, const std::string& debug );
+
+    // stage intermediate format
+    void setIntermediateFormat( tgMesh::IntermediateFormat format, bool exportShapefiles ) { tileMesh.setIntermediateFormat( format, exportShapefiles ); }
     
-private:
-    virtual void run();
+    // construct this stage of a single tile.  returns false if it couldn't be saved
+    bool construct( const SGBucket& b );
 
+private:
     // Ocean tile or not
     bool IsOceanTile()  { return isOcean; }
 
@@ -62,10 +66,6 @@ private:
 private:
     TGAreaDefinitions           areaDefs;
     
-    // construct stage to perform
-    SGLockedQueue<SGBucket>&    workQueue;
-    unsigned int                totalTiles;
-    
     // paths
     std::string                 workBase;
     std::string                 demBase;
@@ -0,0 +1,176 @@
+// arrthreadtest.cxx -- concurrent tile arrangement stress test
+//
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// tg-construct builds one arrangement per tile on every worker thread,
+// without a global lock.  This test builds a set of synthetic tile
+// arrangements once on the main thread, through tgMeshArrangement :
+//  - arrangePolys, which inserts each polygon with arrangementInsert
+//  - loadArrangement, from the stage 1 container of the first build
+// then rebuilds them both ways over and over from many threads at once,
+// and checks every concurrent result is identical to the single threaded
+// one.
+//
+// usage: arrthreadtest [num_tiles] [num_threads] [num_rounds] [work_dir]
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include <simgear/misc/sg_path.hxx>
+
+#include <terragear/mesh/tg_mesh.hxx>
+
+#include "test_tiles.hxx"
+
+// build the arrangement from the tile's polygons
+static arrSignature buildTile( const std::vector<tgPolygonSet>& polys )
+{
+    std::vector<std::string> priorities;
+    priorities.push_back( "Default" );
+
+    tgMesh            mesh;
+    tgMeshArrangement arr( &mesh );
+
+    arr.initPriorities( priorities );
+    arr.addPolys( 0, polys );
+    arr.arrangePolys();
+
+    return getSignature( arr );
+}
+
+// build the arrangement once, and write it where loadArrangement looks
+static bool saveTile( const std::vector<tgPolygonSet>& polys, const std::string& path )
+{
+    std::vector<std::string> priorities;
+    priorities.push_back( "Default" );
+
+    tgMesh             mesh;
+    tgMeshArrangement  arr( &mesh );
+    tgMeshBinaryWriter writer;
+
+    arr.initPriorities( priorities );
+    arr.addPolys( 0, polys );
+    arr.arrangePolys();
+    arr.toBinary( writer );
+
+    SGPath( path + "/dummy" ).create_dir( 0755 );
+
+    return writer.write( path + "/" + TG_MESH_STAGE1_BINARY );
+}
+
+class arrWorker
+{
+public:
+    arrWorker( unsigned int f, unsigned int r, const std::vector<tileInput>& in, const std::string& wd,
+               const std::vector<arrSignature>& built, const std::vector<arrSignature>& loaded ) :
+        first(f), rounds(r), inputs(in), root(wd), refBuilt(built), refLoaded(loaded), failures(0) {}
+
+    void operator()() {
+        unsigned int numTiles = inputs.size();
+
+        // alternate between inserting and loading, so both run at once
+        for ( unsigned int r=0; r<rounds; r++ ) {
+            for ( unsigned int i=0; i<numTiles; i++ ) {
+                unsigned int t = (first + i) % numTiles;
+
+                if ( (r + i) % 2 ) {
+                    if ( !(loadSignature( tilePath( root, "tiles", t ) ) == refLoaded[t]) ) {
+                        failures++;
+                    }
+                } else {
+                    if ( !(buildTile( inputs[t].polys ) == refBuilt[t]) ) {
+                        failures++;
+                    }
+                }
+            }
+        }
+    }
+
+    unsigned int getFailures( void ) const { return failures; }
+
+private:
+    unsigned int                        first;
+    unsigned int                        rounds;
+    const std::vector<tileInput>&       inputs;
+    std::string                         root;
+    const std::vector<arrSignature>&    refBuilt;
+    const std::vector<arrSignature>&    refLoaded;
+    unsigned int                        failures;
+};
+
+int main(int argc, char* argv[])
+{
+    unsigned int numTiles   = (argc > 1) ? atoi(argv[1]) : 64;
+    unsigned int numThreads = (argc > 2) ? atoi(argv[2]) : boost::thread::hardware_concurrency();
+    unsigned int numRounds  = (argc > 3) ? atoi(argv[3]) : 4;
+    std::string  root       = (argc > 4) ? argv[4] : "./arrthreadtest";
+
+    if ( !numTiles ) {
+        numTiles = 1;
+    }
+    if ( numThreads < 2 ) {
+        numThreads = 2;
+    }
+
+    std::cout << "Building " << numTiles << " reference arrangements" << std::endl;
+
+    std::vector<tileInput>      inputs( numTiles );
+    std::vector<arrSignature>   refBuilt;
+    std::vector<arrSignature>   refLoaded;
+
+    for ( unsigned int t=0; t<numTiles; t++ ) {
+        generateTile( t, inputs[t] );
+
+        if ( !saveTile( inputs[t].polys, tilePath( root, "tiles", t ) ) ) {
+            std::cout << "FAILED: can't write tile " << t << " to " << root << std::endl;
+            return 1;
+        }
+
+        refBuilt.push_back( buildTile( inputs[t].polys ) );
+        refLoaded.push_back( loadSignature( tilePath( root, "tiles", t ) ) );
+    }
+
+    std::cout << "Rebuilding on " << numThreads << " threads, " << numRounds << " rounds" << std::endl;
+
+    // each thread starts at a different tile, so the same tile is often
+    // being built on several threads at the same time
+    std::vector<arrWorker>  workers;
+    boost::thread_group     threads;
+
+    for ( unsigned int i=0; i<numThreads; i++ ) {
+        workers.push_back( arrWorker( i % numTiles, numRounds, inputs, root, refBuilt, refLoaded ) );
+    }
+    for ( unsigned int i=0; i<numThreads; i++ ) {
+        threads.create_thread( boost::ref( workers[i] ) );
+    }
+    threads.join_all();
+
+    unsigned int failures = 0;
+    for ( unsigned int i=0; i<numThreads; i++ ) {
+        failures += workers[i].getFailures();
+    }
+
+    if ( failures ) {
+        std::cout << "FAILED: " << failures << " arrangements differ from the single threaded build" << std::endl;
+        return 1;
+    }
+
+    std::cout << "PASSED" << std::endl;
+    return 0;
+}
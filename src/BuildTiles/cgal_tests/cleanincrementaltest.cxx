@@ -0,0 +1,131 @@
+// cleanincrementaltest.cxx -- incremental arrangement cleaning test
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// tgMesh can clean the arrangement ( clustering and snap rounding ) by
+// rebuilding it, or by editing just the edges around the vertices that
+// move.  This test generates a set of synthetic tiles through
+// tgMesh::generate() both ways :
+//
+//   full        : the arrangement is rebuilt, the default
+//   incremental : tgMesh::setIncrementalCleaning( true )
+//
+// loads the arrangement back from the stage1 container written for each
+// tile, and checks both passes have the same segments.  The containers
+// can't be compared byte for byte - editing the arrangement in place
+// creates the edges and vertices in a different order than a rebuild.
+// Reports the time each pass took.
+//
+// usage: cleanincrementaltest <output dir> [num_tiles]
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <simgear/misc/sg_path.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+#include <terragear/mesh/tg_mesh.hxx>
+
+#include "test_tiles.hxx"
+
+static long runPass( const std::vector<tileInput>& inputs, const std::string& root, const char* pass, bool incremental )
+{
+    std::vector<std::string> priorities;
+    priorities.push_back( "Default" );
+
+    SGTimeStamp start, end;
+    start.stamp();
+
+    for ( unsigned int t=0; t<inputs.size(); t++ ) {
+        tgMesh mesh;
+
+        mesh.initPriorities( priorities );
+        mesh.setIncrementalCleaning( incremental );
+        mesh.clipAgainstBucket( inputs[t].bucket );
+        for ( unsigned int i=0; i<inputs[t].polys.size(); i++ ) {
+            mesh.addPoly( 0, inputs[t].polys[i] );
+        }
+        mesh.generate();
+        if ( !mesh.save( tilePath( root, pass, t ) ) ) {
+            std::cout << "tile " << t << " : save failed" << std::endl;
+        }
+    }
+
+    end.stamp();
+    return ( end - start ).toMSecs();
+}
+
+int main(int argc, char* argv[])
+{
+    if ( argc < 2 ) {
+        std::cout << "usage: cleanincrementaltest <output dir> [num_tiles]" << std::endl;
+        return 1;
+    }
+
+    std::string  root     = argv[1];
+    unsigned int numTiles = (argc > 2) ? atoi(argv[2]) : 32;
+
+    if ( !numTiles ) {
+        numTiles = 1;
+    }
+
+    std::vector<tileInput> inputs( numTiles );
+    for ( unsigned int t=0; t<numTiles; t++ ) {
+        generateTile( t, inputs[t] );
+
+        SGPath( tilePath( root, "full", t )        + "/dummy" ).create_dir( 0755 );
+        SGPath( tilePath( root, "incremental", t ) + "/dummy" ).create_dir( 0755 );
+    }
+
+    std::cout << "Generating " << numTiles << " tiles, full cleaning" << std::endl;
+    long fullTime = runPass( inputs, root, "full", false );
+
+    std::cout << "Generating " << numTiles << " tiles, incremental cleaning" << std::endl;
+    long incrementalTime = runPass( inputs, root, "incremental", true );
+
+    std::cout << "  full        " << fullTime << " ms" << std::endl;
+    std::cout << "  incremental " << incrementalTime << " ms" << std::endl;
+
+    unsigned int failures = 0;
+    for ( unsigned int t=0; t<numTiles; t++ ) {
+        std::string fullPath        = tilePath( root, "full", t );
+        std::string incrementalPath = tilePath( root, "incremental", t );
+
+        if ( !SGPath( fullPath        + "/" + TG_MESH_STAGE1_BINARY ).exists() ||
+             !SGPath( incrementalPath + "/" + TG_MESH_STAGE1_BINARY ).exists() ) {
+            std::cout << "tile " << t << " : missing output" << std::endl;
+            failures++;
+            continue;
+        }
+
+        arrSignature full        = loadSignature( fullPath );
+        arrSignature incremental = loadSignature( incrementalPath );
+
+        if ( !(full == incremental) ) {
+            std::cout << "tile " << t << " : incremental arrangement differs from full - " <<
+                         incremental.segments.size() << " segments, full " << full.segments.size() << std::endl;
+            failures++;
+        }
+    }
+
+    if ( failures ) {
+        std::cout << "FAILED: " << failures << " of " << numTiles << " tiles" << std::endl;
+        return 1;
+    }
+
+    std::cout << "PASSED" << std::endl;
+    return 0;
+}
@@ -0,0 +1,149 @@
+// cleanthreadtest.cxx -- concurrent tile mesh generation test
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// Arrangement cleaning ( clustering and snap rounding ) used to run under
+// the global construct lock.  This test generates a set of synthetic tiles
+// twice through tgMesh::generate() :
+//
+//   locked     : each generate() holds a shared mutex, as the old code did
+//   concurrent : no lock, all threads cleaning at the same time
+//
+// and checks that the stage1 containers written for each tile are byte for
+// byte identical.
+//
+// usage: cleanthreadtest <output dir> [num_tiles] [num_threads]
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include <simgear/misc/sg_path.hxx>
+
+#include <terragear/tg_mutex.hxx>
+#include <terragear/mesh/tg_mesh.hxx>
+
+#include "test_tiles.hxx"
+
+class meshWorker
+{
+public:
+    meshWorker( unsigned int f, unsigned int s, const std::vector<tileInput>& in, const std::string& r, const char* p, tgMutex* l ) :
+        first(f), stride(s), inputs(in), root(r), pass(p), serialize(l) {}
+
+    void operator()() {
+        std::vector<std::string> priorities;
+        priorities.push_back( "Default" );
+
+        for ( unsigned int t=first; t<inputs.size(); t+=stride ) {
+            tgMesh mesh;
+
+            mesh.initPriorities( priorities );
+            mesh.clipAgainstBucket( inputs[t].bucket );
+            for ( unsigned int i=0; i<inputs[t].polys.size(); i++ ) {
+                mesh.addPoly( 0, inputs[t].polys[i] );
+            }
+
+            if ( serialize ) {
+                serialize->lock();
+            }
+            mesh.generate();
+            if ( serialize ) {
+                serialize->unlock();
+            }
+
+            if ( !mesh.save( tilePath( root, pass, t ) ) ) {
+                std::cout << "tile " << t << " : save failed" << std::endl;
+            }
+        }
+    }
+
+private:
+    unsigned int                    first;
+    unsigned int                    stride;
+    const std::vector<tileInput>&   inputs;
+    std::string                     root;
+    const char*                     pass;
+    tgMutex*                        serialize;
+};
+
+static void runPass( const std::vector<tileInput>& inputs, const std::string& root, const char* pass, unsigned int numThreads, tgMutex* serialize )
+{
+    boost::thread_group threads;
+
+    for ( unsigned int i=0; i<numThreads; i++ ) {
+        threads.create_thread( meshWorker( i, numThreads, inputs, root, pass, serialize ) );
+    }
+    threads.join_all();
+}
+
+int main(int argc, char* argv[])
+{
+    if ( argc < 2 ) {
+        std::cout << "usage: cleanthreadtest <output dir> [num_tiles] [num_threads]" << std::endl;
+        return 1;
+    }
+
+    std::string  root       = argv[1];
+    unsigned int numTiles   = (argc > 2) ? atoi(argv[2]) : 32;
+    unsigned int numThreads = (argc > 3) ? atoi(argv[3]) : boost::thread::hardware_concurrency();
+
+    if ( !numTiles ) {
+        numTiles = 1;
+    }
+    if ( numThreads < 2 ) {
+        numThreads = 2;
+    }
+
+    std::vector<tileInput> inputs( numTiles );
+    for ( unsigned int t=0; t<numTiles; t++ ) {
+        generateTile( t, inputs[t] );
+
+        SGPath( tilePath( root, "locked", t )     + "/dummy" ).create_dir( 0755 );
+        SGPath( tilePath( root, "concurrent", t ) + "/dummy" ).create_dir( 0755 );
+    }
+
+    tgMutex lock;
+
+    std::cout << "Generating " << numTiles << " tiles on " << numThreads << " threads, locked" << std::endl;
+    runPass( inputs, root, "locked", numThreads, &lock );
+
+    std::cout << "Generating " << numTiles << " tiles on " << numThreads << " threads, concurrent" << std::endl;
+    runPass( inputs, root, "concurrent", numThreads, NULL );
+
+    unsigned int failures = 0;
+    for ( unsigned int t=0; t<numTiles; t++ ) {
+        std::vector<char> locked, concurrent;
+
+        if ( !readFile( tilePath( root, "locked", t )     + "/" + TG_MESH_STAGE1_BINARY, locked ) ||
+             !readFile( tilePath( root, "concurrent", t ) + "/" + TG_MESH_STAGE1_BINARY, concurrent ) ) {
+            std::cout << "tile " << t << " : missing output" << std::endl;
+            failures++;
+        } else if ( locked != concurrent ) {
+            std::cout << "tile " << t << " : concurrent mesh differs from locked mesh" << std::endl;
+            failures++;
+        }
+    }
+
+    if ( failures ) {
+        std::cout << "FAILED: " << failures << " of " << numTiles << " tiles" << std::endl;
+        return 1;
+    }
+
+    std::cout << "PASSED" << std::endl;
+    return 0;
+}
@@ -0,0 +1,118 @@
+// test_tiles.cxx -- synthetic tiles shared by the cgal tile tests
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+
+#include <cstdio>
+#include <algorithm>
+
+#include "test_tiles.hxx"
+
+double nextRandom( unsigned long& seed )
+{
+    seed = seed * 1103515245 + 12345;
+    return (double)((seed / 65536) % 32768) / 32768.0;
+}
+
+void generateTile( unsigned int tile, tileInput& input )
+{
+    unsigned long seed = 1 + tile;
+
+    input.bucket = SGBucket( SGGeod::fromDeg( -120.0 + 0.25 * (tile % 32) + 0.01,
+                                               35.0   + 0.125 * (tile / 32) + 0.01 ) );
+
+    double lon   = input.bucket.get_corner( SG_BUCKET_SW ).getLongitudeDeg();
+    double lat   = input.bucket.get_corner( SG_BUCKET_SW ).getLatitudeDeg();
+    double width = input.bucket.get_width();
+    double hgt   = input.bucket.get_height();
+
+    for ( unsigned int i=0; i<40; i++ ) {
+        double cx = lon + width * ( 1.1 * nextRandom( seed ) - 0.05 );
+        double cy = lat + hgt   * ( 1.1 * nextRandom( seed ) - 0.05 );
+        double dx = 0.01 * nextRandom( seed ) + 0.0005;
+        double dy = 0.01 * nextRandom( seed ) + 0.0005;
+        double jt = 0.000002 * nextRandom( seed );
+
+        cgalPoly_Point pt[4];
+        pt[0] = cgalPoly_Point( cx - dx,      cy - dy      );
+        pt[1] = cgalPoly_Point( cx + dx,      cy - dy + jt );
+        pt[2] = cgalPoly_Point( cx + dx + jt, cy + dy      );
+        pt[3] = cgalPoly_Point( cx - dx,      cy + dy - jt );
+
+        cgalPoly_Polygon poly( pt, pt+4 );
+        tgPolygonSetMeta meta( tgPolygonSetMeta::META_TEXTURED, "Default" );
+
+        input.polys.push_back( tgPolygonSet( poly, meta ) );
+    }
+}
+
+std::string tilePath( const std::string& root, const char* pass, unsigned int tile )
+{
+    char name[32];
+    sprintf( name, "%s/%04u", pass, tile );
+
+    return root + "/" + name;
+}
+
+bool readFile( const std::string& filename, std::vector<char>& contents )
+{
+    FILE* fp = fopen( filename.c_str(), "rb" );
+    if ( !fp ) {
+        return false;
+    }
+
+    char   buf[4096];
+    size_t n;
+    while ( (n = fread( buf, 1, sizeof(buf), fp )) > 0 ) {
+        contents.insert( contents.end(), buf, buf + n );
+    }
+    fclose( fp );
+
+    return true;
+}
+
+// segments sorted by their lower left end, then the other end
+static bool lessSegment( const meshTriSegment& a, const meshTriSegment& b )
+{
+    if ( a.source() != b.source() ) {
+        return CGAL::compare_xy( a.source(), b.source() ) == CGAL::SMALLER;
+    }
+    return CGAL::compare_xy( a.target(), b.target() ) == CGAL::SMALLER;
+}
+
+arrSignature getSignature( const tgMeshArrangement& arr )
+{
+    arrSignature sig;
+
+    arr.getSegments( sig.segments );
+    for ( unsigned int i=0; i<sig.segments.size(); i++ ) {
+        if ( CGAL::compare_xy( sig.segments[i].target(), sig.segments[i].source() ) == CGAL::SMALLER ) {
+            sig.segments[i] = sig.segments[i].opposite();
+        }
+    }
+    std::sort( sig.segments.begin(), sig.segments.end(), lessSegment );
+
+    return sig;
+}
+
+arrSignature loadSignature( const std::string& path )
+{
+    tgMesh            mesh;
+    tgMeshArrangement arr( &mesh );
+
+    arr.loadArrangement( path );
+
+    return getSignature( arr );
+}
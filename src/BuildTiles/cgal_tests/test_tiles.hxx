@@ -0,0 +1,64 @@
+// test_tiles.hxx -- synthetic tiles shared by the cgal tile tests
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+
+#ifndef _TEST_TILES_HXX
+#define _TEST_TILES_HXX
+
+#include <string>
+#include <vector>
+
+#include <simgear/bucket/newbucket.hxx>
+
+#include <terragear/mesh/tg_mesh.hxx>
+
+struct tileInput
+{
+    SGBucket                    bucket;
+    std::vector<tgPolygonSet>   polys;
+};
+
+// a tile arrangement reduced to something we can compare exactly - the
+// segments, each from its lower left end, sorted.  Doesn't depend on the
+// order the edges were created in.
+struct arrSignature
+{
+    std::vector<meshTriSegment> segments;
+
+    bool operator==( const arrSignature& other ) const {
+        return ( segments == other.segments );
+    }
+};
+
+// deterministic pseudo random generator - each tile gets its own sequence
+double nextRandom( unsigned long& seed );
+
+// overlapping quads with nodes close enough together to be clustered, and
+// a few spanning the tile edge so clipping generates fixed edge nodes.
+// generate them up front, so polygon meta ids don't depend on thread timing.
+void generateTile( unsigned int tile, tileInput& input );
+
+// <root>/<pass>/<tile>
+std::string tilePath( const std::string& root, const char* pass, unsigned int tile );
+
+bool readFile( const std::string& filename, std::vector<char>& contents );
+
+arrSignature getSignature( const tgMeshArrangement& arr );
+
+// the arrangement in the stage 1 container under path
+arrSignature loadSignature( const std::string& path );
+
+#endif // _TEST_TILES_HXX
@@ -27,6 +27,10 @@
 #endif
 
 #include <cstdio>
+#include <cstring>
+#include <getopt.h>
+
+#include <boost/thread.hpp>
 
 #include "tg_btg_mesh.hxx"
 
@@ -35,6 +39,9 @@
 #include <simgear/misc/sg_path.hxx>
 #include <simgear/io/sg_binobj.hxx>
 #include <simgear/debug/logstream.hxx>
+#include <simgear/threads/SGThread.hxx>
+#include <simgear/threads/SGGuard.hxx>
+#include <simgear/timing/timestamp.hxx>
 
 #include <terragear/BucketBox.hxx>
 #include <terragear/tg_shapefile.hxx>
@@ -52,7 +59,11 @@ static void usage( const std::string name ) {
 #endif
 
 // usage tglod minx, miny, maxx, maxy, level input_dir output_dir
-// 
+//
+// -l <level> builds that level, or with -t / --top-level=<level> every
+// level from -l up to the top level.  --threads[=N] collapses the boxes
+// of a level on N threads ( default: all cores ).
+//
 
 // first test : malta - generate 2 level 8 ( 0.25 x 0.25 ) tiles
 //              14.00,35.75 - 14.25,36.00
@@ -175,10 +186,13 @@ collectBtgFiles(const BucketBox& bucketBox, const std::string& sceneryPath, cons
     return hasLand;
 }
 
+// how subtile border vertices are matched - set once, before any builder starts
+static gaDedupBackend dedup_backend = GA_DEDUP_KDTREE;
+
 int
 collapseBtg(int level, const std::string& outfile, std::vector<subDivision>& subTiles)
 {
-    Arrays arrays;
+    Arrays arrays(dedup_backend);
     
     for (unsigned int i = 0; i < subTiles.size(); i++ ) {
         if ( !subTiles[i].fileName.empty() ) {
@@ -245,45 +259,140 @@ collapseBtg(int level, const std::string& outfile, std::vector<subDivision>& sub
     return EXIT_SUCCESS;
 }
 
+// serializes creating the output directories - sibling boxes share them
+static SGMutex dir_lock;
+
+// collapse the children of one box at the requested level into its btg
 int
-createTree(const BucketBox& bucketBox, const std::string& sceneryPath, const std::string& outPath, unsigned level)
+buildBox(const BucketBox& bucketBox, const std::string& sceneryPath, const std::string& outPath, unsigned level)
 {
-    if (bucketBox.getStartLevel() == level) {
-        // We want an other level of indirection for paging
-        //std::list<std::string> files;   // actual files to be read as mesh for collapse
-        //std::list<SGBucket>    land;    // level 9 buckets that are non-ocean
-        //std::list<SGBucket>    ocean;   // level 9 buckets that are ocean
-        std::vector<subDivision>   subTiles;
-        
-        // collectBtgFiles collects all children BTGs - and ocean btgs where files are not found.  
-        // TODO get the ration of land / ocean to determine what simplification to use
-        bool hasLand = collectBtgFiles(bucketBox, sceneryPath, outPath, subTiles);
-        if (!hasLand) {
-            return EXIT_SUCCESS;
-        }
-                
-        std::stringstream ss;
-        ss << outPath << "/";
-        for (unsigned i = 3; i < level; i += 2) {
-            ss << bucketBox.getParentBox(i) << "/";
-        }
-        
+    // We want an other level of indirection for paging
+    //std::list<std::string> files;   // actual files to be read as mesh for collapse
+    //std::list<SGBucket>    land;    // level 9 buckets that are non-ocean
+    //std::list<SGBucket>    ocean;   // level 9 buckets that are ocean
+    std::vector<subDivision>   subTiles;
+
+    // collectBtgFiles collects all children BTGs - and ocean btgs where files are not found.
+    // TODO get the ration of land / ocean to determine what simplification to use
+    bool hasLand = collectBtgFiles(bucketBox, sceneryPath, outPath, subTiles);
+    if (!hasLand) {
+        return EXIT_SUCCESS;
+    }
+
+    std::stringstream ss;
+    ss << outPath << "/";
+    for (unsigned i = 3; i < level; i += 2) {
+        ss << bucketBox.getParentBox(i) << "/";
+    }
+
+    {
+        SGGuard<SGMutex> g(dir_lock);
         SGPath(ss.str()).create_dir(0755);
-        ss << bucketBox << ".btg.gz";
-        collapseBtg(level, ss.str(), subTiles);
-   
-        //exit(0);
+    }
+
+    ss << bucketBox << ".btg.gz";
+    return collapseBtg(level, ss.str(), subTiles);
+}
+
+// find every box at the requested level
+void
+collectBoxes(const BucketBox& bucketBox, unsigned level, std::vector<BucketBox>& boxes)
+{
+    if (bucketBox.getStartLevel() == level) {
+        boxes.push_back(bucketBox);
     } else {
         BucketBox bucketBoxList[100];
         unsigned numTiles = bucketBox.getSubDivision(bucketBoxList, 100);
         for (unsigned i = 0; i < numTiles; ++i) {
-            if (EXIT_FAILURE == createTree(bucketBoxList[i], sceneryPath, outPath, level)) {
-                return EXIT_FAILURE;
+            collectBoxes(bucketBoxList[i], level, boxes);
+        }
+    }
+}
+
+// The boxes of a level only read their children ( the level below, or the
+// scenery for level 8 ), so they are collapsed concurrently.  A level is
+// started once the level below it is complete.
+class BoxQueue {
+public:
+    BoxQueue(const std::vector<BucketBox>& b) : boxes(b), next(0), failed(0) {}
+
+    bool pop(BucketBox& b) {
+        SGGuard<SGMutex> g(lock);
+
+        if (next >= boxes.size()) {
+            return false;
+        }
+
+        b = boxes[next++];
+        return true;
+    }
+
+    void fail(void) {
+        SGGuard<SGMutex> g(lock);
+        failed++;
+    }
+
+    unsigned int getFailed(void) const {
+        return failed;
+    }
+
+private:
+    const std::vector<BucketBox>&   boxes;
+    unsigned int                    next;
+    unsigned int                    failed;
+    SGMutex                         lock;
+};
+
+class LodBuilder : public SGThread
+{
+public:
+    LodBuilder(BoxQueue& q, const std::string& sp, const std::string& op, unsigned l) :
+        queue(q), sceneryPath(sp), outPath(op), level(l)
+    {
+    }
+
+private:
+    virtual void run()
+    {
+        BucketBox bucketBox;
+
+        while (queue.pop(bucketBox)) {
+            if (EXIT_FAILURE == buildBox(bucketBox, sceneryPath, outPath, level)) {
+                queue.fail();
             }
         }
     }
-    
-    return EXIT_SUCCESS;
+
+    BoxQueue&       queue;
+    std::string     sceneryPath;
+    std::string     outPath;
+    unsigned        level;
+};
+
+int
+createTree(const BucketBox& bucketBox, const std::string& sceneryPath, const std::string& outPath, unsigned level, int num_threads)
+{
+    std::vector<BucketBox> boxes;
+    collectBoxes(bucketBox, level, boxes);
+
+    SGTimeStamp start = SGTimeStamp::now();
+
+    BoxQueue queue(boxes);
+    std::vector<LodBuilder*> builders;
+    for (int i = 0; i < num_threads; i++) {
+        builders.push_back(new LodBuilder(queue, sceneryPath, outPath, level));
+        builders.back()->start();
+    }
+
+    for (unsigned i = 0; i < builders.size(); i++) {
+        builders[i]->join();
+        delete builders[i];
+    }
+
+    SG_LOG(SG_GENERAL, SG_ALERT, "Level " << level << ": " << boxes.size() << " boxes in " << (SGTimeStamp::now() - start).toSecs() <<
+                                 " s on " << num_threads << " threads, " << queue.getFailed() << " failed");
+
+    return queue.getFailed() ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
 
@@ -292,8 +401,18 @@ int main(int argc, char **argv)
     std::string outfile;
     std::string sceneryPath = "/share/scenery/svn/Terrain/";
     unsigned level = ~0u;
+    unsigned top_level = ~0u;
+    int num_threads = 1;
     int c;
-    while ((c = getopt(argc, argv, "l:o:p:S:")) != EOF) {
+
+    static struct option long_options[] = {
+        { "threads",    optional_argument, NULL, 'j' },
+        { "top-level",  required_argument, NULL, 't' },
+        { "dedup",      required_argument, NULL, 'd' },
+        { NULL,         0,                 NULL, 0   }
+    };
+
+    while ((c = getopt_long(argc, argv, "l:o:p:S:t:j::", long_options, NULL)) != EOF) {
         switch (c) {
             case 'l':
                 level = atoi(optarg);
@@ -308,6 +427,22 @@ int main(int argc, char **argv)
             case 'S':
                 sceneryPath = optarg;
                 break;
+            case 't':
+                top_level = atoi(optarg);
+                break;
+            case 'j':
+                num_threads = optarg ? atoi(optarg) : boost::thread::hardware_concurrency();
+                break;
+            case 'd':
+                if (!strcmp(optarg, "hash")) {
+                    dedup_backend = GA_DEDUP_GRID_HASH;
+                } else if (!strcmp(optarg, "kdtree")) {
+                    dedup_backend = GA_DEDUP_KDTREE;
+                } else {
+                    std::cerr << "Unknown --dedup backend " << optarg << " ( kdtree or hash )" << std::endl;
+                    return EXIT_FAILURE;
+                }
+                break;
         }
     }
     
@@ -315,11 +450,29 @@ int main(int argc, char **argv)
         std::cerr << "No output file or directory given." << std::endl;
         return EXIT_FAILURE;
     }
-    
+
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+
+    // by default, just the one level
+    if (top_level > level) {
+        top_level = level;
+    }
+
     if (level <= 8) {
-        SG_LOG(SG_GENERAL, SG_ALERT, "Create level " << level );
-        return createTree(BucketBox(-180, -90, 360, 180), sceneryPath, outfile, level);
+        SGTimeStamp start = SGTimeStamp::now();
+
+        // each level is built from the one below it
+        for (int l = level; l >= (int)top_level; l--) {
+            SG_LOG(SG_GENERAL, SG_ALERT, "Create level " << l );
+            if (EXIT_FAILURE == createTree(BucketBox(-180, -90, 360, 180), sceneryPath, outfile, l, num_threads)) {
+                return EXIT_FAILURE;
+            }
+        }
+
+        SG_LOG(SG_GENERAL, SG_ALERT, "Levels " << level << " to " << top_level << " done in " << (SGTimeStamp::now() - start).toSecs() << " s");
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -37,6 +37,11 @@
 
 #include "tg_btg_mesh.hxx"
 
+// Write the bad triangles of each mesh to ./simp_dbg.  Meshes are built on
+// every LodBuilder thread, and the shapefile writes aren't locked, so only
+// turn this on when running a single thread.
+#define DEBUG_BAD_TRIS          (0)
+
 template <class HDS>
 class tgBuildBtgMesh : public CGAL::Modifier_base<HDS> {
 public:
@@ -277,7 +282,7 @@ void tgReadArraysAsMesh( const Arrays& arrays, tgBtgMesh& mesh, const std::strin
     tgBuildArrayMesh<tgBtgHalfedgeDS> m(arrays);
     mesh.delegate( m );
     
-#if 1
+#if DEBUG_BAD_TRIS
     char datasource[64];    
     char mesh_name[1024];
     
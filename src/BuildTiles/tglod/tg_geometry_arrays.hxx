@@ -2,6 +2,11 @@
 #define __TG_GEOMETRY_ARRAYS_HXX__
 
 
+#include <cmath>
+
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+
 #include <simgear/debug/logstream.hxx>
 
 #include <terragear/tg_unique_vec2f.hxx>
@@ -31,6 +36,100 @@ typedef CGAL::Orthogonal_k_neighbor_search<gaTraits>        gaNeighborSearch;
 typedef CGAL::Fuzzy_sphere<gaTraits>                        gaFuzzyCircle;
 typedef gaNeighborSearch::Tree                              gaTree;
 
+// Vertices on a subtile border are merged with any vertex already added
+// within this distance ( in degrees, compared in 2d )
+#define GA_BORDER_EPSILON       (0.00001)
+#define GA_MATCH_RADIUS         (0.0000005)
+
+// How Arrays finds the vertex a border vertex duplicates
+enum gaDedupBackend {
+    GA_DEDUP_KDTREE,        // fuzzy circle search in a CGAL kd-tree
+    GA_DEDUP_GRID_HASH      // integer grid cells of the match radius
+};
+
+// Fixed precision spatial hash of 2d points.  Each point goes in the
+// grid cell its lon / lat quantize to, with cells the size of the match
+// radius, so any point within the radius is in the same or one of the 8
+// neighbouring cells.  Points in a cell are chained through next[], so
+// the map only holds one index per occupied cell.
+class gaGridHash {
+public:
+    gaGridHash( double r ) : radius( r ), scale( 1.0 / r ) {}
+
+    void reserve( unsigned int n ) {
+        xs.reserve( n );
+        ys.reserve( n );
+        next.reserve( n );
+    }
+
+    // add point index, which must be the next index
+    void insert( double x, double y ) {
+        boost::uint64_t key = cellKey( cell( x ), cell( y ) );
+        unsigned int    index = xs.size();
+
+        boost::unordered_map<boost::uint64_t, unsigned int>::iterator it = heads.find( key );
+
+        xs.push_back( x );
+        ys.push_back( y );
+        if ( it == heads.end() ) {
+            next.push_back( (unsigned int)NONE );
+            heads[key] = index;
+        } else {
+            next.push_back( it->second );
+            it->second = index;
+        }
+    }
+
+    // the nearest point within the radius, ( lowest index on a tie ).
+    // false if there is none
+    bool find( double x, double y, unsigned int& index ) const {
+        long long cx = cell( x ), cy = cell( y );
+        double    best = radius * radius;
+        bool      found = false;
+
+        for ( long long i = cx-1; i <= cx+1; i++ ) {
+            for ( long long j = cy-1; j <= cy+1; j++ ) {
+                boost::unordered_map<boost::uint64_t, unsigned int>::const_iterator it = heads.find( cellKey( i, j ) );
+                if ( it == heads.end() ) {
+                    continue;
+                }
+
+                for ( unsigned int k = it->second; k != NONE; k = next[k] ) {
+                    double dx = xs[k] - x;
+                    double dy = ys[k] - y;
+                    double d2 = dx*dx + dy*dy;
+
+                    if ( d2 < best || ( d2 == best && ( !found || k < index ) ) ) {
+                        best  = d2;
+                        index = k;
+                        found = true;
+                    }
+                }
+            }
+        }
+
+        return found;
+    }
+
+private:
+    static const unsigned int NONE = 0xFFFFFFFF;
+
+    long long cell( double v ) const {
+        return (long long)std::floor( v * scale );
+    }
+
+    static boost::uint64_t cellKey( long long i, long long j ) {
+        return ( (boost::uint64_t)(boost::uint32_t)i << 32 ) | (boost::uint32_t)j;
+    }
+
+    double                                              radius;
+    double                                              scale;
+    std::vector<double>                                 xs;
+    std::vector<double>                                 ys;
+    std::vector<unsigned int>                           next;
+    boost::unordered_map<boost::uint64_t, unsigned int> heads;
+};
+
 struct VertNormTex {
   VertNormTex() { }
   VertNormTex(const SGVec3d& v, const SGVec3f& n, const SGVec2f& t) :
@@ -69,26 +168,36 @@ typedef std::map< const std::string, PointList > matTris;
 
 class Arrays {
 public:
+    Arrays( gaDedupBackend b = GA_DEDUP_KDTREE ) : backend( b ), vertexHash( GA_MATCH_RADIUS ) {}
+
+    static bool isBorder( const SGGeod& min, const SGGeod& max, const SGGeod& node ) {
+        return (fabs ( node.getLongitudeDeg() - min.getLongitudeDeg() ) < GA_BORDER_EPSILON) ||
+               (fabs ( node.getLongitudeDeg() - max.getLongitudeDeg() ) < GA_BORDER_EPSILON) ||
+               (fabs ( node.getLatitudeDeg()  - min.getLatitudeDeg() )  < GA_BORDER_EPSILON) || 
+               (fabs ( node.getLatitudeDeg()  - max.getLatitudeDeg() )  < GA_BORDER_EPSILON);
+    }
+
     unsigned int addVertex( const SGGeod& min, const SGGeod& max, const SGVec3d& v ) {
         // we compare the vertices in 2d 
         // ( 3d sphere picks up false positives before we stitch, 
         //   and we need to know the tile boundaries )
-        
-        SGGeod          node = SGGeod::fromCart(v);
+        SGGeod node = SGGeod::fromCart(v);
+
+        if ( backend == GA_DEDUP_GRID_HASH ) {
+            return addVertexHash( isBorder( min, max, node ), node, v );
+        }
+
         gaPoint         pt( node.getLongitudeDeg(), node.getLatitudeDeg() );
         unsigned int    index;
         std::list<gaPointWithIndex>             result;
         std::list<gaPointWithIndex>::iterator   it;
         
         // if node is near the tile border, make sure it isn't a dupe
-        if ( (fabs ( node.getLongitudeDeg() - min.getLongitudeDeg() ) < 0.00001) ||
-             (fabs ( node.getLongitudeDeg() - max.getLongitudeDeg() ) < 0.00001) ||
-             (fabs ( node.getLatitudeDeg()  - min.getLatitudeDeg() )  < 0.00001) || 
-             (fabs ( node.getLatitudeDeg()  - max.getLatitudeDeg() )  < 0.00001) ) {
+        if ( isBorder( min, max, node ) ) {
             //SG_LOG(SG_TERRAIN, SG_ALERT, "Found border node " << std::setprecision(8) << node << " min is " << min << " max is " << max );
                 
             // first search the tree for the vertex
-            gaFuzzyCircle search = gaFuzzyCircle( pt, 0.0000005 );
+            gaFuzzyCircle search = gaFuzzyCircle( pt, GA_MATCH_RADIUS );
             
             // perform the query
             vertexTree.search( std::back_inserter( result ), search );
@@ -115,7 +224,31 @@ public:
         
         return index;
     }
-    
+
+    // add a whole vertex array ( eg the nodes of a btg ) at once, and
+    // return the index of each vertex in indices
+    void addVertices( const SGGeod& min, const SGGeod& max, const SGVec3d& center,
+                      const std::vector<SGVec3d>& vertices, std::vector<unsigned int>& indices ) {
+        indices.resize( vertices.size() );
+
+        if ( backend != GA_DEDUP_GRID_HASH ) {
+            for ( unsigned int i=0; i<vertices.size(); i++ ) {
+                indices[i] = addVertex( min, max, vertices[i] + center );
+            }
+            return;
+        }
+
+        vertexVector.reserve( vertexVector.size() + vertices.size() );
+        vertexHash.reserve( vertexVector.size() + vertices.size() );
+
+        for ( unsigned int i=0; i<vertices.size(); i++ ) {
+            SGVec3d v    = vertices[i] + center;
+            SGGeod  node = SGGeod::fromCart(v);
+
+            indices[i] = addVertexHash( isBorder( min, max, node ), node, v );
+        }
+    }
+
     void insertPoint( const SGGeod& min, const SGGeod& max, const SGVec3d& center, const std::string& material, const SGVec3d& v, const SGVec3f& n, const SGVec2f& t)
     {
         insertPoint( min, max, center, material, VertNormTex(v, n, t) );
@@ -189,15 +322,13 @@ public:
                       const int_list& fans_n,
                       const int_list& fans_tc)
     {
-        std::map< unsigned int, unsigned int >  vertexMap;
+        std::vector<unsigned int>               vertexMap;
         std::map< unsigned int, unsigned int >  normalMap;
         std::map< unsigned int, unsigned int >  texCoordMap;
 
         VertNormTexIndex v0, v1, v2;
                 
-        for ( unsigned int i=0; i<fan_vertices.size(); i++ ) {
-            vertexMap[i] = addVertex( min, max, fan_vertices[i] + center );
-        }
+        addVertices( min, max, center, fan_vertices, vertexMap );
         for ( unsigned int i=0; i<fan_normals.size(); i++ ) {
             normalMap[i] = normals.add( fan_normals[i] );
         }
@@ -235,16 +366,14 @@ public:
         // insert the .btg vertexes into the array tree.  remember the new index
         // duplicate vertex ( shared between btg will be dropped )
         // 2nd btg indexes will not match the geometry - need to look them up
-        std::map< unsigned int, unsigned int >  vertexMap;
-        std::map< unsigned int, unsigned int >  normalMap;
-        std::map< unsigned int, unsigned int >  texCoordMap;
+        std::vector<unsigned int>  vertexMap;
+        std::vector<unsigned int>  normalMap( obj.get_normals().size() );
+        std::vector<unsigned int>  texCoordMap( obj.get_texcoords().size() );
         SGVec3d center  = obj.get_gbs_center();
         
         // first, read in the vertex information
-        for ( unsigned int i=0; i<obj.get_wgs84_nodes().size(); i++ ) {
-            SGVec3d vertex = obj.get_wgs84_nodes()[i]+center;
-            vertexMap[i] = addVertex( min, max, vertex );
-        }
+        addVertices( min, max, center, obj.get_wgs84_nodes(), vertexMap );
+
         for ( unsigned int i=0; i<obj.get_normals().size(); i++ ) {
             SGVec3f normal = obj.get_normals()[i];
             normalMap[i] = normals.add( normal );
@@ -305,8 +434,28 @@ public:
     const std::vector<SGVec3d>& getVertexList( void ) const {
         return vertexVector;
     }
+
+private:
+    unsigned int addVertexHash( bool border, const SGGeod& node, const SGVec3d& v ) {
+        unsigned int index;
+
+        // if node is near the tile border, make sure it isn't a dupe
+        if ( border && vertexHash.find( node.getLongitudeDeg(), node.getLatitudeDeg(), index ) ) {
+            return index;
+        }
+
+        index = vertexVector.size();
+        vertexVector.push_back( v );
+        vertexHash.insert( node.getLongitudeDeg(), node.getLatitudeDeg() );
+
+        return index;
+    }
+
+public:
     
+    gaDedupBackend                          backend;
     gaTree                                  vertexTree;
+    gaGridHash                              vertexHash;
     std::vector<SGVec3d>                    vertexVector;
 
     UniqueSGVec3fSet     normals;
@@ -68,7 +68,7 @@ void tgMesh::generate( void )
         // we should remember be checking the delta in interiorPoints to see if we have 
         // polys that don't meat this criteria.
         // and if it doesn't - what do we do?
-        meshArrangement.cleanArrangement( lock );
+        meshArrangement.cleanArrangement();
 
         // step 4 - create constrained triangulation with arrangement edges as the constraints
         meshTriangulation.constrainedTriangulateWithEdgeModification( meshArrangement );
@@ -99,29 +99,17 @@ bool tgMesh::loadStage1( const std::string& basePath, const SGBucket& bucket )
     return isOcean;
 }
 
-tgArray* tgMesh::loadElevationArray( const std::string& demBase, const SGBucket& bucket )
+// neighbouring tiles share most of their arrays - get them from the cache
+tgArrayPtr tgMesh::loadElevationArray( const std::string& demBase, const SGBucket& bucket )
 {
-    std::string arrayPath = demBase + "/" + bucket.gen_base_path() + "/" + bucket.gen_index_str();
-    tgArray* array = new tgArray();
-
-    if ( array->open(arrayPath) ) {
-        SG_LOG(SG_GENERAL, SG_INFO, "Opened Array file " << arrayPath);
-
-        array->parse( bucket );
-        array->remove_voids( );
-        array->close();
-    } else {
-        SG_LOG(SG_GENERAL, SG_INFO, "Could not open Array file " << arrayPath);
-    }
-
-    return array;
+    return tgArrayCache::instance().get( demBase, bucket );
 }
 
 
 void tgMesh::calcElevation( const std::string& basePath )
 {
     // load this, and surrounding tile elevation data
-    std::vector<tgArray*> northArrays;
+    std::vector<tgArrayPtr> northArrays;
     std::vector<SGBucket> northBuckets;
     b.siblings( -1, 1, northBuckets );
     b.siblings(  0, 1, northBuckets );
@@ -130,7 +118,7 @@ void tgMesh::calcElevation( const std::string& basePath )
         northArrays.push_back( loadElevationArray( basePath, northBuckets[i] ) );
     }
 
-    std::vector<tgArray*> southArrays;
+    std::vector<tgArrayPtr> southArrays;
     std::vector<SGBucket> southBuckets;
     b.siblings( -1, -1, southBuckets );
     b.siblings(  0, -1, southBuckets );
@@ -139,18 +127,18 @@ void tgMesh::calcElevation( const std::string& basePath )
         southArrays.push_back( loadElevationArray( basePath, southBuckets[i] ) );
     }
 
-    tgArray* eastArray;
+    tgArrayPtr eastArray;
     SGBucket eastBucket = b.sibling( 1, 0);
     eastArray = loadElevationArray( basePath, eastBucket );
 
-    tgArray* westArray;
+    tgArrayPtr westArray;
     SGBucket westBucket = b.sibling(-1, 0);
     westArray = loadElevationArray( basePath, westBucket );
 
-    tgArray* tileArray = loadElevationArray( basePath, b );
+    tgArrayPtr tileArray = loadElevationArray( basePath, b );
 
     // first calc the elevation of all nodes in this tile.
-    meshTriangulation.calcTileElevations( tileArray );
+    meshTriangulation.calcTileElevations( tileArray.get() );
 
 #if 0 // shared edges - is it needed?
 
@@ -233,17 +221,63 @@ void tgMesh::calcFaceNormals( void )
 }
 
 
-void tgMesh::save( const std::string& path ) const
+bool tgMesh::save( const std::string& path ) const
 {
-    meshArrangement.toShapefile( path, "stage1_arrangement" );
-    meshTriangulation.saveSharedEdgeNodes( path );
-    meshTriangulation.saveTds( path );
+    bool ok = true;
+
+    if ( format == FORMAT_BINARY ) {
+        tgMeshBinaryWriter writer;
+
+        meshArrangement.toBinary( writer );
+        meshTriangulation.saveSharedEdgeNodes( writer );
+        meshTriangulation.saveTds( writer );
+
+        ok = writer.write( path + "/" + TG_MESH_STAGE1_BINARY );
+    }
+
+    if ( format == FORMAT_SHAPEFILE || exportShapefiles ) {
+        saveShapefiles( path, true );
+    }
+
+    return ok;
 }
 
-void tgMesh::save2( const std::string& path ) const
+bool tgMesh::save2( const std::string& path ) const
 {
-    meshTriangulation.saveTds( path );
+    bool ok = true;
+
+    if ( format == FORMAT_BINARY ) {
+        tgMeshBinaryWriter writer;
+
+        meshTriangulation.saveTds( writer );
+
+        ok = writer.write( path + "/" + TG_MESH_STAGE2_BINARY );
+    }
+
+    if ( format == FORMAT_SHAPEFILE || exportShapefiles ) {
+        saveShapefiles( path, false );
+    }
 
     // generate edge node list
     // meshTriangulation.saveSharedEdgeFaces( path );
-}
\ No newline at end of file
+
+    return ok;
+}
+
+// GDAL shapefile creation is serialized across construct threads
+void tgMesh::saveShapefiles( const std::string& path, bool withArrangement ) const
+{
+    if ( lock ) {
+        lock->lock();
+    }
+
+    if ( withArrangement ) {
+        meshArrangement.toShapefile( path, "stage1_arrangement" );
+        meshTriangulation.saveSharedEdgeNodes( path );
+    }
+    meshTriangulation.saveTds( path );
+
+    if ( lock ) {
+        lock->unlock();
+    }
+}
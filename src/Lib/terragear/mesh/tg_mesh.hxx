@@ -5,10 +5,11 @@
 
 #include <terragear/polygon_set/tg_polygon_def.hxx>
 #include <terragear/polygon_set/tg_polygon_set.hxx>
-#include <terragear/tg_array.hxx>
+#include <terragear/tg_array_cache.hxx>
 #include <terragear/tg_mutex.hxx>
 
 #include "tg_mesh_def.hxx"
+#include "tg_mesh_binary.hxx"
 
 #include "tg_mesh_arrangement.hxx"
 #include "tg_mesh_triangulation.hxx"
@@ -27,11 +28,21 @@
 class tgMesh
 {
 public:
-    tgMesh() : meshArrangement(this), meshTriangulation(this), meshSurface(this) {};
+    // stage intermediate storage : the binary container is the default.
+    // shapefiles can still be written next to it for viewing in QGIS.
+    typedef enum {
+        FORMAT_BINARY,
+        FORMAT_SHAPEFILE
+    } IntermediateFormat;
+
+    tgMesh() : meshArrangement(this), meshTriangulation(this), meshSurface(this), format(FORMAT_BINARY), exportShapefiles(false), validateInput(true), incrementalCleaning(false), lock(NULL) {};
 
     void initDebug( const std::string& dbgRoot );
     void initPriorities( const std::vector<std::string>& priorityNames );
     void setLock( tgMutex* l ) { lock = l; }
+    void setIntermediateFormat( IntermediateFormat f, bool exportShp ) { format = f; exportShapefiles = exportShp; }
+    void setValidateInput( bool v ) { validateInput = v; }
+    void setIncrementalCleaning( bool i ) { incrementalCleaning = i; }
     void clipAgainstBucket( const SGBucket& bucket );
 
     void clear( void );
@@ -53,8 +64,9 @@ public:
 
     void toShapefiles( const char* dataset ) const;
 
-    void save( const std::string& path ) const;
-    void save2( const std::string& path ) const;
+    // return false if the binary container couldn't be written
+    bool save( const std::string& path ) const;
+    bool save2( const std::string& path ) const;
 
     std::string getDebugPath( void ) { return debugPath; }
     SGBucket    getBucket( void )    { return b; }
@@ -63,10 +75,12 @@ public:
     friend class tgMeshTriangulation;
 
 private:
-    tgArray* loadElevationArray( const std::string& demBase, const SGBucket& bucket );
+    tgArrayPtr loadElevationArray( const std::string& demBase, const SGBucket& bucket );
 
     void saveIncidentFaces( const std::string& path, const char* layer, const std::vector<meshTriVertexHandle>& vertexes ) const;
 
+    void saveShapefiles( const std::string& path, bool withArrangement ) const;
+
     typedef enum {
         LAYER_FIELDS_NONE,
         LAYER_FIELDS_ARR,
@@ -82,6 +96,10 @@ private:
     tgMeshPolyhedralSurface         meshSurface;
     SGBucket                        b;
     bool                            clipBucket;
+    IntermediateFormat              format;
+    bool                            exportShapefiles;
+    bool                            validateInput;
+    bool                            incrementalCleaning;
     tgMutex*                        lock;
     std::string                     debugPath;
 };
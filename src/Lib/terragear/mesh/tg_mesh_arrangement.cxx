@@ -89,6 +89,8 @@ void tgMeshArrangement::clipPolys( const SGBucket& b, bool clipBucket )
 
     SG_LOG( SG_GENERAL, SG_DEBUG, "tgMeshArrangement::clipPolys : start" );
 
+    accum.setValidation( mesh->validateInput );
+
     if ( clipBucket ) {
         // create exact bucket
         bucketPoly.push_back( cgalPoly_Point( b.get_corner( SG_BUCKET_SW ).getLongitudeDeg(), b.get_corner( SG_BUCKET_SW ).getLatitudeDeg() ) );
@@ -185,18 +187,25 @@ void tgMeshArrangement::arrangePolys( void )
 meshArrFaceConstHandle tgMeshArrangement::findPolyFace( meshArrFaceConstHandle f ) const
 {
     meshArrFaceConstHandle face = (meshArrFaceConstHandle)NULL;
-    bool found = false;
 
-    for ( unsigned int i=0; i<metaLookup.size() && !found; i++ ) {
-        if ( metaLookup[i].face == f ) {
-            face = f;
-            found = true;
-        }
+    if ( metaIndex.is_defined( f ) ) {
+        face = f;
     }
 
     return face;
 }
 
+void tgMeshArrangement::addFaceMeta( meshArrFaceConstHandle f, const cgalPoly_Point& qp, const tgPolygonSetMeta& meta )
+{
+    // the first poly to claim a face keeps it in the index, as the linear
+    // search found it first
+    if ( !metaIndex.is_defined( f ) ) {
+        metaIndex[f] = metaLookup.size();
+    }
+
+    metaLookup.push_back( tgMeshFaceMeta(f, qp, meta) );
+}
+
 // lookup a face in the arrangement from a point in the triangulation
 // need to convert the point from EPICK to EPECK
 meshArrFaceConstHandle tgMeshArrangement::findMeshFace( const meshTriPoint& tPt ) const
@@ -251,9 +260,8 @@ void tgMeshArrangement::arrangementInsert( const std::vector<tgPolygonSet>::iter
     // convert poly segs to arr segs
     toMeshArrSegs( segs, arrSegs );
 
-    mesh->lock->lock();
+    // no lock - each tile owns its arrangement, see tg_mesh_def.hxx
     CGAL::insert( meshArr, arrSegs.begin(), arrSegs.end() );
-    mesh->lock->unlock();
 }
 
 void tgMeshArrangement::loadArrangement( const std::string& path )
@@ -263,15 +271,18 @@ void tgMeshArrangement::loadArrangement( const std::string& path )
     std::vector<meshArrSegment> edgelist;
     std::string filePath;
 
-    filePath = path + "/stage1_arrangement_faces.shp";
-    fromShapefile( filePath, edgelist );
+    if ( mesh->format == tgMesh::FORMAT_BINARY ) {
+        filePath = path + "/" + TG_MESH_STAGE1_BINARY;
+        fromBinary( filePath, edgelist );
+    } else {
+        filePath = path + "/stage1_arrangement_faces.shp";
+        fromShapefile( filePath, edgelist );
+    }
 
     // add edges to arrangement
     meshArr.clear();
 
-    mesh->lock->lock();
     CGAL::insert( meshArr, edgelist.begin(), edgelist.end() );
-    mesh->lock->unlock();
 
     // save it so we can see it...
     // toShapefile( mesh->getDebugPath(), "stage2_arrangement" );
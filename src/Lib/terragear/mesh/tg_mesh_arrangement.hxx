@@ -1,6 +1,8 @@
 #ifndef __TG_MESH_ARRANGEMENT_HXX__
 #define __TG_MESH_ARRANGEMENT_HXX__
 
+#include <CGAL/Unique_hash_map.h>
+
 #include "tg_mesh.hxx"
 
 // forward declarations
@@ -40,7 +42,7 @@ typedef std::vector<tgSharpAngleSeries>   tgSharpAngleSeriesList;
 class tgMeshArrangement
 {
 public:
-    tgMeshArrangement( tgMesh* m ) { mesh = m; }
+    tgMeshArrangement( tgMesh* m ) : metaIndex( -1 ) { mesh = m; }
 
     typedef enum {
         SRC_POINT_OK        = 0,
@@ -51,6 +53,7 @@ public:
     void clear( void ) {
         meshArr.clear();
         metaLookup.clear();
+        metaIndex.clear( -1 );
 
         // clear source polys
         for ( unsigned int i=0; i<numPriorities; i++ ) {
@@ -69,7 +72,7 @@ public:
     tgPolygonSet join( unsigned int priority, const tgPolygonSetMeta& meta );
 
     void clipPolys( const SGBucket& b, bool clipBucket );
-    void cleanArrangement( SGMutex* lock );
+    void cleanArrangement( void );
     void arrangePolys( void );
 
     void loadArrangement( const std::string& path );
@@ -86,6 +89,8 @@ private:
 
     bool isEdgeVertex( meshArrVertexConstHandle v );
     void doClusterEdges( const tgCluster& cluster );
+    void doClusterEdgesIncremental( const tgCluster& cluster );
+    void insertSegments( const std::vector<meshArrSegment>& segs );
 
     SrcPointOp_e checkPointNearEdge( const meshArrPoint& pt, meshArrFaceConstHandle fh, meshArrPoint& projPt );
     void doProjectPointsToEdges( const tgCluster& cluster );
@@ -96,12 +101,14 @@ private:
     void doRemoveSmallAreas( void );
 
     void doRemoveAntenna( void );
-    void doRemoveSpikes( SGMutex* lock );
+    void doRemoveSpikes( void );
     void insertAngleIntoSeries( tgSharpAngleSeriesList& saSeriesList, const tgSharpAngle& a );
     void addSharpAngle( std::vector<tgSharpAngle>& angles, meshArrVertexHandle v1, meshArrVertexHandle v2, meshArrVertexHandle v3, double angle );
     void findSpikes( meshArrFaceHandle f, std::vector<tgSharpAngle>& angles, std::vector<meshArrHalfedgeHandle>& dups );
 
-    void doSnapRound( SGMutex* lock );
+    void doSnapRound( void );
+
+    void addFaceMeta( meshArrFaceConstHandle f, const cgalPoly_Point& qp, const tgPolygonSetMeta& meta );
 
     meshArrPoint toMeshArrPoint( const meshTriPoint& tPoint ) const {
         return meshArrPoint( tPoint.x(), tPoint.y() );
@@ -125,6 +132,9 @@ public:
     void toShapefile( const std::string& datasource, const char* layer ) const;
     void fromShapefile( const std::string& filename, std::vector<meshArrSegment>& segments ) const;
 
+    void toBinary( tgMeshBinaryWriter& writer ) const;
+    void fromBinary( const std::string& filename, std::vector<meshArrSegment>& segments ) const;
+
 private:
     // helper - save a segment
     void toShapefile( OGRLayer* poLayer, const meshArrSegment& seg, const char* desc ) const;
@@ -149,6 +159,9 @@ private:
     meshArrangement                 meshArr;
     meshArrLandmarks_pl             meshPointLocation;
     std::vector<tgMeshFaceMeta>     metaLookup;
+
+    // arrangement face -> index of its first entry in metaLookup
+    CGAL::Unique_hash_map<meshArrFaceConstHandle, int>  metaIndex;
 };
 
 #endif /* __TG_MESH_ARRANGEMENT_HXX__ */
@@ -1,3 +1,5 @@
+#include <CGAL/Unique_hash_map.h>
+
 #include <simgear/debug/logstream.hxx>
 
 // TODO - cluster used by vector intersection code, and mesh - let's clean it up
@@ -11,6 +13,11 @@
 
 void tgMeshArrangement::doClusterEdges( const tgCluster& cluster )
 {
+    if ( mesh->incrementalCleaning ) {
+        doClusterEdgesIncremental( cluster );
+        return;
+    }
+
     meshArrEdgeConstIterator eit;
     std::vector<meshArrSegment> segs;
     for (eit = meshArr.edges_begin(); eit != meshArr.edges_end(); eit++) {
@@ -30,6 +37,105 @@ void tgMeshArrangement::doClusterEdges( const tgCluster& cluster )
     CGAL::insert( meshArr, segs.begin(), segs.end() );    
 }
 
+// same result as the rebuild above, but only the edges at a vertex the
+// cluster moves are removed, and their clustered segments inserted back.
+// The moving vertices come from the cluster, and are found with the
+// landmarks, so the edits follow the number of clustered vertices rather
+// than the size of the tile.
+void tgMeshArrangement::doClusterEdgesIncremental( const tgCluster& cluster )
+{
+    std::vector<EPECPoint_2>            from, to;
+    std::vector<meshArrVertexHandle>    movedVertices;
+    std::vector<meshArrHalfedgeHandle>  removeEdges;
+    std::vector<meshArrVertexHandle>    removeVertices;
+    std::vector<meshArrSegment>         segs;
+
+    CGAL::Unique_hash_map<meshArrVertexHandle, meshArrPoint> clustered;
+    CGAL::Unique_hash_map<meshArrVertexHandle, bool>         moved( false );
+    CGAL::Unique_hash_map<meshArrHalfedgeHandle, bool>       queued( false );
+
+    cluster.GetMoves( from, to );
+    for ( unsigned int i=0; i<from.size(); i++ ) {
+        CGAL::Object             obj = meshPointLocation.locate( toMeshArrPoint( from[i] ) );
+        meshArrVertexConstHandle v;
+
+        if ( CGAL::assign( v, obj ) ) {
+            meshArrVertexHandle vh = meshArr.non_const_handle( v );
+
+            if ( !moved[vh] ) {
+                clustered[vh] = toMeshArrPoint( to[i] );
+                moved[vh]     = true;
+                movedVertices.push_back( vh );
+            }
+        }
+    }
+
+    for ( unsigned int i=0; i<movedVertices.size(); i++ ) {
+        meshArrVertexHandle v = movedVertices[i];
+
+        if ( v->is_isolated() ) {
+            continue;
+        }
+
+        meshArrIncidentHalfedgeCirculator first = v->incident_halfedges();
+        meshArrIncidentHalfedgeCirculator cur   = first;
+        do {
+            meshArrHalfedgeHandle he = cur;
+
+            if ( !queued[he] ) {
+                queued[he]         = true;
+                queued[he->twin()] = true;
+                removeEdges.push_back( he );
+
+                meshArrVertexHandle src = he->source();
+                meshArrPoint        srcPoint = moved[src] ? clustered[src] : src->point();
+
+                if ( srcPoint != clustered[v] ) {
+                    segs.push_back( meshArrSegment( srcPoint, clustered[v] ) );
+                }
+            }
+            cur++;
+        } while ( cur != first );
+    }
+
+    // the rebuild only inserts edges, so isolated vertices go
+    if ( meshArr.number_of_isolated_vertices() ) {
+        for ( meshArrVertexIterator vit = meshArr.vertices_begin(); vit != meshArr.vertices_end(); vit++ ) {
+            if ( vit->is_isolated() ) {
+                removeVertices.push_back( vit );
+            }
+        }
+    }
+
+    SG_LOG( SG_GENERAL, SG_DEBUG, "tgMesh::cleanArrangment move " << movedVertices.size() << " vertices, " << removeEdges.size() << " of " << meshArr.number_of_edges() << " edges" );
+
+    // removing an edge only invalidates it, and the end vertices it leaves
+    // isolated - which can't be an end of another edge still to remove
+    for ( unsigned int i=0; i<removeEdges.size(); i++ ) {
+        meshArr.remove_edge( removeEdges[i] );
+    }
+    for ( unsigned int i=0; i<removeVertices.size(); i++ ) {
+        meshArr.remove_isolated_vertex( removeVertices[i] );
+    }
+
+    insertSegments( segs );
+}
+
+// insert segments into a populated arrangement.  A few segments are
+// inserted one at a time, located with the landmarks - each one only
+// visits the faces along it.  When many edges changed, one sweep over the
+// whole arrangement is faster.
+void tgMeshArrangement::insertSegments( const std::vector<meshArrSegment>& segs )
+{
+    if ( segs.size() * 4 > meshArr.number_of_edges() ) {
+        CGAL::insert( meshArr, segs.begin(), segs.end() );
+    } else {
+        for ( unsigned int i=0; i<segs.size(); i++ ) {
+            CGAL::insert( meshArr, segs[i], meshPointLocation );
+        }
+    }
+}
+
 bool tgMeshArrangement::isEdgeVertex( meshArrVertexConstHandle v )
 {
     bool isEdge = false;
@@ -60,7 +166,7 @@ bool tgMeshArrangement::isEdgeVertex( meshArrVertexConstHandle v )
 
 // Use Lloyd Voronoi relaxation to cluster and 
 // remove nodes too close to one another.
-void tgMeshArrangement::cleanArrangement( SGMutex* lock )
+void tgMeshArrangement::cleanArrangement( void )
 {
     SG_LOG( SG_GENERAL, SG_DEBUG, "tgMeshArrangement::cleanArrangment : start" );
 
@@ -77,10 +183,9 @@ void tgMeshArrangement::cleanArrangement( SGMutex* lock )
         nodes.push_back( tgClusterNode( toCpPoint(vit->point()), isEdgeVertex(vit) ) );
     }
 
-    // create the cluster : not thread safe
-    lock->lock();
+    // create the cluster - all of its state is per tile, so worker threads
+    // can cluster their own tiles concurrently
     tgCluster cluster( nodes, 0.0000025, mesh->debugPath );
-    lock->unlock();
 
 #if DEBUG_MESH_CLEANING
     cluster.toShapefile( mesh->getDebugPath().c_str(), "cluster" );
@@ -102,7 +207,7 @@ void tgMeshArrangement::cleanArrangement( SGMutex* lock )
 
     // clean 3 - remove skinny faces
     // doRemoveSmallAreas();
-    // doRemoveSpikes( lock );
+    // doRemoveSpikes();
 
     // clean 3
     // clustering may have moved an edge too close to a vertex - 
@@ -111,7 +216,7 @@ void tgMeshArrangement::cleanArrangement( SGMutex* lock )
     // getting them back is tricky.
     // maybe mark edges as 'special?
     // let's try without, first.
-    doSnapRound( lock );
+    doSnapRound();
 
     // clean 4
     doRemoveAntenna();
@@ -120,9 +225,10 @@ void tgMeshArrangement::cleanArrangement( SGMutex* lock )
     toShapefile( mesh->getDebugPath(), "arr_snapround" );
 #endif
 
-    // now attach the point locater to quickly find faces from points
-    // need this for projecting
-    meshPointLocation.attach( meshArr );
+    // the point locater attached in arrangePolys finds faces from points
+    // for projecting.  It stays attached through both kinds of cleaning :
+    // it observes the arrangement, and rebuilds its landmarks after a clear
+    // or a sweep, and after every few local edits.
 
     // clean 5
     doProjectPointsToEdges( cluster );
@@ -159,7 +265,7 @@ void tgMeshArrangement::cleanArrangement( SGMutex* lock )
                     if (CGAL::assign(f, obj)) {
                         // point is in face - set the material, and the query point, so we can save it
                         if ( !f->is_unbounded() ) {
-                            metaLookup.push_back( tgMeshFaceMeta(f, queryPoints[i], pit->getMeta() ) );
+                            addFaceMeta( f, queryPoints[i], pit->getMeta() );
                         } else {
                             SG_LOG( SG_GENERAL, SG_INFO, "tgMesh::tgMesh - POINT " << i << " queryPoint found on unbounded FACE!" );
 #if DEBUG_MESH_CLEANING
@@ -224,3 +224,44 @@ void tgMeshArrangement::fromShapefile( const std::string& filename, std::vector<
     
     GDALClose( poDS );    
 }
+
+
+// the container keeps the arrangement edges themselves, so loading doesn't
+// need to split face boundaries back into segments.  Face meta isn't
+// needed to load the arrangement, so the face query points aren't saved.
+void tgMeshArrangement::toBinary( tgMeshBinaryWriter& writer ) const
+{
+    std::vector<tgMeshBinarySegment> segRecords;
+
+    segRecords.reserve( meshArr.number_of_edges() );
+    for ( meshArrEdgeConstIterator eit = meshArr.edges_begin(); eit != meshArr.edges_end(); ++eit ) {
+        tgMeshBinarySegment r;
+
+        r.sx = CGAL::to_double( eit->curve().source().x() );
+        r.sy = CGAL::to_double( eit->curve().source().y() );
+        r.tx = CGAL::to_double( eit->curve().target().x() );
+        r.ty = CGAL::to_double( eit->curve().target().y() );
+
+        segRecords.push_back( r );
+    }
+
+    writer.addSection( TGMB_SECTION_ARR_SEGMENTS, segRecords );
+}
+
+void tgMeshArrangement::fromBinary( const std::string& filename, std::vector<meshArrSegment>& segments ) const
+{
+    tgMeshBinaryReader reader;
+
+    if ( !reader.open( filename ) ) {
+        SG_LOG( SG_GENERAL, SG_DEBUG, "Failed opening container " << filename.c_str() );
+        return;
+    }
+
+    uint64_t                   numSegs;
+    const tgMeshBinarySegment* sr = reader.getSection<tgMeshBinarySegment>( TGMB_SECTION_ARR_SEGMENTS, numSegs );
+
+    segments.reserve( segments.size() + numSegs );
+    for ( uint64_t i=0; sr && i<numSegs; i++ ) {
+        segments.push_back( meshArrSegment( meshArrPoint( sr[i].sx, sr[i].sy ), meshArrPoint( sr[i].tx, sr[i].ty ) ) );
+    }
+}
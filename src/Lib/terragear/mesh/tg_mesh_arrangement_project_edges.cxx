@@ -5,9 +5,6 @@
 tgMeshArrangement::SrcPointOp_e tgMeshArrangement::checkPointNearEdge( const meshArrPoint& pt, meshArrFaceConstHandle fh, meshArrPoint& projPt )
 {
     const meshArr_FT    distThreshSq(0.0000000005);
-    static unsigned int ptKeep = 0;
-    static unsigned int ptDelete = 0;
-    static unsigned int ptProject = 0;
     SrcPointOp_e        retVal;
 
     if ( fh->has_outer_ccb() ) {
@@ -64,15 +61,12 @@ tgMeshArrangement::SrcPointOp_e tgMeshArrangement::checkPointNearEdge( const mes
                     GDALClose( poDS );    
                 }
 
-                ptProject++;
                 projPt = ptProj;
                 retVal = SRC_POINT_PROJECTED;
             } else {
-                ptDelete++;
                 retVal = SRC_POINT_DELETED;
             }
         } else {
-            ptKeep++;
             retVal = SRC_POINT_OK;
         }
     } else {
@@ -80,8 +74,6 @@ tgMeshArrangement::SrcPointOp_e tgMeshArrangement::checkPointNearEdge( const mes
         retVal = SRC_POINT_OK;
     }
 
-//  SG_LOG( SG_GENERAL, SG_INFO, "tgMesh::tgMesh ptKeep " << ptKeep << " ptDelete " << ptDelete << " ptProject " << ptProject );
-
     return retVal;
 }
 
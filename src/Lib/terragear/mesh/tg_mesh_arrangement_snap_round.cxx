@@ -15,8 +15,10 @@
 //     'the wrong way' making tile edge in the incorrect position.
 //     I found this when tile matching broke for just a few tiles 
 //     ( I beleive this is due to fp roundoff errors )
-// 3 - CGAL snaprounding is apparently not threadsafe - I had to protect the whole 
-//     procedure with a mutex.
+// 3 - CGAL snaprounding used to need a global mutex.  The shared state was
+//     the lazy kernel's statics, which are per thread with CGAL_HAS_THREADS
+//     ( see tg_mesh_def.hxx ).  Everything else snap rounding touches is
+//     local to the call, so tiles snap round concurrently.
 
 // instead of snaprounding, we remove small areas, then small angles ( spikes )
 // not as simple to code, but hopefully doesn't cause as many issues.
@@ -27,7 +29,31 @@ typedef std::vector<meshArrPoint>                   srPointList;
 typedef std::list<meshArrPoint>                     srPolyline;
 typedef std::list<srPolyline>                       srPolylineList;
 
-void tgMeshArrangement::doSnapRound( SGMutex* lock )
+// snap rounding notes:
+// 1) traits and containers are private to this call - no lock needed
+// 2) no way to define the origin of snapping.  so if a point is at 0,0, and pixel size is 1, new point will be at 0.5, 0.5.
+//    We don't want this, so we translate the entire dataset back by 1/2 pixel size so 0,0 is still 0,0
+
+#define SR_PIXEL   (0.0000002)
+#define SR_OFFSET  (0.0000001)
+//#define SR_OFFSET  (0)
+
+// where snap rounding puts a point
+static meshArrPoint srSnap( const meshArrPoint& p )
+{
+    srTraits   srT;
+    meshArr_FT x, y;
+
+    srT.snap_2_object()(p, SR_PIXEL, x, y);
+
+    return meshArrPoint( x - SR_OFFSET, y - SR_OFFSET );
+}
+
+// snap rounding is always a rebuild, even when cleaning in place.  Every
+// vertex of a freshly arranged tile is off the grid, and an edge has to be
+// snapped with the hot pixels of every vertex it passes through - so the
+// whole tile is the dirty region.
+void tgMeshArrangement::doSnapRound( void )
 {
     srSegmentList  srInputSegs;
     srPolylineList srOutputSegs;
@@ -45,18 +71,8 @@ void tgMeshArrangement::doSnapRound( SGMutex* lock )
         }
     }
 
-    // snap rounding notes:
-    // 1) doesn't appear to be threadsafe
-    // 2) no way to define the origin of snapping.  so if a point is at 0,0, and pixel size is 1, new point will be at 0.5, 0.5.
-    //    We don't want this, so we translate the entire dataset back by 1/2 pixel size so 0,0 is still 0,0
-
-#define SR_OFFSET  (0.0000001)
-//#define SR_OFFSET  (0)
-
-    lock->lock();
     CGAL::snap_rounding_2<srTraits, srSegmentList::const_iterator, srPolylineList>
-    (srInputSegs.begin(), srInputSegs.end(), srOutputSegs, 0.0000002, true, false, 5);
-    lock->unlock();
+    (srInputSegs.begin(), srInputSegs.end(), srOutputSegs, SR_PIXEL, true, false, 5);
 
     std::vector<meshArrSegment> segs;
 
@@ -77,11 +93,7 @@ void tgMeshArrangement::doSnapRound( SGMutex* lock )
     CGAL::insert( meshArr, segs.begin(), segs.end() );
 
     // snap round the isolated vertices, too
-    srTraits srT;
     for ( unsigned int i=0; i<srInputPoints.size(); i++ ) {
-        meshArr_FT x, y;
-        srT.snap_2_object()(srInputPoints[i], 0.0000002, x, y);
-
-        CGAL::insert_point( meshArr, meshArrPoint( x - SR_OFFSET, y - SR_OFFSET ) );
+        CGAL::insert_point( meshArr, srSnap( srInputPoints[i] ) );
     }
-}
\ No newline at end of file
+}
@@ -147,7 +147,7 @@ void tgMeshArrangement::insertAngleIntoSeries( tgSharpAngleSeriesList& saSeriesL
     }
 }
 
-void tgMeshArrangement::doRemoveSpikes( SGMutex* lock )
+void tgMeshArrangement::doRemoveSpikes( void )
 {
     std::vector<tgSharpAngle>           angles;
     std::vector<meshArrHalfedgeHandle>  dups;
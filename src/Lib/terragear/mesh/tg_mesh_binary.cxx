@@ -0,0 +1,224 @@
+#include <string.h>
+#include <stdio.h>
+
+#ifndef _MSC_VER
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#endif
+
+#include <simgear/debug/logstream.hxx>
+
+#include "tg_mesh_binary.hxx"
+
+// sections start on 8 byte boundaries so doubles can be read in place
+static uint64_t alignSection( uint64_t offset )
+{
+    return ( offset + 7 ) & ~((uint64_t)7);
+}
+
+void tgMeshBinaryWriter::addSection( tgMeshBinarySectionType type, uint32_t recordSize, const void* records, uint64_t count )
+{
+    Section s;
+
+    s.entry.type       = type;
+    s.entry.recordSize = recordSize;
+    s.entry.offset     = 0;
+    s.entry.count      = count;
+
+    if ( count ) {
+        const char* src = static_cast<const char*>( records );
+        s.data.assign( src, src + recordSize * count );
+    }
+
+    sections.push_back( s );
+}
+
+bool tgMeshBinaryWriter::write( const std::string& filename ) const
+{
+    tgMeshBinaryHeader                      header;
+    std::vector<tgMeshBinarySectionEntry>   directory;
+    uint64_t                                offset;
+
+    memcpy( header.magic, TG_MESH_BINARY_MAGIC, 4 );
+    header.version     = TG_MESH_BINARY_VERSION;
+    header.byteOrder   = TG_MESH_BINARY_BOM;
+    header.numSections = sections.size();
+    header.reserved    = 0;
+
+    // layout the sections after the header and directory
+    offset = alignSection( sizeof(header) + sections.size() * sizeof(tgMeshBinarySectionEntry) );
+    for ( unsigned int i=0; i<sections.size(); i++ ) {
+        tgMeshBinarySectionEntry entry = sections[i].entry;
+        entry.offset = offset;
+        directory.push_back( entry );
+
+        offset = alignSection( offset + sections[i].data.size() );
+    }
+
+    FILE* fp = fopen( filename.c_str(), "wb" );
+    if ( !fp ) {
+        SG_LOG( SG_GENERAL, SG_ALERT, "tgMeshBinaryWriter::write - can't create " << filename );
+        return false;
+    }
+
+    bool ok = ( fwrite( &header, sizeof(header), 1, fp ) == 1 );
+    if ( ok && !directory.empty() ) {
+        ok = ( fwrite( &directory[0], sizeof(tgMeshBinarySectionEntry), directory.size(), fp ) == directory.size() );
+    }
+
+    for ( unsigned int i=0; ok && i<sections.size(); i++ ) {
+        static const char padding[8] = { 0 };
+        long cur = ftell( fp );
+
+        if ( (uint64_t)cur < directory[i].offset ) {
+            ok = ( fwrite( padding, directory[i].offset - cur, 1, fp ) == 1 );
+        }
+        if ( ok && !sections[i].data.empty() ) {
+            ok = ( fwrite( &sections[i].data[0], sections[i].data.size(), 1, fp ) == 1 );
+        }
+    }
+
+    if ( fclose( fp ) != 0 ) {
+        ok = false;
+    }
+
+    if ( !ok ) {
+        SG_LOG( SG_GENERAL, SG_ALERT, "tgMeshBinaryWriter::write - error writing " << filename );
+    }
+
+    return ok;
+}
+
+bool tgMeshBinaryReader::open( const std::string& filename )
+{
+    close();
+
+#ifndef _MSC_VER
+    int fd = ::open( filename.c_str(), O_RDONLY );
+    if ( fd < 0 ) {
+        SG_LOG( SG_GENERAL, SG_DEBUG, "tgMeshBinaryReader::open - can't open " << filename );
+        return false;
+    }
+
+    struct stat st;
+    if ( fstat( fd, &st ) == 0 && st.st_size > 0 ) {
+        void* p = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if ( p != MAP_FAILED ) {
+            base   = static_cast<const char*>( p );
+            length = st.st_size;
+            mapped = true;
+        }
+    }
+    ::close( fd );
+#endif
+
+    // no mmap ( or it failed ) - read the whole file instead
+    if ( !base ) {
+        FILE* fp = fopen( filename.c_str(), "rb" );
+        if ( !fp ) {
+            SG_LOG( SG_GENERAL, SG_DEBUG, "tgMeshBinaryReader::open - can't open " << filename );
+            return false;
+        }
+
+        fseek( fp, 0, SEEK_END );
+        long size = ftell( fp );
+        fseek( fp, 0, SEEK_SET );
+
+        if ( size > 0 ) {
+            buffer.resize( size );
+            if ( fread( &buffer[0], size, 1, fp ) == 1 ) {
+                base   = &buffer[0];
+                length = size;
+            }
+        }
+        fclose( fp );
+    }
+
+    if ( !base || !validate( filename ) ) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+bool tgMeshBinaryReader::validate( const std::string& filename )
+{
+    if ( length < sizeof(tgMeshBinaryHeader) ) {
+        SG_LOG( SG_GENERAL, SG_ALERT, "tgMeshBinaryReader - " << filename << " is truncated" );
+        return false;
+    }
+
+    header = reinterpret_cast<const tgMeshBinaryHeader*>( base );
+    if ( memcmp( header->magic, TG_MESH_BINARY_MAGIC, 4 ) ) {
+        SG_LOG( SG_GENERAL, SG_ALERT, "tgMeshBinaryReader - " << filename << " is not a mesh container" );
+        return false;
+    }
+    if ( header->byteOrder != TG_MESH_BINARY_BOM ) {
+        SG_LOG( SG_GENERAL, SG_ALERT, "tgMeshBinaryReader - " << filename << " was written with a different byte order" );
+        return false;
+    }
+    if ( header->version != TG_MESH_BINARY_VERSION ) {
+        SG_LOG( SG_GENERAL, SG_ALERT, "tgMeshBinaryReader - " << filename << " has version " << header->version << ", expected " << TG_MESH_BINARY_VERSION );
+        return false;
+    }
+
+    uint64_t dirEnd = sizeof(tgMeshBinaryHeader) + (uint64_t)header->numSections * sizeof(tgMeshBinarySectionEntry);
+    if ( dirEnd > length ) {
+        SG_LOG( SG_GENERAL, SG_ALERT, "tgMeshBinaryReader - " << filename << " directory is truncated" );
+        return false;
+    }
+
+    directory = reinterpret_cast<const tgMeshBinarySectionEntry*>( base + sizeof(tgMeshBinaryHeader) );
+    for ( unsigned int i=0; i<header->numSections; i++ ) {
+        // a corrupt count could overflow offset + recordSize * count
+        const tgMeshBinarySectionEntry& e = directory[i];
+        if ( e.offset > length || ( e.recordSize && e.count > ( length - e.offset ) / e.recordSize ) ) {
+            SG_LOG( SG_GENERAL, SG_ALERT, "tgMeshBinaryReader - " << filename << " section " << e.type << " is truncated" );
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void tgMeshBinaryReader::close( void )
+{
+#ifndef _MSC_VER
+    if ( mapped && base ) {
+        munmap( const_cast<char*>( base ), length );
+    }
+#endif
+
+    buffer.clear();
+    base      = NULL;
+    length    = 0;
+    header    = NULL;
+    directory = NULL;
+    mapped    = false;
+}
+
+const void* tgMeshBinaryReader::findSection( tgMeshBinarySectionType type, uint32_t recordSize, uint64_t& count ) const
+{
+    count = 0;
+
+    if ( !base ) {
+        return NULL;
+    }
+
+    for ( unsigned int i=0; i<header->numSections; i++ ) {
+        if ( directory[i].type == (uint32_t)type ) {
+            if ( directory[i].recordSize != recordSize ) {
+                SG_LOG( SG_GENERAL, SG_ALERT, "tgMeshBinaryReader - section " << type << " has record size " << directory[i].recordSize << ", expected " << recordSize );
+                return NULL;
+            }
+
+            count = directory[i].count;
+            return base + directory[i].offset;
+        }
+    }
+
+    return NULL;
+}
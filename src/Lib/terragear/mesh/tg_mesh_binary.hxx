@@ -0,0 +1,161 @@
+// tg_mesh_binary.hxx -- binary container for tg-construct intermediate data
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+#ifndef __TG_MESH_BINARY_HXX__
+#define __TG_MESH_BINARY_HXX__
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// The stage 1 / stage 2 intermediate files used to be written as a set of
+// ESRI shapefiles ( arrangement faces, tds points, tds faces and the four
+// shared edge node layers ).  Reading those back through OGR, and parsing
+// the vertex indices out of strings, is a noticable part of stage 2.
+//
+// The binary container is a single file per tile :
+//
+//   header      : magic, version, byte order mark, number of sections
+//   directory   : one entry per section - type, record size, offset, count
+//   sections    : arrays of fixed width records, 8 byte aligned
+//
+// All records are plain old data, so a section can be used directly from
+// the mapped file without parsing.  Files are written in native byte order;
+// a reader on a host with different endianess refuses the file.
+
+#define TG_MESH_BINARY_MAGIC        "TGMB"
+#define TG_MESH_BINARY_VERSION      (1)
+#define TG_MESH_BINARY_BOM          (0x0102)
+
+#define TG_MESH_STAGE1_BINARY       "stage1.tgmb"
+#define TG_MESH_STAGE2_BINARY       "stage2.tgmb"
+
+typedef enum {
+    TGMB_SECTION_ARR_SEGMENTS   = 1,    // tgMeshBinarySegment
+    TGMB_SECTION_ARR_QUERY_PTS  = 2,    // unused - reserved so the ids stay stable
+    TGMB_SECTION_TDS_VERTICES   = 3,    // tgMeshBinaryVertex
+    TGMB_SECTION_TDS_FACES      = 4,    // tgMeshBinaryFace
+    TGMB_SECTION_EDGE_NORTH     = 5,    // tgMeshBinaryVertex
+    TGMB_SECTION_EDGE_SOUTH     = 6,    // tgMeshBinaryVertex
+    TGMB_SECTION_EDGE_EAST      = 7,    // tgMeshBinaryVertex
+    TGMB_SECTION_EDGE_WEST      = 8     // tgMeshBinaryVertex
+} tgMeshBinarySectionType;
+
+struct tgMeshBinaryHeader
+{
+    char        magic[4];
+    uint16_t    version;
+    uint16_t    byteOrder;
+    uint32_t    numSections;
+    uint32_t    reserved;
+};
+
+struct tgMeshBinarySectionEntry
+{
+    uint32_t    type;
+    uint32_t    recordSize;
+    uint64_t    offset;
+    uint64_t    count;
+};
+
+struct tgMeshBinarySegment
+{
+    double      sx;
+    double      sy;
+    double      tx;
+    double      ty;
+};
+
+struct tgMeshBinaryVertex
+{
+    int32_t     id;
+    int32_t     reserved;
+    double      x;
+    double      y;
+    double      z;
+};
+
+struct tgMeshBinaryFace
+{
+    int32_t     fid;
+    int32_t     vid[3];
+    int32_t     nid[3];
+    uint8_t     con[3];
+    uint8_t     reserved;
+};
+
+static_assert( sizeof(tgMeshBinaryHeader)       == 16, "tgMeshBinaryHeader must be 16 bytes" );
+static_assert( sizeof(tgMeshBinarySectionEntry) == 24, "tgMeshBinarySectionEntry must be 24 bytes" );
+static_assert( sizeof(tgMeshBinarySegment)      == 32, "tgMeshBinarySegment must be 32 bytes" );
+static_assert( sizeof(tgMeshBinaryVertex)       == 32, "tgMeshBinaryVertex must be 32 bytes" );
+static_assert( sizeof(tgMeshBinaryFace)         == 32, "tgMeshBinaryFace must be 32 bytes" );
+
+// collect sections in memory, then write the file in one go
+class tgMeshBinaryWriter
+{
+public:
+    template <typename T>
+    void addSection( tgMeshBinarySectionType type, const std::vector<T>& records ) {
+        addSection( type, sizeof(T), records.empty() ? NULL : &records[0], records.size() );
+    }
+
+    void addSection( tgMeshBinarySectionType type, uint32_t recordSize, const void* records, uint64_t count );
+    bool write( const std::string& filename ) const;
+
+private:
+    struct Section {
+        tgMeshBinarySectionEntry entry;
+        std::vector<char>        data;
+    };
+
+    std::vector<Section> sections;
+};
+
+// map a container read only, and hand out typed pointers into it.
+// pointers are valid until the reader is closed or destroyed.
+class tgMeshBinaryReader
+{
+public:
+    tgMeshBinaryReader() : base(NULL), length(0), header(NULL), directory(NULL), mapped(false) {}
+    ~tgMeshBinaryReader() { close(); }
+
+    bool open( const std::string& filename );
+    void close( void );
+    bool isOpen( void ) const { return base != NULL; }
+
+    template <typename T>
+    const T* getSection( tgMeshBinarySectionType type, uint64_t& count ) const {
+        return static_cast<const T*>( findSection( type, sizeof(T), count ) );
+    }
+
+private:
+    // non copyable - we own the mapping
+    tgMeshBinaryReader( const tgMeshBinaryReader& );
+    tgMeshBinaryReader& operator=( const tgMeshBinaryReader& );
+
+    const void* findSection( tgMeshBinarySectionType type, uint32_t recordSize, uint64_t& count ) const;
+    bool        validate( const std::string& filename );
+
+    const char*                     base;
+    uint64_t                        length;
+    const tgMeshBinaryHeader*       header;
+    const tgMeshBinarySectionEntry* directory;
+    bool                            mapped;
+    std::vector<char>               buffer;     // used when the file can't be mapped
+};
+
+#endif /* __TG_MESH_BINARY_HXX__ */
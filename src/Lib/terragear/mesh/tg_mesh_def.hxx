@@ -47,6 +47,16 @@
 #include <CGAL/Delaunay_mesher_2.h>
 #include <CGAL/Delaunay_mesher_no_edge_refinement_2.h>
 
+// tg-construct builds and modifies tile arrangements on all worker threads
+// at once, without a global lock.  Each tile owns its arrangement, so the
+// only shared state is inside CGAL itself : the lazy exact kernel's static
+// zero handles and reference counts, and the FPU rounding mode used by the
+// filtered predicates.  CGAL only keeps these per thread when it is built
+// with thread support.
+#if defined(CGAL_HAS_NO_THREADS) || !defined(CGAL_HAS_THREADS)
+#error "terragear mesh requires CGAL with thread support ( CGAL_HAS_THREADS )"
+#endif
+
 // the arrangement uses EPECK, the triangulation is EPICK
 typedef CGAL::Exact_predicates_exact_constructions_kernel         EPECK;
 
@@ -182,6 +192,8 @@ public:
         }
     }
 
+    meshVertexInfo( int i, const meshTriPoint& p, double e ) : id(i), pt(p), elevation(e) {}
+
     meshVertexInfo( OGRFeature* poFeature ) {
         vh        = meshTriTDS::Vertex_handle();
 
@@ -144,7 +144,18 @@ public:
     void prepareTds( void );
     void saveTds( const std::string& bucketPath ) const;
 
+    // ********** Binary container I/O **********
+    void saveSharedEdgeNodes( tgMeshBinaryWriter& writer ) const;
+    void saveTds( tgMeshBinaryWriter& writer ) const;
+
+    // loading stage 1 shared edge data / triangulation from a container
+    void fromBinary( const std::string& filename, edgeType edge, std::vector<meshVertexInfo>& points ) const;
+    void fromBinary( const std::string& filename, std::vector<meshVertexInfo>& points, std::vector<meshFaceInfo>& faces ) const;
+
 private:
+    bool buildTds( const std::vector<meshVertexInfo>& points, const std::vector<meshFaceInfo>& faces );
+    void toBinary( const std::vector<const meshVertexInfo *>& points, std::vector<tgMeshBinaryVertex>& records ) const;
+
     void loadStage1SharedEdge( const std::string& p, const SGBucket& b, edgeType edge, std::vector<meshVertexInfo>& points );
     void sortByLat( std::vector<meshVertexInfo>& points ) const;
     void sortByLon( std::vector<meshVertexInfo>& points ) const;
@@ -467,17 +467,28 @@ bool tgMeshTriangulation::loadTds( const std::string& bucketPath )
     std::vector<meshVertexInfo>   points;
     std::vector<meshFaceInfo>     faces;
     std::string                   filePath;
-    bool                          hasLand = false;
 
-    meshTriTDS& tds = meshTriangulation.tds();
-    tds.clear();
+    if ( mesh->format == tgMesh::FORMAT_BINARY ) {
+        filePath = bucketPath + "/" + TG_MESH_STAGE1_BINARY;
+        fromBinary( filePath, points, faces );
+    } else {
+        // load vertices, and save their handles in V
+        filePath = bucketPath + "/tds_points.shp"; 
+        fromShapefile( filePath, points );
+
+        filePath = bucketPath + "/tds_faces.shp"; 
+        fromShapefile( filePath, faces );
+    }
 
-    // load vertices, and save their handles in V
-    filePath = bucketPath + "/tds_points.shp"; 
-    fromShapefile( filePath, points );
+    return buildTds( points, faces );
+}
 
-    filePath = bucketPath + "/tds_faces.shp"; 
-    fromShapefile( filePath, faces );
+bool tgMeshTriangulation::buildTds( const std::vector<meshVertexInfo>& points, const std::vector<meshFaceInfo>& faces )
+{
+    bool hasLand = false;
+
+    meshTriTDS& tds = meshTriangulation.tds();
+    tds.clear();
 
     if (!points.empty() && !faces.empty()) {
         SG_LOG(SG_GENERAL, SG_DEBUG, "loadTDS from " << points.size() << " points and " << faces.size() << " faces" );
@@ -559,4 +570,86 @@ bool tgMeshTriangulation::loadTds( const std::string& bucketPath )
     }
 
     return hasLand;
-}
\ No newline at end of file
+}
+
+// ********** Binary container I/O **********
+void tgMeshTriangulation::toBinary( const std::vector<const meshVertexInfo *>& points, std::vector<tgMeshBinaryVertex>& records ) const
+{
+    records.reserve( records.size() + points.size() );
+
+    for ( unsigned int i=0; i<points.size(); i++ ) {
+        tgMeshBinaryVertex r;
+
+        r.id       = points[i]->getId();
+        r.reserved = 0;
+        r.x        = points[i]->getX();
+        r.y        = points[i]->getY();
+        r.z        = points[i]->getZ();
+
+        records.push_back( r );
+    }
+}
+
+void tgMeshTriangulation::saveTds( tgMeshBinaryWriter& writer ) const
+{
+    std::vector<const meshVertexInfo *> points;
+    std::vector<tgMeshBinaryVertex>     vertexRecords;
+    std::vector<tgMeshBinaryFace>       faceRecords;
+
+    // don't save first point : it's infinite vertex
+    for (unsigned int i=1; i<vertexInfo.size(); i++) {
+        points.push_back( &vertexInfo[i] );
+    }
+    toBinary( points, vertexRecords );
+
+    faceRecords.reserve( faceInfo.size() );
+    for (unsigned int i=0; i<faceInfo.size(); i++) {
+        tgMeshBinaryFace r;
+
+        r.fid = faceInfo[i].getFid();
+        for ( unsigned int j=0; j<3; j++ ) {
+            r.vid[j] = faceInfo[i].getVid(j);
+            r.nid[j] = faceInfo[i].getNid(j);
+            r.con[j] = faceInfo[i].getConstrained(j) ? 1 : 0;
+        }
+        r.reserved = 0;
+
+        faceRecords.push_back( r );
+    }
+
+    writer.addSection( TGMB_SECTION_TDS_VERTICES, vertexRecords );
+    writer.addSection( TGMB_SECTION_TDS_FACES,    faceRecords );
+}
+
+void tgMeshTriangulation::fromBinary( const std::string& filename, std::vector<meshVertexInfo>& points, std::vector<meshFaceInfo>& faces ) const
+{
+    tgMeshBinaryReader reader;
+
+    if ( !reader.open( filename ) ) {
+        SG_LOG( SG_GENERAL, SG_DEBUG, "Failed opening container " << filename.c_str() );
+        return;
+    }
+
+    uint64_t                  numVertices, numFaces;
+    const tgMeshBinaryVertex* vr = reader.getSection<tgMeshBinaryVertex>( TGMB_SECTION_TDS_VERTICES, numVertices );
+    const tgMeshBinaryFace*   fr = reader.getSection<tgMeshBinaryFace>( TGMB_SECTION_TDS_FACES, numFaces );
+
+    points.reserve( numVertices );
+    for ( uint64_t i=0; vr && i<numVertices; i++ ) {
+        points.push_back( meshVertexInfo( vr[i].id, meshTriPoint( vr[i].x, vr[i].y ), vr[i].z ) );
+    }
+
+    faces.reserve( numFaces );
+    for ( uint64_t i=0; fr && i<numFaces; i++ ) {
+        int vIdx[3], nIdx[3], cons[3];
+
+        for ( unsigned int j=0; j<3; j++ ) {
+            vIdx[j] = fr[i].vid[j];
+            nIdx[j] = fr[i].nid[j];
+            cons[j] = fr[i].con[j];
+        }
+        faces.push_back( meshFaceInfo( fr[i].fid, vIdx, nIdx, cons ) );
+    }
+
+    SG_LOG( SG_GENERAL, SG_DEBUG, "Loaded " << points.size() << " points and " << faces.size() << " faces from " << filename.c_str() );
+}
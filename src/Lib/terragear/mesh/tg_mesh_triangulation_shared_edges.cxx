@@ -232,12 +232,21 @@ void tgMeshTriangulation::loadStage1SharedEdge( const std::string& p, const SGBu
         "west"
     };
 
-    char filename[64];
-    sprintf( filename, "stage1_%s.shp", edgestr[edge] );
-    std::string filePath = p + bucket.gen_base_path() + "/" + bucket.gen_index_str() + "/" + filename;
+    std::string filePath;
 
-    SG_LOG(SG_GENERAL, SG_DEBUG, "Loading Bucket " << bucket.gen_index_str() << " edge " << edgestr[edge] << " from " << filePath );           
-    fromShapefile( filePath, points );
+    if ( mesh->format == tgMesh::FORMAT_BINARY ) {
+        filePath = p + bucket.gen_base_path() + "/" + bucket.gen_index_str() + "/" + TG_MESH_STAGE1_BINARY;
+
+        SG_LOG(SG_GENERAL, SG_DEBUG, "Loading Bucket " << bucket.gen_index_str() << " edge " << edgestr[edge] << " from " << filePath );           
+        fromBinary( filePath, edge, points );
+    } else {
+        char filename[64];
+        sprintf( filename, "stage1_%s.shp", edgestr[edge] );
+        filePath = p + bucket.gen_base_path() + "/" + bucket.gen_index_str() + "/" + filename;
+
+        SG_LOG(SG_GENERAL, SG_DEBUG, "Loading Bucket " << bucket.gen_index_str() << " edge " << edgestr[edge] << " from " << filePath );           
+        fromShapefile( filePath, points );
+    }
 
     SG_LOG(SG_GENERAL, SG_DEBUG, "Loaded " << points.size() << " nodes on edge " << edgestr[edge] );        
 }
@@ -510,6 +519,57 @@ void tgMeshTriangulation::saveSharedEdgeNodes( const std::string& path ) const
     toShapefile( path, "stage1_west",  west );
 }
 
+void tgMeshTriangulation::saveSharedEdgeNodes( tgMeshBinaryWriter& writer ) const
+{
+    std::vector<const meshVertexInfo *> north;
+    std::vector<const meshVertexInfo *> south;
+    std::vector<const meshVertexInfo *> east;
+    std::vector<const meshVertexInfo *> west;
+    std::vector<tgMeshBinaryVertex>     records;
+
+    getEdgeNodes( north, south, east, west );
+
+    // one section per edge - neighbors only read the section they share
+    toBinary( north, records );
+    writer.addSection( TGMB_SECTION_EDGE_NORTH, records );
+    records.clear();
+
+    toBinary( south, records );
+    writer.addSection( TGMB_SECTION_EDGE_SOUTH, records );
+    records.clear();
+
+    toBinary( east, records );
+    writer.addSection( TGMB_SECTION_EDGE_EAST, records );
+    records.clear();
+
+    toBinary( west, records );
+    writer.addSection( TGMB_SECTION_EDGE_WEST, records );
+}
+
+void tgMeshTriangulation::fromBinary( const std::string& filename, edgeType edge, std::vector<meshVertexInfo>& points ) const
+{
+    static const tgMeshBinarySectionType sections[4] = {
+        TGMB_SECTION_EDGE_NORTH,
+        TGMB_SECTION_EDGE_SOUTH,
+        TGMB_SECTION_EDGE_EAST,
+        TGMB_SECTION_EDGE_WEST
+    };
+
+    tgMeshBinaryReader reader;
+    if ( !reader.open( filename ) ) {
+        SG_LOG( SG_GENERAL, SG_DEBUG, "Failed opening container " << filename.c_str() );
+        return;
+    }
+
+    uint64_t                  numVertices;
+    const tgMeshBinaryVertex* vr = reader.getSection<tgMeshBinaryVertex>( sections[edge], numVertices );
+
+    // append - north and south edges may be loaded from multiple buckets
+    for ( uint64_t i=0; vr && i<numVertices; i++ ) {
+        points.push_back( meshVertexInfo( vr[i].id, meshTriPoint( vr[i].x, vr[i].y ), vr[i].z ) );
+    }
+}
+
 void tgMeshTriangulation::saveIncidentFaces( const std::string& path, const char* layer, const std::vector<const meshVertexInfo *>& edgeVertexes ) const
 {
 #if 0
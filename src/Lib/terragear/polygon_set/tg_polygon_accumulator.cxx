@@ -2,6 +2,9 @@
 #include <fstream>
 #include <sstream>
 
+#include <algorithm>
+#include <cmath>
+
 #include <CGAL/Bbox_2.h>
 
 #include <simgear/debug/logstream.hxx>
@@ -481,101 +484,112 @@ void tgAccumulator::Add_cgal( const tgPolygon& subject )
 // need a few functions:
 // 1) generate a Polygon_set from the Polygons_with_holes in the list that intersect subject bounding box
 // 2) Add to the Polygons_with_holes list with a Polygon set ( and the bounding boxes )
+void tgAccumulator::GetCellRange( const CGAL::Bbox_2& bb, int& xmin, int& ymin, int& xmax, int& ymax ) const
+{
+    // empty bounding box - no cells
+    if ( bb.xmin() > bb.xmax() || bb.ymin() > bb.ymax() ) {
+        xmin = ymin = 0;
+        xmax = ymax = -1;
+        return;
+    }
+
+    xmin = (int)floor( bb.xmin() / gridCellSize );
+    ymin = (int)floor( bb.ymin() / gridCellSize );
+    xmax = (int)floor( bb.xmax() / gridCellSize );
+    ymax = (int)floor( bb.ymax() / gridCellSize );
+}
+
 void tgAccumulator::GetAccumPolygonSet( const CGAL::Bbox_2& bbox, cgalPoly_PolygonSet& accumPs ) 
 {
-    std::list<tgAccumEntry>::const_iterator it;
+    std::vector<unsigned int> candidates;
     std::list<cgalPoly_PolygonWithHoles> accum;
-//  static int num_iter = 1;
-    
-    // traverse all of the Polygon_with_holes and accumulate their union
-    for ( it=accum_cgal_list.begin(); it!=accum_cgal_list.end(); it++ ) {
-        if ( CGAL::do_overlap( bbox, (*it).bbox ) ) {
-#if 0
-            if ( (*it).pwh.is_unbounded() ) {
-                SG_LOG(SG_GENERAL, SG_ALERT, "tgAccumulator::GetAccumPolygonSet - pwh is unbounded" );
-            } else {
-                SG_LOG(SG_GENERAL, SG_ALERT, "tgAccumulator::GetAccumPolygonSet - pwh is bounded" );
-            }
-#endif            
-            accum.push_back( (*it).pwh );
-        }
+    int xmin, ymin, xmax, ymax;
+
+    // new query - wrap around is harmless as long as we reset the stamps
+    if ( ++queryStamp == 0 ) {
+        std::fill( entryStamp.begin(), entryStamp.end(), 0 );
+        queryStamp = 1;
     }
-    
-#if 0
-    if ( num_iter == 44 ) {
-        GDALDataset* pDS    = tgPolygonSet::openDatasource( "./joinDbg" );
-        char layer[128];
-        int  poly = 1;
-        
-        std::list<cgalPoly_PolygonWithHoles>::const_iterator pwhit = accum.begin();
-        while ( pwhit != accum.end() ) {
-            sprintf( layer, "poly_%04d", poly++ );
-            OGRLayer* pLayer = tgPolygonSet::openLayer( pDS, wkbLineString25D, tgPolygonSet::LF_DEBUG, layer );
-            tgPolygonSet::toDebugShapefile( pLayer, (*pwhit), "poly" );
-     
-            pwhit++;
+
+    GetCellRange( bbox, xmin, ymin, xmax, ymax );
+
+    // gather the entries in the cells the bounding box covers.  An entry
+    // spanning several cells is only taken once.
+    for ( int x = xmin; x <= xmax; x++ ) {
+        for ( int y = ymin; y <= ymax; y++ ) {
+            GridMap::const_iterator cit = grid.find( GridCell(x, y) );
+            if ( cit == grid.end() ) {
+                continue;
+            }
+
+            const std::vector<unsigned int>& cell = cit->second;
+            for ( unsigned int i=0; i<cell.size(); i++ ) {
+                if ( entryStamp[cell[i]] != queryStamp ) {
+                    entryStamp[cell[i]] = queryStamp;
+                    candidates.push_back( cell[i] );
+                }
+            }
         }
-        GDALClose( pDS );        
     }
-#endif
+    candidates.insert( candidates.end(), largeEntries.begin(), largeEntries.end() );
 
-#if 0  
-    if ( num_iter == 44 ) {
-        std::ofstream output_file("./output_polys.txt");
-        if (!output_file.is_open()) {
-            std::cerr << "Failed to open the " << "./output_polys.txt" << std::endl;
-            exit(0);
-        }
-        
-        std::list<cgalPoly_PolygonWithHoles>::const_iterator pwhit = accum.begin();
-
-//      CGAL::set_pretty_mode(output_file);
-        output_file << std::setprecision(64);
-        output_file << accum.size() << "\n";
-        while ( pwhit != accum.end() ) {
-            output_file << (*pwhit);
-            pwhit++;
+    // join in insertion order, as the old list traversal did
+    std::sort( candidates.begin(), candidates.end() );
+
+    for ( unsigned int i=0; i<candidates.size(); i++ ) {
+        const tgAccumEntry& entry = accum_cgal_list[candidates[i]];
+
+        if ( CGAL::do_overlap( bbox, entry.bbox ) ) {
+            accum.push_back( entry.pwh );
         }
-        output_file.close();
     }
-#endif
 
-//  SG_LOG(SG_GENERAL, SG_ALERT, "tgAccumulator::GetAccumPolygonSet " << num_iter << " join " << accum.size() << " Polygon_with_holes ");
     accumPs.join( accum.begin(), accum.end() );
+}
 
-#if 0    
-    std::list<cgalPoly_PolygonWithHoles>::const_iterator pwhit = accum.begin();
-    int joinNum = 1;
-    while ( pwhit != accum.end() ) {
-        SG_LOG(SG_GENERAL, SG_ALERT, "tgAccumulator::GetAccumPolygonSet " << num_iter << " join " << joinNum++ );
-        ps.join( (*pwhit) );
-        pwhit++;
-    }
-#endif
+void tgAccumulator::AddAccumEntry( const cgalPoly_PolygonWithHoles& pwh )
+{
+    unsigned int idx = accum_cgal_list.size();
+    int xmin, ymin, xmax, ymax;
+
+    tgAccumEntry entry;
+    entry.pwh  = pwh;
+    entry.bbox = entry.pwh.outer_boundary().bbox();
+
+    accum_cgal_list.push_back( entry );
+    entryStamp.push_back( 0 );
+
+    GetCellRange( entry.bbox, xmin, ymin, xmax, ymax );
 
-//  SG_LOG(SG_GENERAL, SG_ALERT, "tgAccumulator::GetAccumPolygonSet " << num_iter++ << " complete" );
+    if ( (double)(xmax - xmin + 1) * (double)(ymax - ymin + 1) > TG_ACCUM_MAX_ENTRY_CELLS ) {
+        largeEntries.push_back( idx );
+    } else {
+        for ( int x = xmin; x <= xmax; x++ ) {
+            for ( int y = ymin; y <= ymax; y++ ) {
+                grid[GridCell(x, y)].push_back( idx );
+            }
+        }
+    }
 }
 
 void tgAccumulator::AddAccumPolygonSet( const cgalPoly_PolygonSet& ps )
 {
     std::list<cgalPoly_PolygonWithHoles> pwh_list;
     std::list<cgalPoly_PolygonWithHoles>::const_iterator it;
-    CGAL::Bbox_2 bbox;
 
     // make sure polygonSet is valid
-    cgalPoly_PolygonSet tmp(ps);
-    if ( !tmp.is_valid() ) {
-        SG_LOG(SG_GENERAL, SG_ALERT, "tgAccumulator::AddAccumPolygonSet - polygonSet is invalid" );
+    if ( validate ) {
+        cgalPoly_PolygonSet tmp(ps);
+        if ( !tmp.is_valid() ) {
+            SG_LOG(SG_GENERAL, SG_ALERT, "tgAccumulator::AddAccumPolygonSet - polygonSet is invalid" );
+        }
     }
 
     ps.polygons_with_holes( std::back_inserter(pwh_list) );
     for (it = pwh_list.begin(); it != pwh_list.end(); ++it) {
-        tgAccumEntry entry;
-        entry.pwh  = (*it);
-        entry.bbox =  entry.pwh.outer_boundary().bbox();
-
-        accum_cgal_list.push_back( entry );
-    }    
+        AddAccumEntry( *it );
+    }
+    accumEmpty = accum_cgal_list.empty();
 }
 
 void tgAccumulator::add( const tgPolygonSet& ps )
@@ -593,12 +607,14 @@ void tgAccumulator::Diff_and_Add_cgal( tgPolygonSet& subject )
     cgalPoly_PolygonSet subPs  = subject.getPs();
     
     // verify subject is valid
-    if ( !subPs.is_valid() ) {
+    if ( validate && !subPs.is_valid() ) {
         SG_LOG(SG_GENERAL, SG_ALERT, "tgAccumulator::Diff_and_Add_cgal - subject is INVALID" );
     }
     
     cgalPoly_PolygonSet difPs;
-    GetAccumPolygonSet( subject.getBoundingBox(), difPs );
+    if ( !accumEmpty ) {
+        GetAccumPolygonSet( subject.getBoundingBox(), difPs );
+    }
     
 #if DEBUG_DIFF_AND_ADD    
     sprintf( layer, "clip_%03ld_pre_subject", subject.getId() );
@@ -634,9 +650,13 @@ void tgAccumulator::Diff_and_Add_cgal( tgPolygonSet& subject )
 
 void tgAccumulator::toShapefile( const char* ds, const char* layer )
 {
-    CGAL::Bbox_2 bbox;
+    std::list<cgalPoly_PolygonWithHoles> accum;
     cgalPoly_PolygonSet all;
-    GetAccumPolygonSet( bbox, all );
+
+    for ( unsigned int i=0; i<accum_cgal_list.size(); i++ ) {
+        accum.push_back( accum_cgal_list[i].pwh );
+    }
+    all.join( accum.begin(), accum.end() );
     
     //all.toShapefile( ds, layer );    
 }
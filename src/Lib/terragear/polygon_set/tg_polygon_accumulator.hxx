@@ -1,6 +1,9 @@
 #ifndef _TGACCUMULATOR_HXX
 #define _TGACCUMULATOR_HXX
 
+#include <map>
+#include <vector>
+
 #include "tg_polygon_set.hxx"
 
 struct tgAccumEntry
@@ -10,10 +13,26 @@ public:
     CGAL::Bbox_2                bbox;
 };
 
+// default grid cell size in degrees - about 1km.  A tile has a few hundred
+// cells, and most landclass polygons cover only a handful of them.
+#define TG_ACCUM_DEFAULT_CELL_SIZE      (0.01)
+
+// entries covering more cells than this are kept out of the grid, and
+// checked on every query
+#define TG_ACCUM_MAX_ENTRY_CELLS        (256)
+
+// The accumulated polygons_with_holes are indexed by a uniform grid over
+// their bounding boxes, so a diff only looks at the entries near the
+// subject instead of walking the whole list.
 class tgAccumulator
 {
 public:
-    tgAccumulator() { accumEmpty = true; }
+    tgAccumulator( double cellSize = TG_ACCUM_DEFAULT_CELL_SIZE ) :
+        accumEmpty(true), validate(true), gridCellSize(cellSize), queryStamp(0) {}
+
+    // validity checks of the subject and the accumulated polygon sets are
+    // expensive.  turn them off for trusted input.
+    void      setValidation( bool v ) { validate = v; }
 
     void      add(const tgPolygonSet& subject);
     void      Diff_and_Add_cgal( tgPolygonSet& subject );
@@ -22,13 +41,28 @@ public:
     
     
 private:
+    typedef std::pair<int, int>                             GridCell;
+    typedef std::map<GridCell, std::vector<unsigned int> >  GridMap;
+
     void                    GetAccumPolygonSet( const CGAL::Bbox_2& bb, cgalPoly_PolygonSet& accumPs );
     void                    AddAccumPolygonSet( const cgalPoly_PolygonSet& ps );
+    void                    AddAccumEntry( const cgalPoly_PolygonWithHoles& pwh );
+    void                    GetCellRange( const CGAL::Bbox_2& bb, int& xmin, int& ymin, int& xmax, int& ymax ) const;
 
     bool                        accumEmpty;
+    bool                        validate;
     cgalPoly_PolygonSet         accum_cgal;
 
-    std::list<tgAccumEntry>     accum_cgal_list;
+    std::vector<tgAccumEntry>   accum_cgal_list;
+
+    // spatial index into accum_cgal_list
+    double                      gridCellSize;
+    GridMap                     grid;
+    std::vector<unsigned int>   largeEntries;
+
+    // entries already visited by the current query
+    std::vector<unsigned int>   entryStamp;
+    unsigned int                queryStamp;
 };
 
 #endif // _TGACCUMULATOR_HXX
\ No newline at end of file
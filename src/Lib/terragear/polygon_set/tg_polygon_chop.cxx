@@ -2,6 +2,7 @@
 #include <boost/interprocess/sync/named_mutex.hpp>
 
 #include <simgear/debug/logstream.hxx>
+#include <simgear/threads/SGGuard.hxx>
 #include <simgear/structure/exception.hxx>
 #include <simgear/misc/sg_path.hxx>
 #include <simgear/io/lowlevel.hxx>
@@ -61,10 +62,51 @@ void tgChopper::Add( const tgPolygonSet& subject )
     PreChop( subject, chunks);
 
     for ( unsigned int i=0; i < chunks.size(); i++ ) {
-        chunks[i].clip(bucket_id, root_path, &lock);
+        chunks[i].clip( *this );
     }
 }
 
+void tgChopper::Write( const SGBucket& b, const tgPolygonSet& result )
+{
+    long int          cur_bucket = b.gen_index();
+    const std::string material   = result.getMeta().material;
+    std::string       path       = root_path + "/" + b.gen_base_path();
+    std::string       polyfile   = path + "/" + b.gen_index_str();
+    SGTimeStamp       write_begin, write_end;
+
+    write_begin.stamp();
+
+    // lock mutex to simgear directory creation
+    {
+        SGGuard<SGMutex> g(lock);
+        SGPath sgp( polyfile );
+        sgp.create_dir( 0755 );
+    }
+
+    // now get a per dataset lock
+    dataset.Request( cur_bucket );
+
+    // save chopped polygon to a Shapefile in layer named from material
+    result.toShapefile( polyfile.c_str(), material.c_str() );
+
+    // Release per dataset lock
+    dataset.Release( cur_bucket );
+
+    write_end.stamp();
+
+    numWrites++;
+    writeTime += ( write_end - write_begin ).toUSecs();
+}
+
+void tgChopper::logStats( void ) const
+{
+    unsigned long chops  = numChops;
+    unsigned long writes = numWrites;
+
+    SG_LOG( SG_GENERAL, SG_ALERT, "tgChopper : " << chops << " clips in " << chopTime / 1000 << " ms ( avg " << ( chops ? (double)chopTime / chops / 1000.0 : 0.0 ) << " ms ), " <<
+                                  writes << " writes in " << writeTime / 1000 << " ms ( avg " << ( writes ? (double)writeTime / writes / 1000.0 : 0.0 ) << " ms )" );
+}
+
 void tgChopper::PreChop( const tgPolygonSet& subject, std::vector<tgChopperChunk>& chunks )
 {
     #define CHUNK_X     (1.0l)
@@ -163,20 +205,16 @@ void tgChopper::PreChop( const tgPolygonSet& subject, std::vector<tgChopperChunk
     }
 }
 
-void tgChopperChunk::clip( long int bucket_id, std::string& rootPath, SGMutex* lock )
+void tgChopperChunk::clip( tgChopper& chopper )
 {
     for ( unsigned int i=0; i<buckets.size(); i++ ) {
         cgalPoly_Point    base_pts[4];
         const std::string material = chunk.getMeta().material;
         SGGeod            pt;
-        char              layer[256];
         tgPolygonSet      result;
     
         SGTimeStamp       chop_begin, chop_end, chop_time;
     
-        static double     total_chop_time = 0;
-        static unsigned long num_chops = 1;
-    
         // set up clipping tile
         pt = buckets[i].get_corner( SG_BUCKET_SW );
         base_pts[0] = cgalPoly_Point( pt.getLongitudeDeg()-CLIP_CORRECTION, pt.getLatitudeDeg()-CLIP_CORRECTION );
@@ -194,7 +232,7 @@ void tgChopperChunk::clip( long int bucket_id, std::string& rootPath, SGMutex* l
     
         sprintf(debugDatasetName, "./Chopper/tile_%s_%s", b.gen_index_str().c_str(), material.c_str() );
     
-        lock->lock();
+        chopper.lock.lock();
         SGPath sgp( debugDatasetName );
         sgp.create_dir( 0755 );
         
@@ -220,7 +258,7 @@ void tgChopperChunk::clip( long int bucket_id, std::string& rootPath, SGMutex* l
     
         curClip++;
         GDALClose( poDS );
-        lock->unlock();
+        chopper.lock.unlock();
 #endif
     
         if ( !result.isEmpty() ) {
@@ -230,33 +268,12 @@ void tgChopperChunk::clip( long int bucket_id, std::string& rootPath, SGMutex* l
             //      }
         
             long int cur_bucket = buckets[i].gen_index();
-            if ( ( bucket_id < 0 ) || (cur_bucket == bucket_id ) ) {
-                std::string path = rootPath + "/" + buckets[i].gen_base_path();
-                std::string polyfile = path + "/" + buckets[i].gen_index_str();
-            
-                // lock mutex to simgear directory creation
-                lock->lock();
-                SGPath sgp( polyfile );
-                sgp.create_dir( 0755 );
-                //lock.unlock();
-            
-                // now get a per dataset lock
-                //dataset.Request( cur_bucket );
-            
-                snprintf( layer, 256, "%s_%s", material.c_str(), result.getMeta().getMetaType().c_str() );
-            
-                // save chopped polygon to a Shapefile in layer named from material
-                result.toShapefile( polyfile.c_str(), material.c_str() );
-            
-                // Release per dataset lock
-                //dataset.Release( cur_bucket );
-                lock->unlock();
+            if ( ( chopper.bucket_id < 0 ) || (cur_bucket == chopper.bucket_id ) ) {
+                chopper.Write( buckets[i], result );
             }
         }
 
-        // dump debug...
-        total_chop_time += chop_time.toMSecs();
-        SG_LOG( SG_GENERAL, SG_DEBUG, "tgChopper Clip - avg chop time: " << total_chop_time/num_chops );
-        num_chops++;        
+        chopper.numChops++;
+        chopper.chopTime += chop_time.toUSecs();
     }
 }
\ No newline at end of file
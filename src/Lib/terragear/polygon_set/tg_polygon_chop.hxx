@@ -1,3 +1,4 @@
+#include <atomic>
 #include <map>
 
 #include <simgear/threads/SGThread.hxx>
@@ -7,6 +8,8 @@
 #include <terragear/tg_dataset_protect.hxx>
 #include "tg_polygon_set.hxx"
 
+class tgChopper;
+
 class tgChopperChunk
 {
 public:
@@ -16,7 +19,7 @@ public:
     
     void setBuckets( const SGGeod& min, const SGGeod& max, bool checkBorders );
     
-    void clip( long int bucket_id, std::string& rootPath, SGMutex* lock );
+    void clip( tgChopper& chopper );
     
 private:
     std::vector<SGBucket>   buckets;
@@ -26,18 +29,35 @@ private:
 class tgChopper
 {
 public:
-    tgChopper( const std::string& path, long int bid = -1 ) {
+    tgChopper( const std::string& path, long int bid = -1 ) :
+        numChops(0), chopTime(0), numWrites(0), writeTime(0) {
         root_path = path;
         bucket_id = bid;
     }
 
     void Add( const tgPolygonSet& poly );
 
+    // clip and write statistics, summed over all threads
+    void logStats( void ) const;
+
+    friend class tgChopperChunk;
+
 private:
     void PreChop( const tgPolygonSet& subject, std::vector<tgChopperChunk>& chunks );
+    void Write( const SGBucket& b, const tgPolygonSet& result );
 
     long int         bucket_id;     // set if we only want to save a single bucket
     std::string      root_path;
+
+    // only guards directory creation.  Writes to a bucket's datasource
+    // are serialized per bucket, so threads chopping into different
+    // buckets don't wait on each other.
     SGMutex          lock;
     tgDatasetAcess   dataset;
+
+    // statistics - in microseconds
+    std::atomic<unsigned long>  numChops;
+    std::atomic<unsigned long>  chopTime;
+    std::atomic<unsigned long>  numWrites;
+    std::atomic<unsigned long>  writeTime;
 };
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef __TG_POLYGON_SET_HXX__
 #define __TG_POLYGON_SET_HXX__
 
+#include <atomic>
+
 #include <ogrsf_frmts.h>
 
 #include <terragear/clipper.hpp>
@@ -143,7 +145,7 @@ public:
     std::string         description;
     
 private:    
-    static unsigned long    cur_id;    
+    static std::atomic<unsigned long>   cur_id;
 
     void                    initFields( void );
     void                    getCommonFields( OGRFeature* poFeature );
@@ -2,7 +2,7 @@
 #include "tg_polygon_set.hxx"
 
 // every polygon set (metadata) gets its own unique identifier
-unsigned long tgPolygonSetMeta::cur_id = 1;
+std::atomic<unsigned long> tgPolygonSetMeta::cur_id( 1 );
 
 void tgPolygonSetMeta::initFields( void )
 {
@@ -453,7 +453,7 @@ unsigned long tgPolygonSetPaths::lookupFace( cgalPoly_FaceConstHandle h ) const
     return id;
 }
 
-unsigned long tgPolygonSetPath::cur_id = 1;
+std::atomic<unsigned long> tgPolygonSetPath::cur_id( 1 );
 tgPolygonSetPath::tgPolygonSetPath( cgalPoly_CcbHeConstCirculator sccb, bool isHole ) : id(tgPolygonSetPath::cur_id++)
 {
     startCcb = sccb;
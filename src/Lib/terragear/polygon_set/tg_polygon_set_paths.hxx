@@ -1,6 +1,8 @@
 #ifndef __TG_POLYGON_SET_PATHS_HXX__
 #define __TG_POLYGON_SET_PATHS_HXX__
 
+#include <atomic>
+
 /* thPaths : used to convert CGAL arrangement faces created from untructed geometry
  * into a valid collection of faces for CGAL PolygonSet_2.
  * 
@@ -73,7 +75,7 @@ public:
     void toShapefile( const char* ds );
     
 private:
-    static unsigned long            cur_id;
+    static std::atomic<unsigned long>   cur_id;
 };
 
 // Here's the helper class to traverse the arrangement faces, and generate 
@@ -23,9 +23,14 @@
 #  include <config.h>
 #endif
 
+#include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <limits>
+#include <vector>
 
 #include <simgear/compiler.h>
+#include <simgear/constants.h>
 #include <simgear/misc/sgstream.hxx>
 #include <simgear/debug/logstream.hxx>
 #include <simgear/misc/strutils.hxx>
@@ -238,7 +243,24 @@ bool tgArray::write( const string root_dir, SGBucket& b ) {
 
 
 // do our best to remove voids by picking data from the nearest neighbor.
-void tgArray::remove_voids( ) {
+void tgArray::remove_voids( VoidFillMethod method ) {
+    if ( !in_data ) {
+        return;
+    }
+
+    switch ( method ) {
+        case VOID_FILL_NEAREST:
+            remove_voids_nearest();
+            break;
+
+        case VOID_FILL_LINES:
+        default:
+            remove_voids_lines();
+            break;
+    }
+}
+
+void tgArray::remove_voids_lines( ) {
     // need two passes to ensure that all voids are removed (unless entire
     // array is a void.)
     bool have_void = true;
@@ -321,20 +343,191 @@ void tgArray::remove_voids( ) {
 }
 
 
+// Fill every void with the nearest non void sample, using the separable
+// exact euclidean distance transform of Felzenszwalb and Huttenlocher.
+// Instead of just the distance, each pass carries the index of the sample
+// that is nearest.
+//
+// pass 1 : for each column, the nearest non void row in that column
+// pass 2 : for each row, the lower envelope of the parabolas rooted at
+//          each column's pass 1 result
+//
+// Distances are in arcsec, with columns scaled by cos(lat) so the metric
+// is close to the ground distance.
+void tgArray::remove_voids_nearest( ) {
+    const double INF = std::numeric_limits<double>::max();
+    const int    n   = cols * rows;
+
+    double lat = ( originy + 0.5 * rows * row_step ) / 3600.0;
+    double wx  = col_step * cos( lat * SGD_DEGREES_TO_RADIANS );
+    double wy  = row_step;
+
+    // squared distance, and the nearest sample in this column, after pass 1
+    std::vector<double> dist( n, INF );
+    std::vector<int>    near( n, -1 );
+    bool                have_void = false;
+    bool                have_data = false;
+
+    // pass 1 - columns are contiguous in in_data
+    for ( int i = 0; i < cols; i++ ) {
+        int base = i * rows;
+        int last = -1;
+
+        // forwards
+        for ( int j = 0; j < rows; j++ ) {
+            if ( in_data[base + j] > -9000 ) {
+                last = j;
+                have_data = true;
+            } else {
+                have_void = true;
+            }
+            if ( last >= 0 ) {
+                double d = wy * (j - last);
+                dist[base + j] = d * d;
+                near[base + j] = base + last;
+            }
+        }
+
+        // backwards
+        last = -1;
+        for ( int j = rows - 1; j >= 0; j-- ) {
+            if ( in_data[base + j] > -9000 ) {
+                last = j;
+            } else if ( last >= 0 ) {
+                double d = wy * (last - j);
+                if ( d * d < dist[base + j] ) {
+                    dist[base + j] = d * d;
+                    near[base + j] = base + last;
+                }
+            }
+        }
+    }
+
+    if ( !have_void ) {
+        return;
+    }
+
+    if ( !have_data ) {
+        // entire array is void.  Fill with zero as a panic fall back.
+        for ( int k = 0; k < n; k++ ) {
+            in_data[k] = 0;
+        }
+        return;
+    }
+
+    // pass 2 - lower envelope along each row
+    std::vector<int>    v( cols );          // columns of the envelope parabolas
+    std::vector<double> z( cols + 1 );      // boundaries between them
+    std::vector<int>    nearest( cols );
+    double              wx2 = wx * wx;
+
+    for ( int j = 0; j < rows; j++ ) {
+        int k = -1;
+
+        for ( int q = 0; q < cols; q++ ) {
+            double fq = dist[q * rows + j];
+            if ( fq == INF ) {
+                continue;
+            }
+
+            double s = -INF;
+            while ( k >= 0 ) {
+                int    p  = v[k];
+                double fp = dist[p * rows + j];
+
+                s = ( (fq + wx2 * q * q) - (fp + wx2 * p * p) ) / ( 2.0 * wx2 * (q - p) );
+                if ( s > z[k] ) {
+                    break;
+                }
+                k--;
+            }
+
+            k++;
+            v[k]   = q;
+            z[k]   = ( k == 0 ) ? -INF : s;
+            z[k+1] = INF;
+        }
+
+        // can't happen - a column with any data has a finite pass 1
+        // result in every row
+        if ( k < 0 ) {
+            continue;
+        }
+
+        int e = 0;
+        for ( int q = 0; q < cols; q++ ) {
+            while ( z[e+1] < q ) {
+                e++;
+            }
+            nearest[q] = near[v[e] * rows + j];
+        }
+
+        for ( int q = 0; q < cols; q++ ) {
+            int idx = q * rows + j;
+            if ( in_data[idx] <= -9000 ) {
+                // nearest samples are always original data, never a
+                // cell filled here
+                in_data[idx] = in_data[nearest[q]];
+            }
+        }
+    }
+}
+
 // Return the elevation of the closest non-void grid point to lon, lat
+//
+// Search square rings of grid points around the point, working outwards,
+// until the ring is further away than the closest non void point found.
 double tgArray::closest_nonvoid_elev( double lon, double lat ) const {
-    double mindist = 99999999999.9;
+    double mindist = std::numeric_limits<double>::max();
     double minelev = -9999.0;
-    SGGeod p0 = SGGeod::fromDeg( lon, lat );
-
-    for ( int row = 0; row < rows; row++ ) {
-        for ( int col = 0; col < cols; col++ ) {
-            SGGeod p1 = SGGeod::fromDeg( originx + col * col_step, originy + row * row_step );
-            double dist = SGGeodesy::distanceM( p0, p1 );
-            double elev = get_array_elev(col, row);
-            if ( dist < mindist && elev > -9000 ) {
-                mindist = dist;
-                minelev = elev;
+
+    if ( !in_data ) {
+        return 0.0;
+    }
+
+    double wx = col_step * cos( lat / 3600.0 * SGD_DEGREES_TO_RADIANS );
+    double wy = row_step;
+
+    // grid coordinates of the point, clamped to the array
+    int col = (int)floor( (lon - originx) / col_step + 0.5 );
+    int row = (int)floor( (lat - originy) / row_step + 0.5 );
+    col = std::max( 0, std::min( cols - 1, col ) );
+    row = std::max( 0, std::min( rows - 1, row ) );
+
+    int maxRing = std::max( std::max( col, cols - 1 - col ), std::max( row, rows - 1 - row ) );
+
+    for ( int r = 0; r <= maxRing; r++ ) {
+        // every point on ring r is at least this far from ( col, row ), and
+        // the query point is within half a cell of it
+        double ringdist = ( r - 1 ) * std::min( fabs(wx), fabs(wy) );
+        if ( ringdist > 0 && ringdist * ringdist > mindist ) {
+            break;
+        }
+
+        for ( int i = col - r; i <= col + r; i++ ) {
+            if ( i < 0 || i >= cols ) {
+                continue;
+            }
+
+            // whole column on the ring's left and right edges, top and
+            // bottom only otherwise
+            int step = ( i == col - r || i == col + r ) ? 1 : 2 * r;
+            for ( int j = row - r; j <= row + r; j += step ) {
+                if ( j < 0 || j >= rows ) {
+                    continue;
+                }
+
+                double elev = get_array_elev( i, j );
+                if ( elev > -9000 ) {
+                    double dx   = ( originx + i * col_step - lon ) / col_step * wx;
+                    double dy   = ( originy + j * row_step - lat );
+                    double dist = dx * dx + dy * dy;
+
+                    if ( dist < mindist ) {
+                        mindist = dist;
+                        minelev = elev;
+                    }
+                }
             }
         }
     }
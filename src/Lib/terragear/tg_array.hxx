@@ -30,6 +30,17 @@
 
 class tgArray {
 
+public:
+    // void filling algorithms
+    //   LINES   : repeated row / column line fills ( the original )
+    //   NEAREST : every void takes the value of the nearest non void
+    //             sample, from an exact euclidean distance transform.
+    //             linear in the number of samples.
+    typedef enum {
+        VOID_FILL_LINES,
+        VOID_FILL_NEAREST
+    } VoidFillMethod;
+
 private:
     gzFile array_in;
 
@@ -53,6 +64,9 @@ private:
     std::vector<SGGeod> fitted_list;
 
     void parse_bin();
+
+    void remove_voids_lines();
+    void remove_voids_nearest();
 public:
 
     // Constructor
@@ -79,7 +93,7 @@ public:
 
     // do our best to remove voids by picking data from the nearest
     // neighbor.
-    void remove_voids();
+    void remove_voids( VoidFillMethod method = VOID_FILL_LINES );
 
     // Return the elevation of the closest non-void grid point to lon, lat
     double closest_nonvoid_elev( double lon, double lat ) const;
@@ -0,0 +1,218 @@
+// tg_array_cache.cxx -- shared cache of parsed elevation arrays
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <simgear/threads/SGGuard.hxx>
+#include <simgear/debug/logstream.hxx>
+
+#include "tg_array_cache.hxx"
+
+tgArrayCache::tgArrayCache( unsigned long maxBytes ) :
+    maxSize( maxBytes ),
+    curSize( 0 ),
+    voidFill( tgArray::VOID_FILL_LINES ),
+    hits( 0 ),
+    misses( 0 ),
+    evictions( 0 )
+{
+}
+
+tgArrayCache& tgArrayCache::instance( void )
+{
+    static tgArrayCache cache;
+    return cache;
+}
+
+tgArrayPtr tgArrayCache::get( const std::string& dir, const SGBucket& b )
+{
+    string_list paths;
+    paths.push_back( dir + "/" + b.gen_base_path() + "/" + b.gen_index_str() );
+
+    return lookup( paths[0], paths, b );
+}
+
+tgArrayPtr tgArrayCache::get( const std::string& root, const string_list& sources, const SGBucket& b )
+{
+    string_list paths;
+    std::string key;
+
+    for ( unsigned int i=0; i<sources.size(); i++ ) {
+        paths.push_back( root + "/" + sources[i] + "/" + b.gen_base_path() + "/" + b.gen_index_str() );
+
+        if ( i ) {
+            key += ";";
+        }
+        key += paths.back();
+    }
+
+    return lookup( key, paths, b );
+}
+
+tgArrayPtr tgArrayCache::lookup( const std::string& path_key, const string_list& paths, const SGBucket& b )
+{
+    tgArray::VoidFillMethod method;
+    std::string             key;
+
+    {
+        SGGuard<SGMutex> g(mutex);
+
+        // the same file filled another way is a different array
+        method = voidFill;
+        key    = path_key + ( method == tgArray::VOID_FILL_NEAREST ? "#nearest" : "#lines" );
+
+        EntryMap::iterator it = entries.find( key );
+        if ( it != entries.end() ) {
+            // move to the front
+            lru.splice( lru.begin(), lru, it->second );
+            hits++;
+
+            return it->second->array;
+        }
+
+        misses++;
+    }
+
+    // load without holding the lock, so other threads can use the cache
+    tgArrayPtr array = load( paths, b, method );
+
+    SGGuard<SGMutex> g(mutex);
+
+    // another thread may have loaded the same array meanwhile - use theirs
+    EntryMap::iterator it = entries.find( key );
+    if ( it != entries.end() ) {
+        lru.splice( lru.begin(), lru, it->second );
+        return it->second->array;
+    }
+
+    Entry e;
+    e.key   = key;
+    e.array = array;
+    e.size  = arraySize( *array );
+
+    lru.push_front( e );
+    entries[key] = lru.begin();
+    curSize += e.size;
+
+    evict();
+
+    return array;
+}
+
+tgArrayPtr tgArrayCache::load( const string_list& paths, const SGBucket& b, tgArray::VoidFillMethod method ) const
+{
+    tgArray* array = new tgArray();
+
+    for ( unsigned int i=0; i<paths.size(); i++ ) {
+        if ( array->open( paths[i] ) ) {
+            SG_LOG( SG_GENERAL, SG_DEBUG, "tgArrayCache: loading " << paths[i] );
+            break;
+        }
+    }
+
+    // this will fill in a zero structure if no array data found/opened
+    array->parse( b );
+    array->remove_voids( method );
+    array->close();
+
+    return tgArrayPtr( array );
+}
+
+// mutex must be held.  always keep the most recent array, even if it is
+// larger than the cache.
+void tgArrayCache::evict( void )
+{
+    while ( curSize > maxSize && lru.size() > 1 ) {
+        Entry& e = lru.back();
+
+        curSize -= e.size;
+        entries.erase( e.key );
+        lru.pop_back();
+
+        evictions++;
+    }
+}
+
+unsigned long tgArrayCache::arraySize( const tgArray& array )
+{
+    return sizeof(tgArray) +
+           (unsigned long)array.get_cols() * array.get_rows() * sizeof(short) +
+           ( array.get_corner_list().size() + array.get_fitted_list().size() ) * sizeof(SGGeod);
+}
+
+void tgArrayCache::setMaxSize( unsigned long maxBytes )
+{
+    SGGuard<SGMutex> g(mutex);
+
+    maxSize = maxBytes;
+    evict();
+}
+
+void tgArrayCache::setVoidFill( tgArray::VoidFillMethod method )
+{
+    SGGuard<SGMutex> g(mutex);
+    voidFill = method;
+}
+
+void tgArrayCache::clear( void )
+{
+    SGGuard<SGMutex> g(mutex);
+
+    lru.clear();
+    entries.clear();
+    curSize = 0;
+}
+
+unsigned long tgArrayCache::getHits( void ) const
+{
+    SGGuard<SGMutex> g(mutex);
+    return hits;
+}
+
+unsigned long tgArrayCache::getMisses( void ) const
+{
+    SGGuard<SGMutex> g(mutex);
+    return misses;
+}
+
+unsigned long tgArrayCache::getEvictions( void ) const
+{
+    SGGuard<SGMutex> g(mutex);
+    return evictions;
+}
+
+unsigned long tgArrayCache::getSize( void ) const
+{
+    SGGuard<SGMutex> g(mutex);
+    return curSize;
+}
+
+unsigned int tgArrayCache::getNumArrays( void ) const
+{
+    SGGuard<SGMutex> g(mutex);
+    return lru.size();
+}
+
+void tgArrayCache::logStats( void ) const
+{
+    SGGuard<SGMutex> g(mutex);
+
+    SG_LOG( SG_GENERAL, SG_ALERT, "Array cache: " << hits << " hits, " << misses << " misses, " << evictions << " evictions, " <<
+                                  lru.size() << " arrays ( " << curSize / (1024*1024) << " of " << maxSize / (1024*1024) << " MB )" );
+}
@@ -0,0 +1,113 @@
+// tg_array_cache.hxx -- shared cache of parsed elevation arrays
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+
+#ifndef _TG_ARRAY_CACHE_HXX
+#define _TG_ARRAY_CACHE_HXX
+
+#include <list>
+#include <map>
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+
+#include <simgear/bucket/newbucket.hxx>
+#include <simgear/math/sg_types.hxx>
+#include <simgear/threads/SGThread.hxx>
+
+#include "tg_array.hxx"
+
+// Adjacent tiles ( and airports ) read the same .arr.gz files over and
+// over - tgMesh::calcElevation reads the 8 neighbours of every tile, and
+// genapts parses the array under each airport for every surface fit.
+// Gunzipping and void filling a full grid each time is expensive.
+//
+// The cache keeps parsed, void filled arrays, least recently used first
+// out once the total grid size exceeds the limit.  Arrays are handed out
+// as shared, read only pointers - an evicted array stays valid for as
+// long as someone still holds it.  All methods are thread safe.
+
+#define TG_ARRAY_CACHE_DEFAULT_SIZE     (256*1024*1024)
+
+typedef boost::shared_ptr<const tgArray>    tgArrayPtr;
+
+class tgArrayCache
+{
+public:
+    tgArrayCache( unsigned long maxBytes = TG_ARRAY_CACHE_DEFAULT_SIZE );
+
+    // the process wide cache used by tg-construct, genapts and tgSurface
+    static tgArrayCache& instance( void );
+
+    // array for bucket b from <dir>/<base path>/<index>.  If there is no
+    // array file, a zero filled array covering the bucket is returned.
+    tgArrayPtr get( const std::string& dir, const SGBucket& b );
+
+    // try <root>/<source>/<base path>/<index> for each source in order,
+    // and use the first that exists
+    tgArrayPtr get( const std::string& root, const string_list& sources, const SGBucket& b );
+
+    void setMaxSize( unsigned long maxBytes );
+
+    // how arrays loaded from now on have their voids filled.  Arrays are
+    // cached per method, so ones filled the old way are never handed out.
+    void setVoidFill( tgArray::VoidFillMethod method );
+    void clear( void );
+
+    // statistics
+    unsigned long getHits( void ) const;
+    unsigned long getMisses( void ) const;
+    unsigned long getEvictions( void ) const;
+    unsigned long getSize( void ) const;
+    unsigned int  getNumArrays( void ) const;
+
+    void logStats( void ) const;
+
+private:
+    struct Entry {
+        std::string     key;
+        tgArrayPtr      array;
+        unsigned long   size;
+    };
+
+    typedef std::list<Entry>                            EntryList;
+    typedef std::map<std::string, EntryList::iterator>  EntryMap;
+
+    // not copyable
+    tgArrayCache( const tgArrayCache& );
+    tgArrayCache& operator=( const tgArrayCache& );
+
+    tgArrayPtr lookup( const std::string& path_key, const string_list& paths, const SGBucket& b );
+    tgArrayPtr load( const string_list& paths, const SGBucket& b, tgArray::VoidFillMethod method ) const;
+    void       evict( void );
+
+    static unsigned long arraySize( const tgArray& array );
+
+    EntryList           lru;        // most recently used at the front
+    EntryMap            entries;
+    unsigned long       maxSize;
+    unsigned long       curSize;
+
+    tgArray::VoidFillMethod voidFill;
+
+    unsigned long       hits;
+    unsigned long       misses;
+    unsigned long       evictions;
+
+    mutable SGMutex     mutex;
+};
+
+#endif // _TG_ARRAY_CACHE_HXX
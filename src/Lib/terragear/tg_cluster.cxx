@@ -12,15 +12,10 @@
 #include "tg_cluster.hxx"
 #include "tg_shapefile.hxx"
 
-// TODO Voronoi convergence is a bit slow - anything faster?
 #define DEBUG_CLUSTER   (0)
 #define LOG_CLUSER      SG_DEBUG
 
 
-std::list<EPECSegment_2>::iterator it;
-std::vector<EPECPoint_2>::iterator vfrom,vto;
-std::vector<EPECPoint_2>::iterator fcit;
-
 EPECPoint_2 tgCluster::Locate(const EPECPoint_2& point) const
 {
     VDLocateResult lr = vd.locate(point);
@@ -42,69 +37,118 @@ EPECPoint_2 tgCluster::Locate(const EPECPoint_2& point) const
     return q;
 }
 
-void tgCluster::computenewcentroids(void)
+// every node was placed in the cell Locate finds for it - a node moves if
+// it isn't at its cell's centroid
+void tgCluster::GetMoves( std::vector<EPECPoint_2>& from, std::vector<EPECPoint_2>& to ) const
 {
-    std::vector<tgVoronoiCell>::iterator oc, nc;
+    for ( unsigned int c = 0; c < newcells.size(); c++ ) {
+        const tgVoronoiCell& cell = newcells[c];
 
-    tag tg;
-    vd.clear();
-    for(oc = oldcells.begin(); oc!= oldcells.end(); oc++)
-    {
-        (*oc).face = vd.insert((*oc).centroid);
-        (*oc).nodes.clear();
+        for ( unsigned int n = 0; n < cell.nodes.size(); n++ ) {
+            if ( cell.nodes[n].point != cell.centroid ) {
+                from.push_back( cell.nodes[n].point );
+                to.push_back( cell.centroid );
+            }
+        }
     }
-    assert( vd.is_valid() );
+}
 
-    for ( std::list<tgClusterNode>::iterator it = nodes.begin(); it != nodes.end(); it++ )
-    {
-        EPECPoint_2 q = Locate(it->point);
+// one lloyd iteration, with doubles : assign each node to the nearest
+// centroid, and move the centroids to the mean of their nodes.
+// returns the squared distance of the furthest move.
+double tgCluster::computenewcentroids(void)
+{
+    std::vector<double>       sumx( cellPoints.size(), 0.0 );
+    std::vector<double>       sumy( cellPoints.size(), 0.0 );
+    std::vector<unsigned int> count( cellPoints.size(), 0 );
+    double                    maxMove = 0.0;
+
+    cellDT.clear();
+    for ( unsigned int i = 0; i < cellPoints.size(); i++ ) {
+        unsigned int              nv = cellDT.number_of_vertices();
+        clusterDT::Vertex_handle  vh = cellDT.insert( cellPoints[i] );
+
+        // coincident centroids share a vertex - the first cell keeps it
+        if ( cellDT.number_of_vertices() > nv ) {
+            vh->info() = i;
+        }
+    }
 
-        for(oc = oldcells.begin(); oc!= oldcells.end(); oc++)
-        {
-            if ( (*oc).centroid == q ) {
-                (*oc).nodes.push_back(*it);
-                break;
+    // consecutive nodes are usually close, so start each search where the
+    // last one ended
+    clusterDT::Face_handle hint;
+    for ( unsigned int i = 0; i < nodePoints.size(); i++ ) {
+        clusterDT::Vertex_handle vh = cellDT.nearest_vertex( nodePoints[i], hint );
+        unsigned int             c  = vh->info();
+
+        sumx[c] += nodePoints[i].x();
+        sumy[c] += nodePoints[i].y();
+        count[c]++;
+
+        hint = vh->face();
+    }
+
+    // cells without nodes keep their centroid
+    for ( unsigned int i = 0; i < cellPoints.size(); i++ ) {
+        if ( count[i] ) {
+            clusterPoint p( sumx[i] / count[i], sumy[i] / count[i] );
+            double       move = CGAL::squared_distance( p, cellPoints[i] );
+
+            if ( move > maxMove ) {
+                maxMove = move;
             }
+            cellPoints[i] = p;
         }
     }
 
-    // UPDATE THE CENTROIDS HERE
-    oc = oldcells.begin();
+    return maxMove;
+}
+
+// build the exact voronoi diagram used by Locate from the final
+// centroids, and fill in the cells with their nodes
+void tgCluster::computecells(void)
+{
+    CGAL::Unique_hash_map<DT::Vertex_handle, int> siteToCell( -1 );
+
+    vd.clear();
     newcells.clear();
+    newcells.resize( cellPoints.size() );
 
-    for(oc = oldcells.begin(); oc!= oldcells.end(); oc++)
+    for ( unsigned int i = 0; i < cellPoints.size(); i++ ) {
+        newcells[i].centroid = EPECPoint_2( cellPoints[i].x(), cellPoints[i].y() );
+        newcells[i].fixed    = false;
+        newcells[i].face     = vd.insert( newcells[i].centroid );
+
+        DT::Vertex_handle site = newcells[i].face->dual();
+        if ( !siteToCell.is_defined( site ) ) {
+            siteToCell[site] = i;
+        }
+    }
+    assert( vd.is_valid() );
+
+    for ( std::list<tgClusterNode>::iterator it = nodes.begin(); it != nodes.end(); it++ )
     {
-        tgVoronoiCell newvc;
-        if ((*oc).nodes.empty())
-        {
-            newvc.centroid = (*oc).centroid;
-            newvc.face     = (*oc).face;
-            newvc.nodes    = (*oc).nodes;
+        VDLocateResult    lr = vd.locate( it->point );
+        DT::Vertex_handle site;
+
+        if ( VDVertexHandle* v = boost::get<VDVertexHandle>(&lr) ) {
+            site = (*v)->site(0);
+        } else if ( VDHalfedgeHandle* e = boost::get<VDHalfedgeHandle>(&lr) ) {
+            site = (*e)->up();
+        } else if ( VDFaceHandle* f = boost::get<VDFaceHandle>(&lr) ) {
+            site = (*f)->dual();
         }
-        else
-        {
-            // if he voronoi cell has fixed nodes, set them as centroids for new cells
-            std::vector<tgClusterNode>::const_iterator nit = (*oc).nodes.begin();
-
-            // todo - split a voronoi cell if more than 1 fixed node inside
-            std::vector<EPECPoint_2> positions;
-            while ( nit != (*oc).nodes.end() ) {
-                positions.push_back( nit->point );
-                nit++;
-            }
 
-            newvc.centroid = CGAL::centroid(positions.begin(),positions.end(),tg);
-            newvc.face     = (*oc).face;
-            newvc.nodes    = (*oc).nodes;
+        int c = siteToCell[site];
+        if ( c >= 0 ) {
+            newcells[c].nodes.push_back( *it );
         }
-        newcells.push_back(newvc);
     }
 }
 
-tgCluster::tgCluster( std::list<tgClusterNode>& points, double err, const std::string& d )
+tgCluster::tgCluster( std::list<tgClusterNode>& points, double err, const std::string& d, double convergence )
 {
-    int  kiter = 40, iiter = 0;
-    bool is_equal = false;
+    int  kiter = TG_CLUSTER_MAX_ITERATIONS, iiter = 0;
 
     squaredError = err;
     debug = d;
@@ -334,46 +378,34 @@ tgCluster::tgCluster( std::list<tgClusterNode>& points, double err, const std::s
 
     SG_LOG( SG_GENERAL, LOG_CLUSER,  " Do voronoi relaxation with " << oldcentroids.size() << " nodes" );
 
-    // create voronoi cells for each centroid
+    // the relaxation is done in doubles, and only the final centroids are
+    // made exact
+    nodePoints.clear();
+    nodePoints.reserve( nodes.size() );
+    for ( lit = nodes.begin(); lit != nodes.end(); lit++ ) {
+        nodePoints.push_back( clusterPoint( CGAL::to_double( lit->point.x() ), CGAL::to_double( lit->point.y() ) ) );
+    }
+
+    cellPoints.clear();
+    cellPoints.reserve( oldcentroids.size() );
     for ( it = oldcentroids.begin(); it != oldcentroids.end(); it++ ) {
-        tgVoronoiCell newvc;
-        newvc.centroid = it->point;
-        newvc.fixed    = it->fixed;
-        oldcells.push_back( newvc );
+        cellPoints.push_back( clusterPoint( CGAL::to_double( it->point.x() ), CGAL::to_double( it->point.y() ) ) );
     }
 
     while( iiter < kiter )
     {
-        computenewcentroids();
+        double maxMove = computenewcentroids();
         iiter++;
 
-        if(newcells.size() < oldcells.size())
-        {
-            is_equal = std::equal(newcells.begin(),newcells.end(),oldcells.begin());
-        }
-        else
-        {
-            is_equal = std::equal(oldcells.begin(),oldcells.end(),newcells.begin());
-        }
-
-        if( is_equal )
-        {
-            is_equal = false;
+        if ( maxMove <= convergence * convergence ) {
             break;
         }
-        else 
-        {
-            // iterate again - move new to old
-            oldcells.clear();
-            std::vector<tgVoronoiCell>::iterator cit = newcells.begin();
-            for(cit = newcells.begin(); cit!= newcells.end(); cit++)
-            {
-                tgVoronoiCell newvc;
-                newvc.centroid = (*cit).centroid;
-                oldcells.push_back( newvc );
-            }
-        }
     }
+
+    SG_LOG( SG_GENERAL, LOG_CLUSER,  " voronoi relaxation done after " << iiter << " iterations" );
+
+    computecells();
+    cellDT.clear();
 }
 
 void tgCluster::toShapefile( const char* datasource, const char* layer_prefix )
@@ -17,6 +17,9 @@
 #include <CGAL/centroid.h>
 #include <CGAL/Dimension.h>
 
+#include <CGAL/Triangulation_vertex_base_with_info_2.h>
+#include <CGAL/Unique_hash_map.h>
+
 #include <CGAL/Kd_tree.h>
 #include <CGAL/algorithm.h>
 #include <CGAL/Fuzzy_sphere.h>
@@ -29,6 +32,18 @@ typedef CGAL::Delaunay_triangulation_caching_degeneracy_removal_policy_2<DT> AP;
 typedef CGAL::Voronoi_diagram_2<DT,AT,AP>                                    VD;
 typedef CGAL::Dimension_tag<0>                                               tag;
 
+// the relaxation runs on an inexact delaunay triangulation - each vertex
+// holds the index of its cell, so locating a node's cell is a nearest
+// vertex query
+typedef CGAL::Triangulation_vertex_base_with_info_2<unsigned int, EPICKernel> clusterVb;
+typedef CGAL::Triangulation_data_structure_2<clusterVb>                      clusterTds;
+typedef CGAL::Delaunay_triangulation_2<EPICKernel, clusterTds>               clusterDT;
+typedef EPICKernel::Point_2                                                  clusterPoint;
+
+// stop the relaxation once no centroid moves further than this ( degrees )
+#define TG_CLUSTER_CONVERGENCE      (0.000000001)
+#define TG_CLUSTER_MAX_ITERATIONS   (40)
+
 //typedef K::Point_2                            Point;
 typedef EPECKernel::Iso_rectangle_2             EPECIsoRectangle;
 
@@ -86,13 +101,17 @@ public:
 class tgCluster 
 {
 public:
-    tgCluster( std::list<tgClusterNode>& points, double err, const std::string& d );
+    tgCluster( std::list<tgClusterNode>& points, double err, const std::string& d, double convergence = TG_CLUSTER_CONVERGENCE );
     EPECPoint_2 Locate( const EPECPoint_2& point ) const;
 
+    // the nodes that Locate moves, and where they go
+    void GetMoves( std::vector<EPECPoint_2>& from, std::vector<EPECPoint_2>& to ) const;
+
     void toShapefile( const char* datasource, const char* layer );
 
 private:
-    void computenewcentroids(void);
+    double computenewcentroids(void);
+    void   computecells(void);
 
     // debug
     GDALDataset* openDatasource( const std::string& debug ) const;
@@ -111,7 +130,12 @@ private:
     PointsArray                 vpoints;
 
     std::vector<tgClusterNode>  oldcentroids, newcentroids;
-    std::vector<tgVoronoiCell>  oldcells,     newcells;
+    std::vector<tgVoronoiCell>  newcells;
+
+    // relaxation state, in doubles : node positions, and cell centroids
+    std::vector<clusterPoint>   nodePoints;
+    std::vector<clusterPoint>   cellPoints;
+    clusterDT                   cellDT;
 
     VDnodesTree tree;
     VD          vd;
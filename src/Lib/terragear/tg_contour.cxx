@@ -6,7 +6,6 @@
 //#include "tg_accumulator.hxx"
 #include "tg_contour.hxx"
 #include "tg_polygon.hxx"
-#include "tg_unique_tgnode.hxx"
 #include "tg_shapefile.hxx"
 
 #define DEBUG_POLY_CLEAN    SG_INFO
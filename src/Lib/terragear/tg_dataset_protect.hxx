@@ -32,19 +32,22 @@ public:
     void AddWaiter( SGMutex& m ) {
         //SGGuard<SGMutex> g(mutex);
 
-        SG_LOG(SG_GENERAL, SG_INFO, "tgDataSetProtect task " << SGThread::current() << " waiting on tile " << tid << " num ahead is " << numWaiting );
+        SG_LOG(SG_GENERAL, SG_DEBUG, "tgDataSetProtect task " << SGThread::current() << " waiting on tile " << tid << " num ahead is " << numWaiting );
         
         numWaiting++;
         while ( inUse ) {            
             available.wait( m );
-            SG_LOG(SG_GENERAL, SG_INFO, "tgDataSetProtect task " << SGThread::current() << " signalled for tile " << tid << " num waiting is " << numWaiting << " inUse is " << inUse );            
+            SG_LOG(SG_GENERAL, SG_DEBUG, "tgDataSetProtect task " << SGThread::current() << " signalled for tile " << tid << " num waiting is " << numWaiting << " inUse is " << inUse );            
         }
+
+        // it's ours now
+        inUse = true;
     }
 
     bool RemoveWaiter( void ) {
         //SGGuard<SGMutex> g(mutex);
 
-        SG_LOG(SG_GENERAL, SG_INFO, "tgDataSetProtect task " << SGThread::current() << " finished with tile " << tid << " num waiting is " << numWaiting );
+        SG_LOG(SG_GENERAL, SG_DEBUG, "tgDataSetProtect task " << SGThread::current() << " finished with tile " << tid << " num waiting is " << numWaiting );
         
         numWaiting--;
         inUse = false;
@@ -82,7 +85,7 @@ public:
             waitingTasks[tileId] = new tileInfo( tileId );
             // we can continue to use it - we're the first to ask for it
             // so no call to AddWaiter
-            SG_LOG(SG_GENERAL, SG_INFO, "tgDataSetProtect task " << SGThread::current() << " working on tile " << tileId );
+            SG_LOG(SG_GENERAL, SG_DEBUG, "tgDataSetProtect task " << SGThread::current() << " working on tile " << tileId );
         } else {
             // tile is in the map, so it is already in use
             // once AddWaiter returns, we have the tile for ourselves
@@ -313,25 +313,30 @@ void TGNodes::CalcElevations( tgNodeType type ) {
 }
     
 void TGNodes::CalcElevations( tgNodeType type, const tgSurface& surf ) {
+    std::vector<unsigned int> nodes;
+    std::vector<double>       lon, lat, elev;
+
     for(unsigned int i = 0; i < tg_node_list.size(); i++) {
         if ( tg_node_list[i].GetType() == type ) {
-            SGGeod pos = tg_node_list[i].GetPosition();
-
-            switch (type)
-            {
-                case TG_NODE_FIXED_ELEVATION:
-                case TG_NODE_INTERPOLATED:
-                case TG_NODE_DRAPED:
-                    break;
-
-                case TG_NODE_SMOOTHED:
-                    SetElevation( i, surf.query( pos ) );
-                    break;
+            if ( type == TG_NODE_SMOOTHED ) {
+                nodes.push_back( i );
+                lon.push_back( tg_node_list[i].GetPosition().getLongitudeDeg() );
+                lat.push_back( tg_node_list[i].GetPosition().getLatitudeDeg() );
             }
         } else {
             SG_LOG(SG_GENERAL, SG_ALERT, "CalcElevations smoothed Ignore pos " << tg_node_list[i].GetPosition() << " with type " << tg_node_list[i].GetType() );
         }        
     }
+
+    // get elevation from smoothing function, all at once
+    if ( !nodes.empty() ) {
+        elev.resize( nodes.size() );
+        surf.query( &lon[0], &lat[0], &elev[0], nodes.size() );
+
+        for ( unsigned int n = 0; n < nodes.size(); n++ ) {
+            SetElevation( nodes[n], elev[n] );
+        }
+    }
 }
 
 void TGNodes::CalcElevations( tgNodeType type, const tgtriangle_list& mesh ) {
@@ -21,7 +21,6 @@
 #include <simgear/io/lowlevel.hxx>
 
 #include "tg_triangle.hxx"
-//#include "tg_unique_tgnode.hxx"
 #include "tg_surface.hxx"
 #include "tg_array.hxx"
 
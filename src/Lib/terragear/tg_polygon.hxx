@@ -28,6 +28,7 @@
 # error This library requires C++
 #endif
 
+#include <atomic>
 #include <iostream>
 #include <map>
 #include <string>
@@ -101,7 +102,7 @@ class tgPolygon
 {
 public:
     tgPolygon() {
-        static unsigned int cur_id = 0;
+        static std::atomic<unsigned int> cur_id( 0 );
         
         preserve3d = false;
         tp.method = TG_TEX_UNKNOWN;
@@ -365,6 +366,14 @@ public:
     void Tesselate( bool debug );
     void Tesselate( const std::vector<SGGeod>& extra, bool debug );
 
+    // Tesselate triangulates over doubles first, and falls back to the
+    // exact kernel for polygons whose triangulation fails its checks.
+    // The stats count the polygons done each way.
+    static void SetTesselateExact( bool exact );
+    static void GetTesselateStats( unsigned long& inexact, unsigned long& fallback );
+    static void ResetTesselateStats( void );
+    static void LogTesselateStats( void );
+
     // Straight Skeleton
     tgpolygon_list StraightSkeleton(void);
     
@@ -1,13 +1,17 @@
+#include <atomic>
 #include <iostream>
 #include <cassert>
+#include <set>
 
 #include <CGAL/Exact_predicates_exact_constructions_kernel.h>
+#include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
 #include <CGAL/Constrained_Delaunay_triangulation_2.h>
 #include <CGAL/Triangulation_face_base_with_info_2.h>
 #include <CGAL/Constrained_triangulation_plus_2.h>
 #include <CGAL/Polygon_2.h>
 #include <CGAL/Triangle_2.h>
 #include <CGAL/Line_2.h>
+#include <CGAL/exceptions.h>
 
 #include <simgear/debug/logstream.hxx>
 
@@ -47,6 +51,18 @@ typedef CGAL::Search_traits_adapter<PointHandle,CGAL::Nth_of_tuple_property_map<
 typedef CGAL::Fuzzy_sphere<SearchTraits>                          SearchFuzzyCir;
 typedef CGAL::Kd_tree<SearchTraits>                               SearchTree;
 
+// The same triangulation over doubles.  Predicates are still exact, so
+// this gives the exact triangulation as long as no constraints cross - see
+// tg_tesselate
+typedef CGAL::Exact_predicates_inexact_constructions_kernel       IK;
+typedef CGAL::Triangulation_vertex_base_2<IK>                     IVb;
+typedef CGAL::Triangulation_face_base_with_info_2<FaceInfo2,IK>   IFbb;
+typedef CGAL::Constrained_triangulation_face_base_2<IK,IFbb>      IFb;
+typedef CGAL::Triangulation_data_structure_2<IVb,IFb>             ITDS;
+typedef CGAL::Exact_predicates_tag                                IItag;
+typedef CGAL::Constrained_Delaunay_triangulation_2<IK, ITDS, IItag> ICDT;
+typedef CGAL::Constrained_triangulation_plus_2<ICDT>              ICDTPlus;
+
 
 
 
@@ -119,23 +135,24 @@ static CDTPlus::Vertex_handle Lookup(  const SGGeod& p, SearchTree& tree ) {
 }
 #endif
 
-static void tg_mark_domains(CDT& ct, CDT::Face_handle start, int index, std::list<CDT::Edge>& border )
+template <class T>
+static void tg_mark_domains(T& ct, typename T::Face_handle start, int index, std::list<typename T::Edge>& border )
 {
     if(start->info().nesting_level != -1) {
         return;
     }
 
-    std::list<CDTPlus::Face_handle> queue;
+    std::list<typename T::Face_handle> queue;
     queue.push_back(start);
 
     while( !queue.empty() ){
-        CDTPlus::Face_handle fh = queue.front();
+        typename T::Face_handle fh = queue.front();
         queue.pop_front();
         if(fh->info().nesting_level == -1) {
             fh->info().nesting_level = index;
             for(int i = 0; i < 3; i++) {
-                CDTPlus::Edge e(fh,i);
-                CDTPlus::Face_handle n = fh->neighbor(i);
+                typename T::Edge e(fh,i);
+                typename T::Face_handle n = fh->neighbor(i);
                 if(n->info().nesting_level == -1) {
                     if(ct.is_constrained(e)) border.push_back(e);
                     else queue.push_back(n);
@@ -151,37 +168,164 @@ static void tg_mark_domains(CDT& ct, CDT::Face_handle start, int index, std::lis
 //level of 0. Then we recursively consider the non-explored facets incident
 //to constrained edges bounding the former set and increase the nesting level by 1.
 //Facets in the domain are those with an odd nesting level.
-static void tg_mark_domains(CDTPlus& cdt)
+template <class T>
+static void tg_mark_domains(T& cdt)
 {
-    for(CDTPlus::All_faces_iterator it = cdt.all_faces_begin(); it != cdt.all_faces_end(); ++it){
+    for(typename T::All_faces_iterator it = cdt.all_faces_begin(); it != cdt.all_faces_end(); ++it){
         it->info().nesting_level = -1;
     }
 
     int index = 0;
-    std::list<CDTPlus::Edge> border;
+    std::list<typename T::Edge> border;
     tg_mark_domains(cdt, cdt.infinite_face(), index++, border);
     while(! border.empty()) {
-        CDTPlus::Edge e = border.front();
+        typename T::Edge e = border.front();
         border.pop_front();
-        CDTPlus::Face_handle n = e.first->neighbor(e.second);
+        typename T::Face_handle n = e.first->neighbor(e.second);
         if(n->info().nesting_level == -1) {
             tg_mark_domains(cdt, n, e.first->info().nesting_level+1, border);
         }
     }
 }
 
-static void tg_insert_polygon(CDTPlus& cdt,const Polygon_2& polygon)
+template <class T>
+static void tg_insert_contour(T& cdt, const tgContour& contour)
 {
-    if ( polygon.is_empty() ) return;
+    typedef typename T::Point TPoint;
+
+    if ( contour.GetSize() == 0 ) return;
 
-    CDTPlus::Vertex_handle v_prev=cdt.insert(*CGAL::cpp0x::prev(polygon.vertices_end()));
-    for (Polygon_2::Vertex_iterator vit=polygon.vertices_begin(); vit!=polygon.vertices_end();++vit) {
-        CDTPlus::Vertex_handle vh=cdt.insert(*vit);
+    SGGeod last = contour.GetNode( contour.GetSize()-1 );
+    typename T::Vertex_handle v_prev=cdt.insert( TPoint( last.getLongitudeDeg(), last.getLatitudeDeg() ) );
+    for (unsigned int n = 0; n < contour.GetSize(); n++ ) {
+        SGGeod node = contour.GetNode(n);
+        SG_LOG( SG_GENERAL, SG_DEBUG, "Tess : Adding GEOD " << node);
+
+        typename T::Vertex_handle vh=cdt.insert( TPoint( node.getLongitudeDeg(), node.getLatitudeDeg() ) );
         cdt.insert_constraint(vh,v_prev);
         v_prev=vh;
     }
 }
 
+// Triangulate the contours, and return the corners of the triangles in
+// the domain.  With check set, returns false if the triangulation can't
+// be trusted : it is invalid, or has a vertex that isn't a contour node.
+template <class T>
+static bool tg_triangulate( const tgcontour_list& contours, bool check, std::vector<SGGeod>& tris )
+{
+    T cdt;
+
+    // insert each polygon as a constraint into the triangulation
+    for ( unsigned int c = 0; c < contours.size(); c++ ) {
+        tg_insert_contour(cdt, contours[c]);
+    }
+
+    if ( check ) {
+        // a new vertex is where two constraints cross - the only point the
+        // triangulation has to construct
+        std::set< std::pair<double, double> > nodes;
+        for ( unsigned int c = 0; c < contours.size(); c++ ) {
+            for ( unsigned int n = 0; n < contours[c].GetSize(); n++ ) {
+                SGGeod node = contours[c].GetNode(n);
+                nodes.insert( std::make_pair( node.getLongitudeDeg(), node.getLatitudeDeg() ) );
+            }
+        }
+
+        if ( cdt.number_of_vertices() != nodes.size() ) {
+            SG_LOG( SG_GENERAL, SG_DEBUG, "Tess : constraints intersect - " << cdt.number_of_vertices() - nodes.size() << " new vertices" );
+            return false;
+        }
+        if ( !cdt.is_valid() ) {
+            SG_LOG( SG_GENERAL, SG_DEBUG, "Tess : triangulation is not valid" );
+            return false;
+        }
+    } else {
+        assert(cdt.is_valid());
+    }
+
+    tg_mark_domains( cdt );
+
+    for (typename T::Finite_faces_iterator fit=cdt.finite_faces_begin(); fit!=cdt.finite_faces_end(); ++fit) {
+        if ( fit->info().in_domain() ) {
+            SG_LOG( SG_GENERAL, SG_DEBUG, "Tess : face   in domain");
+
+            typename T::Triangle tri = cdt.triangle(fit);
+
+            if ( check && tri.is_degenerate() ) {
+                SG_LOG( SG_GENERAL, SG_DEBUG, "Tess : degenerate triangle" );
+                return false;
+            }
+
+            tris.push_back( SGGeod::fromDeg( CGAL::to_double(tri.vertex(0).x()), CGAL::to_double(tri.vertex(0).y()) ) );
+            tris.push_back( SGGeod::fromDeg( CGAL::to_double(tri.vertex(1).x()), CGAL::to_double(tri.vertex(1).y()) ) );
+            tris.push_back( SGGeod::fromDeg( CGAL::to_double(tri.vertex(2).x()), CGAL::to_double(tri.vertex(2).y()) ) );
+        } else {
+            SG_LOG( SG_GENERAL, SG_DEBUG, "Tess : face not in domain");
+        }
+    }
+
+    return true;
+}
+
+// How many polygons took each path - counted from every thread
+static std::atomic<unsigned long> tesselate_inexact( 0 );
+static std::atomic<unsigned long> tesselate_fallback( 0 );
+static bool                       tesselate_exact = false;
+
+// Try the inexact triangulation first - most polygons are simple, and
+// their triangulation over doubles is the same as over the exact kernel.
+// Polygons that fail its checks are done again with the exact kernel.
+static void tg_tesselate( const tgcontour_list& contours, unsigned int id, std::vector<SGGeod>& tris )
+{
+    bool done = false;
+
+    if ( !tesselate_exact ) {
+        try {
+            done = tg_triangulate<ICDTPlus>( contours, true, tris );
+        } catch ( CGAL::Failure_exception& e ) {
+            SG_LOG( SG_GENERAL, SG_DEBUG, "Tess : inexact triangulation failed : " << e.what() );
+        }
+
+        if ( done ) {
+            tesselate_inexact++;
+        } else {
+            tesselate_fallback++;
+        }
+    }
+
+    if ( !done ) {
+        SG_LOG( SG_GENERAL, SG_DEBUG, "Tess " << id << " : using exact kernel" );
+
+        tris.clear();
+        tg_triangulate<CDTPlus>( contours, false, tris );
+    }
+}
+
+void tgPolygon::SetTesselateExact( bool exact )
+{
+    tesselate_exact = exact;
+}
+
+void tgPolygon::GetTesselateStats( unsigned long& inexact, unsigned long& fallback )
+{
+    inexact  = tesselate_inexact;
+    fallback = tesselate_fallback;
+}
+
+void tgPolygon::ResetTesselateStats( void )
+{
+    tesselate_inexact  = 0;
+    tesselate_fallback = 0;
+}
+
+void tgPolygon::LogTesselateStats( void )
+{
+    unsigned long inexact  = tesselate_inexact;
+    unsigned long fallback = tesselate_fallback;
+
+    SG_LOG( SG_GENERAL, SG_ALERT, "tgPolygon::Tesselate : " << inexact + fallback << " polygons, " << fallback << " fell back to the exact kernel ( " <<
+                                  ( inexact + fallback ? 100.0 * fallback / ( inexact + fallback ) : 0.0 ) << "% )" );
+}
 
 #if 0
 static void save_cgal_debug( unsigned long id, SearchTree& tree, const std::vector<constraint>&  constraints )
@@ -409,7 +553,6 @@ void tgPolygon::Tesselate( const std::vector<SGGeod>& extra, bool debug )
 
 void tgPolygon::Tesselate(bool debug)
 {
-    CDTPlus cdt;
     std::vector<SGGeod> geods;
     char layer[256];
     
@@ -423,57 +566,15 @@ void tgPolygon::Tesselate(bool debug)
     
     // Bail right away if polygon is empty
     if ( contours.size() != 0 ) {
-        // insert each polygon as a constraint into the triangulation
-        for ( unsigned int c = 0; c < contours.size(); c++ ) {
-            tgContour contour = contours[c];
-            Polygon_2 poly;
-
-            for (unsigned int n = 0; n < contour.GetSize(); n++ ) {
-                SGGeod node = contour.GetNode(n);
-                SG_LOG( SG_GENERAL, SG_DEBUG, "Tess : Adding GEOD " << node);
-                poly.push_back( Point( node.getLongitudeDeg(), node.getLatitudeDeg() ) );
-
-                geods.push_back( node );                
-            }
-
-            tg_insert_polygon(cdt, poly);
-        }
-
         if ( debug ) {
             sprintf( layer, "nodes_%03d", id );
             //tgShapefile::FromGeodList( geods, false, "./tridbg", layer, "nodes" );
         }
         
-        assert(cdt.is_valid());
-        tg_mark_domains( cdt );
+        tg_tesselate( contours, id, geods );
 
-        int count=0;
-        geods.clear();
-        for (CDTPlus::Finite_faces_iterator fit=cdt.finite_faces_begin(); fit!=cdt.finite_faces_end(); ++fit) {
-            if ( fit->info().in_domain() ) {
-                SG_LOG( SG_GENERAL, SG_DEBUG, "Tess : face   in domain");
-
-                Triangle_2 tri = cdt.triangle(fit);
-
-                SGGeod p0 = SGGeod::fromDeg( to_double(tri.vertex(0).x()), to_double(tri.vertex(0).y()) );
-                SGGeod p1 = SGGeod::fromDeg( to_double(tri.vertex(1).x()), to_double(tri.vertex(1).y()) );
-                SGGeod p2 = SGGeod::fromDeg( to_double(tri.vertex(2).x()), to_double(tri.vertex(2).y()) );
-
-                geods.push_back( p0 );
-                geods.push_back( p1 );
-                geods.push_back( p2 );
-                
-                /* Check for Zero Area before inserting */
-                //if ( !SGGeod_isEqual2D( p0, p1 ) && !SGGeod_isEqual2D( p1, p2 ) && !SGGeod_isEqual2D( p0, p2 ) ) {
-                    AddTriangle( p0, p1, p2 );
-                //} else {
-                //    SG_LOG( SG_GENERAL, SG_BULK, "tesselation dropping ZAT" );
-                //}
-
-                ++count;
-            } else {
-                SG_LOG( SG_GENERAL, SG_DEBUG, "Tess : face not in domain");
-            }
+        for ( unsigned int i = 0; i+2 < geods.size(); i += 3 ) {
+            AddTriangle( geods[i], geods[i+1], geods[i+2] );
         }
         
         if ( debug ) {
@@ -490,57 +591,17 @@ void tgPolygon::Tesselate(bool debug)
 
 void tgPolygon::Tesselate( const std::vector<SGGeod>& extra, bool debug )
 {
-    CDTPlus cdt;
     std::vector<SGGeod> geods;
-    char layer[256];
     
     SG_LOG( SG_GENERAL, SG_DEBUG, "Tess " << id );
         
     // Bail right away if polygon is empty
     if ( contours.size() != 0 ) {
-        // insert each polygon as a constraint into the triangulation
-        for ( unsigned int c = 0; c < contours.size(); c++ ) {
-            tgContour contour = contours[c];
-            Polygon_2 poly;
-
-            for (unsigned int n = 0; n < contour.GetSize(); n++ ) {
-                SGGeod node = contour.GetNode(n);
-                SG_LOG( SG_GENERAL, SG_DEBUG, "Tess : Adding GEOD " << node);
-                poly.push_back( Point( node.getLongitudeDeg(), node.getLatitudeDeg() ) );
-
-                geods.push_back( node );                
-            }
+        tg_tesselate( contours, id, geods );
 
-            tg_insert_polygon(cdt, poly);
+        for ( unsigned int i = 0; i+2 < geods.size(); i += 3 ) {
+            AddTriangle( geods[i], geods[i+1], geods[i+2] );
         }
-        
-        assert(cdt.is_valid());
-        tg_mark_domains( cdt );
-
-        int count=0;
-        geods.clear();
-        for (CDTPlus::Finite_faces_iterator fit=cdt.finite_faces_begin(); fit!=cdt.finite_faces_end(); ++fit) {
-            if ( fit->info().in_domain() ) {
-                SG_LOG( SG_GENERAL, SG_DEBUG, "Tess : face   in domain");
-
-                Triangle_2 tri = cdt.triangle(fit);
-
-                SGGeod p0 = SGGeod::fromDeg( to_double(tri.vertex(0).x()), to_double(tri.vertex(0).y()) );
-                SGGeod p1 = SGGeod::fromDeg( to_double(tri.vertex(1).x()), to_double(tri.vertex(1).y()) );
-                SGGeod p2 = SGGeod::fromDeg( to_double(tri.vertex(2).x()), to_double(tri.vertex(2).y()) );
-
-                geods.push_back( p0 );
-                geods.push_back( p1 );
-                geods.push_back( p2 );
-                
-                /* Check for Zero Area before inserting */
-                AddTriangle( p0, p1, p2 );
-
-                ++count;
-            } else {
-                SG_LOG( SG_GENERAL, SG_DEBUG, "Tess : face not in domain");
-            }
-        }        
     } else {
         SG_LOG( SG_GENERAL, SG_DEBUG, "Tess : no contours" );
     }
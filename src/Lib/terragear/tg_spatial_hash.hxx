@@ -0,0 +1,178 @@
+#ifndef _TG_SPATIAL_HASH_HXX
+#define _TG_SPATIAL_HASH_HXX
+
+#include <cmath>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+
+// Tolerance aware set of points, with stable insertion indices.
+//
+// The tg_unique_* sets hashed the coordinates rounded to 5 decimal places,
+// but compared them with a 6 decimal place epsilon - two points closer than
+// the epsilon that round to different values landed in different buckets,
+// and were both kept.
+//
+// Here each point is quantized to an integer grid cell the size of the
+// epsilon.  Any point within epsilon ( in every coordinate ) of another is
+// in the same, or an adjacent, cell - so a lookup probes the 3^DIM cells
+// around the point.  Points in a cell are chained through next[] by
+// insertion index, and the map only holds the most recent point of each
+// occupied cell.
+//
+// When more than one stored point matches, the first one added wins, so the
+// result doesn't depend on the order the cells are probed in.
+//
+// The traits class gives the number of coordinates compared, and each of
+// them as a double :
+//
+//   struct Traits {
+//       static const unsigned int dim = 2;
+//       static double coord( const T& v, unsigned int i );
+//   };
+
+template <typename T, typename Traits>
+class tgSpatialHashSet {
+public:
+    tgSpatialHashSet( double eps ) : epsilon( eps ), scale( 1.0 / eps ) {}
+
+    unsigned int add( const T& v ) {
+        CellKey key  = GetKey( v );
+        int     index = Find( v, key );
+
+        if ( index < 0 ) {
+            index = point_list.size();
+            point_list.push_back( v );
+
+            typename cell_map::iterator it = cells.find( key );
+            if ( it == cells.end() ) {
+                next.push_back( (unsigned int)NONE );
+                cells.insert( std::make_pair( key, (unsigned int)index ) );
+            } else {
+                next.push_back( it->second );
+                it->second = index;
+            }
+        }
+
+        return index;
+    }
+
+    // index of the first point added within epsilon of v, or -1
+    int find( const T& v ) const {
+        return Find( v, GetKey( v ) );
+    }
+
+    void reserve( unsigned int n ) {
+        point_list.reserve( n );
+        next.reserve( n );
+    }
+
+    void clear( void ) {
+        point_list.clear();
+        next.clear();
+        cells.clear();
+    }
+
+    T const& operator[]( int index ) const {
+        return point_list[index];
+    }
+
+    T& operator[]( int index ) {
+        return point_list[index];
+    }
+
+    size_t size( void ) const {
+        return point_list.size();
+    }
+
+    std::vector<T>& get_list( void ) { return point_list; }
+    const std::vector<T>& get_list( void ) const { return point_list; }
+
+private:
+    static const unsigned int NONE = 0xFFFFFFFF;
+
+    struct CellKey {
+        boost::int64_t c[Traits::dim];
+
+        bool operator==( const CellKey& o ) const {
+            for ( unsigned int i = 0; i < Traits::dim; i++ ) {
+                if ( c[i] != o.c[i] ) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    struct CellKeyHash {
+        std::size_t operator()( const CellKey& k ) const {
+            // FNV-1a over the cell coordinates
+            boost::uint64_t hash = 14695981039346656037ULL;
+            for ( unsigned int i = 0; i < Traits::dim; i++ ) {
+                hash = ( hash ^ (boost::uint64_t)k.c[i] ) * 1099511628211ULL;
+            }
+            return (std::size_t)( hash ^ ( hash >> 32 ) );
+        }
+    };
+
+    typedef boost::unordered_map<CellKey, unsigned int, CellKeyHash> cell_map;
+
+    CellKey GetKey( const T& v ) const {
+        CellKey key;
+        for ( unsigned int i = 0; i < Traits::dim; i++ ) {
+            key.c[i] = (boost::int64_t)std::floor( Traits::coord( v, i ) * scale );
+        }
+        return key;
+    }
+
+    bool IsClose( const T& a, const T& b ) const {
+        for ( unsigned int i = 0; i < Traits::dim; i++ ) {
+            if ( !( std::fabs( Traits::coord( a, i ) - Traits::coord( b, i ) ) < epsilon ) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int Find( const T& v, const CellKey& key ) const {
+        unsigned int num_probes = 1;
+        int          found = -1;
+
+        for ( unsigned int i = 0; i < Traits::dim; i++ ) {
+            num_probes *= 3;
+        }
+
+        for ( unsigned int p = 0; p < num_probes; p++ ) {
+            CellKey      probe;
+            unsigned int offsets = p;
+
+            for ( unsigned int i = 0; i < Traits::dim; i++ ) {
+                probe.c[i] = key.c[i] + (int)( offsets % 3 ) - 1;
+                offsets /= 3;
+            }
+
+            typename cell_map::const_iterator it = cells.find( probe );
+            if ( it == cells.end() ) {
+                continue;
+            }
+
+            // chains run from the newest point to the oldest
+            for ( unsigned int k = it->second; k != NONE; k = next[k] ) {
+                if ( ( found < 0 || k < (unsigned int)found ) && IsClose( point_list[k], v ) ) {
+                    found = k;
+                }
+            }
+        }
+
+        return found;
+    }
+
+    double                      epsilon;
+    double                      scale;
+    std::vector<T>              point_list;
+    std::vector<unsigned int>   next;
+    cell_map                    cells;
+};
+
+#endif /* _TG_SPATIAL_HASH_HXX */
@@ -29,7 +29,14 @@
 #include <simgear/math/SGMath.hxx>
 #include <simgear/debug/logstream.hxx>
 
-#include <terragear/tg_array.hxx>
+#include <map>
+
+#include <boost/shared_ptr.hpp>
+
+#include <simgear/threads/SGThread.hxx>
+#include <simgear/threads/SGGuard.hxx>
+
+#include <terragear/tg_array_cache.hxx>
 
 #include "TNT/jama_qr.h"
 #include "tg_surface.hxx"
@@ -41,6 +48,59 @@ const double coarse_grid = 300.0;
 // this many meters of the average
 const double max_clamp = 100.0;
 
+// the fit function is:
+// f(x,y) = A1*x + A2*x*y + A3*y +
+//          A4*x*x + A5+x*x*y + A6*x*x*y*y + A7*y*y + A8*x*y*y +
+//          A9*x*x*x + A10*x*x*x*y + A11*x*x*x*y*y + A12*x*x*x*y*y*y +
+//            A13*y*y*y + A14*x*y*y*y + A15*x*x*y*y*y
+//
+// every x^i * y^j with i, j <= 3.  These are the exponents of each term,
+// in coefficient order.
+static const int term_x[16] = { 0, 1, 1, 0, 2, 2, 2, 0, 1, 3, 3, 3, 3, 0, 1, 2 };
+static const int term_y[16] = { 0, 0, 1, 1, 0, 1, 2, 2, 2, 0, 1, 2, 3, 3, 3, 3 };
+
+// The grid always spans the surface extents, and is centered on the
+// area center.  In coordinates scaled to [-1,1] the design matrix only
+// depends on the grid dimensions, so its QR factors are computed once
+// for each grid size, and shared.  Most airports use the minimum 9x9.
+typedef boost::shared_ptr<const JAMA::QR<double> > tgSurfaceQRPtr;
+
+static std::map<std::pair<int, int>, tgSurfaceQRPtr> qr_cache;
+static SGMutex                                       qr_cache_lock;
+
+static tgSurfaceQRPtr getFactorization( int cols, int rows )
+{
+    SGGuard<SGMutex> g( qr_cache_lock );
+
+    tgSurfaceQRPtr& qr = qr_cache[std::make_pair( cols, rows )];
+    if ( !qr ) {
+        int nobs = cols * rows;
+
+        // Create an array (matrix) with 16 columns (predictor values) A[n]
+        TNT::Array2D<double> mat(nobs,16);
+
+        for ( int j = 0; j < rows; j++ ) {
+            double v = ( rows > 1 ) ? -1.0 + 2.0 * j / (double)( rows - 1 ) : 0.0;
+
+            for ( int i = 0; i < cols; i++ ) {
+                double u = ( cols > 1 ) ? -1.0 + 2.0 * i / (double)( cols - 1 ) : 0.0;
+                double up[4] = { 1.0, u, u*u, u*u*u };
+                double vp[4] = { 1.0, v, v*v, v*v*v };
+                int    index = ( j * cols ) + i;
+
+                for ( int t = 0; t < 16; t++ ) {
+                    mat[index][t] = up[term_x[t]] * vp[term_y[t]];
+                }
+            }
+        }
+
+        SG_LOG(SG_GENERAL, SG_DEBUG, "QR triangularisation of " << cols << "x" << rows << " grid" );
+        qr.reset( new JAMA::QR<double>( mat ) );
+    }
+
+    return qr;
+}
+
 static bool limit_slope( tgMatrix* Pts, int i1, int j1, int i2, int j2,
                          double average_elev_m, double slope_max, double slope_eps )
 {
@@ -94,7 +154,6 @@ static void tgCalcElevations( const std::string &root, const string_list elev_sr
 {
     bool done = false;
     int i, j;
-    tgArray array;
 
     // just bail if no work to do
     if ( Pts.rows() == 0 || Pts.cols() == 0 ) {
@@ -126,28 +185,10 @@ static void tgCalcElevations( const std::string &root, const string_list elev_sr
 
         if ( found_one ) {
             SGBucket b( first );
-            std::string base = b.gen_base_path();
 
-            // try the various elevation sources
-            j = 0;
-            bool found_file = false;
-            while ( !found_file && j < (int)elev_src.size() ) {
-                std::string array_path = root + "/" + elev_src[j] + "/" + base + "/" + b.gen_index_str();
-
-                if ( array.open(array_path) ) {
-                    found_file = true;
-                    SG_LOG( SG_GENERAL, SG_INFO, "Using array_path = " << array_path );
-                }
-                j++;
-            }
-
-            // this will fill in a zero structure if no array data
-            // found/opened
-            array.parse( b );
-
-            // this will do a hasty job of removing voids by inserting
-            // data from the nearest neighbor (sort of)
-            array.remove_voids();
+            // try the various elevation sources.  The cache returns a
+            // parsed, void filled array - or zero'd data if none was found
+            tgArrayPtr array = tgArrayCache::instance().get( root, elev_src, b );
 
             // update all the non-updated elevations that are inside
             // this array file
@@ -158,8 +199,8 @@ static void tgCalcElevations( const std::string &root, const string_list elev_sr
                     SGGeod p = Pts.element(i,j);
                     if ( p.getElevationM() < -9000.0 ) {
                         done = false;
-                        elev = array.altitude_from_grid( p.getLongitudeDeg() * 3600.0,
-                                                         p.getLatitudeDeg() * 3600.0 );
+                        elev = array->altitude_from_grid( p.getLongitudeDeg() * 3600.0,
+                                                          p.getLatitudeDeg() * 3600.0 );
                         if ( elev > -9000 ) {
                             p.setElevationM( elev );
                             Pts.set(i, j, p);
@@ -168,8 +209,6 @@ static void tgCalcElevations( const std::string &root, const string_list elev_sr
                 }
             }
 
-            array.close();
-
         } else {
             done = true;
         }
@@ -347,6 +386,12 @@ void tgSurface::Create( const std::string& path,
 
 tgSurface::tgSurface() {
     Pts = NULL;
+
+    for ( int i = 0; i < 4; i++ ) {
+        for ( int j = 0; j < 4; j++ ) {
+            poly[i][j] = 0.0;
+        }
+    }
 }
 
 tgSurface::~tgSurface() {
@@ -357,59 +402,37 @@ tgSurface::~tgSurface() {
 // Use a linear least squares method to fit a 3d polynomial to the
 // sampled surface data
 void tgSurface::fit() {
+    int cols = Pts->cols();
+    int rows = Pts->rows();
+    int nobs = cols * rows;	// number of observations
 
-    // the fit function is:
-    // f(x,y) = A1*x + A2*x*y + A3*y +
-    //          A4*x*x + A5+x*x*y + A6*x*x*y*y + A7*y*y + A8*x*y*y +
-    //          A9*x*x*x + A10*x*x*x*y + A11*x*x*x*y*y + A12*x*x*x*y*y*y +
-    //            A13*y*y*y + A14*x*y*y*y + A15*x*x*y*y*y
-
-    int nobs = Pts->cols() * Pts->rows();	// number of observations
+    // the grid is regular, and spans the extents - u, v in [-1,1] is
+    // x, y scaled by the half extents
+    double sx = ( _max_deg.getLongitudeDeg() - _min_deg.getLongitudeDeg() ) * 0.5;
+    double sy = ( _max_deg.getLatitudeDeg()  - _min_deg.getLatitudeDeg()  ) * 0.5;
+    if ( sx <= 0.0 ) { sx = 1.0; }
+    if ( sy <= 0.0 ) { sy = 1.0; }
 
-    SG_LOG(SG_GENERAL, SG_DEBUG, "QR triangularisation" );
+    tgSurfaceQRPtr qr = getFactorization( cols, rows );
 
-    // Create an array (matrix) with 16 columns (predictor values) A[n]
-    TNT::Array2D<double> mat(nobs,16);
-
-    // put all elevation values into a second array
+    // put all elevation values into an array
     TNT::Array1D<double> zmat(nobs);
-
-    // generate the required fit data
-    for ( int j = 0; j < Pts->rows(); j++ ) {
-        for ( int i = 0; i < Pts->cols(); i++ ) {
-            SGGeod p = Pts->element( i, j );
-            int index = ( j * Pts->cols() ) + i;
-            double x = p.getLongitudeDeg() - area_center.getLongitudeDeg();
-            double y = p.getLatitudeDeg() - area_center.getLatitudeDeg();
-            double z = p.getElevationM() - area_center.getElevationM();
-
-            zmat[index] = z;
-
-            mat[index][0] = 1.0;
-            mat[index][1] = x;
-            mat[index][2] = x*y;
-            mat[index][3] = y;
-            mat[index][4] = x*x;
-            mat[index][5] = x*x*y;
-            mat[index][6] = x*x*y*y;
-            mat[index][7] = y*y;
-            mat[index][8] = x*y*y;
-            mat[index][9] = x*x*x;
-            mat[index][10] = x*x*x*y;
-            mat[index][11] = x*x*x*y*y;
-            mat[index][12] = x*x*x*y*y*y;
-            mat[index][13] = y*y*y;
-            mat[index][14] = x*y*y*y;
-            mat[index][15] = x*x*y*y*y;
-        }
+    const SGGeod* p = Pts->data();
+    for ( int index = 0; index < nobs; index++ ) {
+        zmat[index] = p[index].getElevationM() - area_center.getElevationM();
     }
 
-    // Do QR decompostion
-    JAMA::QR<double> qr( mat );
     // find the least squares solution using the QR factors
-    surface_coefficients = qr.solve(zmat);
-    
-    SG_LOG(SG_GENERAL, SG_INFO, "tgSurface::fit - got " << surface_coefficients.dim() << " coefficients");
+    TNT::Array1D<double> coeff = qr->solve(zmat);
+
+    // and scale back to x, y in degrees from the center
+    double sxp[4] = { 1.0, 1.0/sx, 1.0/(sx*sx), 1.0/(sx*sx*sx) };
+    double syp[4] = { 1.0, 1.0/sy, 1.0/(sy*sy), 1.0/(sy*sy*sy) };
+    for ( int t = 0; t < 16; t++ ) {
+        poly[term_x[t]][term_y[t]] = ( coeff.dim() == 16 ) ? coeff[t] * sxp[term_x[t]] * syp[term_y[t]] : 0.0;
+    }
+
+    SG_LOG(SG_GENERAL, SG_INFO, "tgSurface::fit - got " << coeff.dim() << " coefficients");
 }
 
 
@@ -423,45 +446,72 @@ double tgSurface::query( SGGeod query ) const {
         return -9999.0;
     }
 
-    // compute the function with solved coefficients
-
-    // the fit function is:
-    // f(x,y) = A1*x + A2*x*y + A3*y +
-    //          A4*x*x + A5+x*x*y + A6*x*x*y*y + A7*y*y + A8*x*y*y +
-    //          A9*x*x*x + A10*x*x*x*y + A11*x*x*x*y*y + A12*x*x*x*y*y*y +
-    //            A13*y*y*y + A14*x*y*y*y + A15*x*x*y*y*y
-
-    double x = query.getLongitudeDeg() - area_center.getLongitudeDeg();
-    double y = query.getLatitudeDeg() - area_center.getLatitudeDeg();
-    
-    TNT::Array1D<double> A = surface_coefficients;
-
-    double result = A[0] + 
-                    A[1]*x + 
-                    A[2]*x*y + 
-                    A[3]*y + 
-                    A[4]*x*x + 
-                    A[5]*x*x*y + 
-                    A[6]*x*x*y*y + 
-                    A[7]*y*y + 
-                    A[8]*x*y*y + 
-                    A[9]*x*x*x + 
-                    A[10]*x*x*x*y +
-                    A[11]*x*x*x*y*y + 
-                    A[12]*x*x*x*y*y*y + 
-                    A[13]*y*y*y + 
-                    A[14]*x*y*y*y +
-                    A[15]*x*x*y*y*y;
-                    
-    result += area_center.getElevationM();
-
-    return result;
+    double lon = query.getLongitudeDeg();
+    double lat = query.getLatitudeDeg();
+    double elev;
+
+    this->query( &lon, &lat, &elev, 1 );
+
+    return elev;
+}
+
+void tgSurface::query( const double* lon_deg, const double* lat_deg, double* elev_m, unsigned int n ) const
+{
+    const double min_lon = _aptBounds.getMin().getLongitudeDeg();
+    const double min_lat = _aptBounds.getMin().getLatitudeDeg();
+    const double max_lon = _aptBounds.getMax().getLongitudeDeg();
+    const double max_lat = _aptBounds.getMax().getLatitudeDeg();
+    const double cx = area_center.getLongitudeDeg();
+    const double cy = area_center.getLatitudeDeg();
+    const double cz = area_center.getElevationM();
+
+    const double (*c)[4] = poly;
+    unsigned int outside = 0;
+
+    // no calls or early exits, so the loop can be vectorized
+    for ( unsigned int k = 0; k < n; k++ ) {
+        double x = lon_deg[k] - cx;
+        double y = lat_deg[k] - cy;
+
+        // Horner's rule in y for each power of x, then in x
+        double r0 = c[0][0] + y*( c[0][1] + y*( c[0][2] + y*c[0][3] ) );
+        double r1 = c[1][0] + y*( c[1][1] + y*( c[1][2] + y*c[1][3] ) );
+        double r2 = c[2][0] + y*( c[2][1] + y*( c[2][2] + y*c[2][3] ) );
+        double r3 = c[3][0] + y*( c[3][1] + y*( c[3][2] + y*c[3][3] ) );
+        double z  = r0 + x*( r1 + x*( r2 + x*r3 ) ) + cz;
+
+        bool inside = ( lon_deg[k] >= min_lon ) & ( lon_deg[k] <= max_lon ) &
+                      ( lat_deg[k] >= min_lat ) & ( lat_deg[k] <= max_lat );
+
+        elev_m[k] = inside ? z : -9999.0;
+        outside  += inside ? 0 : 1;
+    }
+
+    if ( outside ) {
+        SG_LOG(SG_GENERAL, SG_WARN, "Warning: " << outside << " queries out of bounds for fitted surface!");
+    }
+}
+
+void tgSurface::query( const std::vector<SGGeod>& points, std::vector<double>& elev_m ) const
+{
+    unsigned int n = points.size();
+
+    std::vector<double> lon( n ), lat( n );
+    for ( unsigned int k = 0; k < n; k++ ) {
+        lon[k] = points[k].getLongitudeDeg();
+        lat[k] = points[k].getLatitudeDeg();
+    }
+
+    elev_m.resize( n );
+    if ( n ) {
+        query( &lon[0], &lat[0], &elev_m[0], n );
+    }
 }
 
 void tgSurface::getCoefficients( std::vector<double>& coeff ) const
 {
     coeff.clear();
-    for ( unsigned int i=0; i<surface_coefficients.dim() ; i++ ) {
-        coeff.push_back( surface_coefficients[i] );
+    for ( unsigned int t=0; t<16; t++ ) {
+        coeff.push_back( poly[term_x[t]][term_y[t]] );
     }
-}
\ No newline at end of file
+}
@@ -25,63 +25,67 @@
 #define _SURFACE_HXX
 
 #include <string>
+#include <vector>
 #include <simgear/debug/logstream.hxx>
 
 #include "TNT/tnt_array2d.h"
 #include "tg_rectangle.hxx"
 #include "tg_polygon.hxx"
 
+// set to 1 to crash on out of range element access
+#define TG_MATRIX_CHECK_BOUNDS  (0)
+
 /***
- * A dirt simple matrix class for our convenience based on top of SGGeod
+ * A dirt simple matrix class for our convenience based on top of SGGeod.
+ * Elements are stored row by row in one contiguous block.
  */
 class tgMatrix {
 
-typedef std::vector<SGGeod>  GeodRow;
-typedef std::vector<GeodRow> GeodMatrix;
-
 public:
     inline tgMatrix( unsigned int columns, unsigned int rows ) {
         _cols = columns;
         _rows = rows;
 
-        m.resize( rows );
-        for (unsigned int i=0; i<rows; i++ ) {
-            m[i].resize( columns );
-        }
+        m.resize( (size_t)rows * columns );
     }
 
     inline SGGeod const& element( unsigned int col, unsigned int row ) const {
-        //int index = ( row * _cols ) + col;
-        if ( col < 0 || col >= _cols ) {
-            SG_LOG(SG_GENERAL, SG_WARN, "column out of bounds on read (" << col << " >= " << _cols << ")");
-            int *p = 0; *p = 1; // force crash
-        } else if ( row < 0 || row >= _rows ) {
-            SG_LOG(SG_GENERAL, SG_WARN, "row out of bounds on read (" << row << " >= " << _rows << ")");
-            int *p = 0; *p = 1; // force crash
+        if ( TG_MATRIX_CHECK_BOUNDS ) {
+            checkBounds( col, row, "read" );
         }
 
-        return m[row][col];
+        return m[row * _cols + col];
     }
 
     inline void set( unsigned int col, unsigned int row, const SGGeod& p ) {
-        //int index = ( row * _cols ) + col;
-        if ( col < 0 || col >= _cols ) {
-            SG_LOG(SG_GENERAL, SG_WARN,"column out of bounds on set (" << col << " >= " << _cols << ")");
-            int *p = 0; *p = 1; // force crash
-        } else if ( row < 0 || row >= _rows ) {
-            SG_LOG(SG_GENERAL, SG_WARN,"row out of bounds on set (" << row << " >= " << _rows << ")");
-            int *p = 0; *p = 1; // force crash
+        if ( TG_MATRIX_CHECK_BOUNDS ) {
+            checkBounds( col, row, "set" );
         }
-        m[row][col] = p;
+
+        m[row * _cols + col] = p;
     }
 
     inline int cols() const { return _cols; }
     inline int rows() const { return _rows; }
 
+    // the elements, row by row
+    inline SGGeod* data() { return m.empty() ? NULL : &m[0]; }
+    inline SGGeod const* data() const { return m.empty() ? NULL : &m[0]; }
+
 private:
+    void checkBounds( unsigned int col, unsigned int row, const char* op ) const {
+        if ( col >= _cols ) {
+            SG_LOG(SG_GENERAL, SG_WARN, "column out of bounds on " << op << " (" << col << " >= " << _cols << ")");
+            int *p = 0; *p = 1; // force crash
+        } else if ( row >= _rows ) {
+            SG_LOG(SG_GENERAL, SG_WARN, "row out of bounds on " << op << " (" << row << " >= " << _rows << ")");
+            int *p = 0; *p = 1; // force crash
+        }
+    }
+
     unsigned int _rows;
     unsigned int _cols;
-    GeodMatrix m;
+    std::vector<SGGeod> m;
 };
 
 /***
@@ -114,7 +118,8 @@ public:
     );
     
     // Use a linear least squares method to fit a 3d polynomial to the
-    // sampled surface data
+    // sampled surface data.  The factorization only depends on the grid
+    // dimensions, and is shared by every surface with the same grid.
     void fit();
 
     // Query the elevation of a point, return -9999 if out of range.
@@ -122,6 +127,11 @@ public:
     // proportional to u,v space on the nurbs surface which it isn't.
     double query( SGGeod query ) const;
 
+    // Query the elevations of n points at once.  Points out of range
+    // get -9999.
+    void query( const double* lon_deg, const double* lat_deg, double* elev_m, unsigned int n ) const;
+    void query( const std::vector<SGGeod>& points, std::vector<double>& elev_m ) const;
+
     void getCoefficients( std::vector<double>& coeff ) const;
     void getExtents( SGGeod& surfaceMin, SGGeod& surfaceMax, SGGeod& surfaceCenter ) const {
         surfaceMin = _min_deg;
@@ -132,7 +142,9 @@ public:
 private:
     // The actual nurbs surface approximation for the airport
     tgMatrix* Pts;
-    TNT::Array1D<double> surface_coefficients;
+
+    // poly[i][j] is the coefficient of x^i * y^j
+    double poly[4][4];
 
     tgRectangle _aptBounds;
     SGGeod _min_deg, _max_deg;
@@ -0,0 +1,204 @@
+#include <simgear/debug/logstream.hxx>
+
+#include "tg_shapefile.hxx"
+#include "tg_intersection_debug.hxx"
+
+tgIntersectionNullSink* tgIntersectionNullSink::Get( void )
+{
+    static tgIntersectionNullSink nullSink;
+
+    return &nullSink;
+}
+
+tgIntersectionOgrSink::tgIntersectionOgrSink( const std::string& ds ) : tgIntersectionDebugSink(true), datasource(ds), dsid(NULL)
+{
+}
+
+tgIntersectionOgrSink::~tgIntersectionOgrSink()
+{
+    Complete( true );
+}
+
+void* tgIntersectionOgrSink::GetLayer( const char* layer, int type )
+{
+    // the datasource ( and it's directory ) is only created once there is
+    // something to write
+    if ( !dsid ) {
+        dsid = tgShapefile::OpenDatasource( datasource.c_str() );
+        if ( !dsid ) {
+            return NULL;
+        }
+    }
+
+    std::map<std::string, void*>::iterator it = layers.find( layer );
+    if ( it != layers.end() ) {
+        return it->second;
+    }
+
+    void* lid = tgShapefile::OpenLayer( dsid, layer, (tgShapefile::shapefile_layer_t)type );
+    layers[layer] = lid;
+
+    return lid;
+}
+
+void tgIntersectionOgrSink::AddPoint( const char* layer, const SGGeod& pt, const std::string& description )
+{
+    void* lid = GetLayer( layer, tgShapefile::LT_POINT );
+    if ( lid ) {
+        tgShapefile::FromGeod( lid, pt, description );
+    }
+}
+
+void tgIntersectionOgrSink::AddSegment( const char* layer, const tgSegment& seg, const std::string& description )
+{
+    void* lid = GetLayer( layer, tgShapefile::LT_LINE );
+    if ( lid ) {
+        tgShapefile::FromSegment( lid, seg, true, description );
+    }
+}
+
+void tgIntersectionOgrSink::AddConstraint( const char* layer, const tgConstraint& cons )
+{
+    void* lid = GetLayer( layer, tgShapefile::LT_LINE );
+    if ( lid ) {
+        cons.toShapefile( lid );
+    }
+}
+
+void tgIntersectionOgrSink::Complete( bool ok )
+{
+    if ( dsid ) {
+        tgShapefile::CloseDatasource( dsid );
+        dsid = NULL;
+    }
+    layers.clear();
+}
+
+// A feature waiting in the ring, replayed into an OGR sink on failure
+class tgIntersectionRingSink::Record
+{
+public:
+    Record( const char* l ) : layer(l) {}
+    virtual ~Record() {}
+
+    virtual void Replay( tgIntersectionDebugSink& sink ) const = 0;
+
+protected:
+    std::string layer;
+};
+
+namespace {
+
+class PointRecord : public tgIntersectionRingSink::Record
+{
+public:
+    PointRecord( const char* l, const SGGeod& p, const std::string& d ) : Record(l), pt(p), description(d) {}
+
+    virtual void Replay( tgIntersectionDebugSink& sink ) const {
+        sink.AddPoint( layer.c_str(), pt, description );
+    }
+
+private:
+    SGGeod      pt;
+    std::string description;
+};
+
+class SegmentRecord : public tgIntersectionRingSink::Record
+{
+public:
+    SegmentRecord( const char* l, const tgSegment& s, const std::string& d ) : Record(l), seg(s), description(d) {}
+
+    virtual void Replay( tgIntersectionDebugSink& sink ) const {
+        sink.AddSegment( layer.c_str(), seg, description );
+    }
+
+private:
+    tgSegment   seg;
+    std::string description;
+};
+
+class ConstraintRecord : public tgIntersectionRingSink::Record
+{
+public:
+    ConstraintRecord( const char* l, const tgConstraint& c ) : Record(l), cons(c) {}
+
+    virtual void Replay( tgIntersectionDebugSink& sink ) const {
+        sink.AddConstraint( layer.c_str(), cons );
+    }
+
+private:
+    tgConstraint cons;
+};
+
+}
+
+tgIntersectionRingSink::tgIntersectionRingSink( const std::string& ds, unsigned int cap ) :
+    tgIntersectionDebugSink(true), datasource(ds), capacity(cap ? cap : 1), next(0), dropped(0)
+{
+}
+
+// a run that never got to Complete didn't succeed
+tgIntersectionRingSink::~tgIntersectionRingSink()
+{
+    if ( !ring.empty() ) {
+        Complete( false );
+    }
+}
+
+void tgIntersectionRingSink::Push( Record* r )
+{
+    if ( ring.size() < capacity ) {
+        ring.push_back( r );
+    } else {
+        // overwrite the oldest record
+        delete ring[next];
+        ring[next] = r;
+        dropped++;
+    }
+
+    next = ( next + 1 ) % capacity;
+}
+
+void tgIntersectionRingSink::Clear( void )
+{
+    for ( unsigned int i=0; i<ring.size(); i++ ) {
+        delete ring[i];
+    }
+    ring.clear();
+    next    = 0;
+    dropped = 0;
+}
+
+void tgIntersectionRingSink::AddPoint( const char* layer, const SGGeod& pt, const std::string& description )
+{
+    Push( new PointRecord( layer, pt, description ) );
+}
+
+void tgIntersectionRingSink::AddSegment( const char* layer, const tgSegment& seg, const std::string& description )
+{
+    Push( new SegmentRecord( layer, seg, description ) );
+}
+
+void tgIntersectionRingSink::AddConstraint( const char* layer, const tgConstraint& cons )
+{
+    Push( new ConstraintRecord( layer, cons ) );
+}
+
+void tgIntersectionRingSink::Complete( bool ok )
+{
+    if ( !ok && !ring.empty() ) {
+        SG_LOG( SG_GENERAL, SG_ALERT, "tgIntersectionRingSink : run failed - writing the last " << ring.size() << " features to " << datasource <<
+                                      " ( " << dropped << " older features were dropped )" );
+
+        // once the ring is full, next is the oldest record
+        tgIntersectionOgrSink ogr( datasource );
+        unsigned int          start = ( ring.size() < capacity ) ? 0 : next;
+
+        for ( unsigned int i=0; i<ring.size(); i++ ) {
+            ring[( start + i ) % ring.size()]->Replay( ogr );
+        }
+        ogr.Complete( ok );
+    }
+
+    Clear();
+}
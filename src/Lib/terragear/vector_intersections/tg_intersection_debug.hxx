@@ -0,0 +1,110 @@
+#ifndef __TG_INTERSECTION_DEBUG_HXX__
+#define __TG_INTERSECTION_DEBUG_HXX__
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <simgear/math/SGMath.hxx>
+
+#include <terragear/tg_cgal.hxx>
+
+#include "tg_constraint.hxx"
+
+// Where tgIntersectionGenerator, and its segment network, send their
+// diagnostic features.
+//
+// The generator used to write the skeleton, constraints and start vertex of
+// every edge to shapefiles in its debug database on every run.  Now it
+// writes to a sink, which is one of
+//  - tgIntersectionNullSink  : drops everything.  This is the default.
+//  - tgIntersectionOgrSink   : writes each feature to a layer of the debug
+//                              datasource, like before.
+//  - tgIntersectionRingSink  : keeps the last features in memory, and only
+//                              writes them out if the run fails.
+//
+// Callers check Enabled() before building a feature, so the cost of a
+// disabled sink is a branch.
+class tgIntersectionDebugSink
+{
+public:
+    virtual ~tgIntersectionDebugSink() {}
+
+    bool Enabled( void ) const { return enabled; }
+
+    virtual void AddPoint( const char* layer, const SGGeod& pt, const std::string& description ) = 0;
+    virtual void AddSegment( const char* layer, const tgSegment& seg, const std::string& description ) = 0;
+    virtual void AddConstraint( const char* layer, const tgConstraint& cons ) = 0;
+
+    // called at the end of each run - ok is false if any edge failed
+    virtual void Complete( bool ok ) = 0;
+
+protected:
+    tgIntersectionDebugSink( bool e ) : enabled(e) {}
+
+private:
+    bool enabled;
+};
+
+class tgIntersectionNullSink : public tgIntersectionDebugSink
+{
+public:
+    tgIntersectionNullSink() : tgIntersectionDebugSink(false) {}
+
+    virtual void AddPoint( const char* layer, const SGGeod& pt, const std::string& description ) {}
+    virtual void AddSegment( const char* layer, const tgSegment& seg, const std::string& description ) {}
+    virtual void AddConstraint( const char* layer, const tgConstraint& cons ) {}
+    virtual void Complete( bool ok ) {}
+
+    // shared default for generators and networks without a sink
+    static tgIntersectionNullSink* Get( void );
+};
+
+class tgIntersectionOgrSink : public tgIntersectionDebugSink
+{
+public:
+    tgIntersectionOgrSink( const std::string& ds );
+    virtual ~tgIntersectionOgrSink();
+
+    virtual void AddPoint( const char* layer, const SGGeod& pt, const std::string& description );
+    virtual void AddSegment( const char* layer, const tgSegment& seg, const std::string& description );
+    virtual void AddConstraint( const char* layer, const tgConstraint& cons );
+
+    // closes the datasource - the next feature opens it again
+    virtual void Complete( bool ok );
+
+private:
+    void* GetLayer( const char* layer, int type );
+
+    std::string                     datasource;
+    void*                           dsid;
+    std::map<std::string, void*>    layers;
+};
+
+class tgIntersectionRingSink : public tgIntersectionDebugSink
+{
+public:
+    class Record;
+
+    // keeps the last cap features, and writes them to ds on failure - or
+    // when destroyed with features left, as the run never completed
+    tgIntersectionRingSink( const std::string& ds, unsigned int cap );
+    virtual ~tgIntersectionRingSink();
+
+    virtual void AddPoint( const char* layer, const SGGeod& pt, const std::string& description );
+    virtual void AddSegment( const char* layer, const tgSegment& seg, const std::string& description );
+    virtual void AddConstraint( const char* layer, const tgConstraint& cons );
+    virtual void Complete( bool ok );
+
+private:
+    void Push( Record* r );
+    void Clear( void );
+
+    std::string             datasource;
+    std::vector<Record*>    ring;
+    unsigned int            capacity;
+    unsigned int            next;
+    unsigned long           dropped;
+};
+
+#endif /* __TG_INTERSECTION_DEBUG_HXX__ */
@@ -1,3 +1,5 @@
+#include <atomic>
+
 #include <simgear/sg_inlines.h>
 #include <simgear/timing/timestamp.hxx>
 
@@ -9,7 +11,8 @@
 
 tgIntersectionEdge::tgIntersectionEdge( tgIntersectionNode* s, tgIntersectionNode* e, double w, int z, unsigned int t, const std::string& db ) : constraints()
 {
-    static unsigned int ge_count = 0;
+    // edges are created on every vector-decode thread
+    static std::atomic<unsigned int> ge_count( 0 );
 
     start  = s;
     end    = e;
@@ -681,41 +684,30 @@ void tgIntersectionEdge::Generate( void )
     
     if( valid ) {
         poly = cgalPoly_Polygon( nodes.begin(), nodes.end() );
+    } else {
+        flags |= FLAGS_GENERATE_FAILED;
     }
 }
 
-void tgIntersectionEdge::DumpArrangement( OGRLayer* skeleton_lid, OGRLayer* constraints_lid, OGRLayer* startv_lid, OGRLayer* poly_lid )
+void tgIntersectionEdge::DumpArrangement( tgIntersectionDebugSink& sink )
 {
     char description[256];
 
     // dump the line
-    if ( skeleton_lid ) {
-        sprintf( description, "%06ld_skeleton", id );
-        tgShapefile::FromSegment( skeleton_lid, tgSegment(start->GetPosition(), end->GetPosition()), true, description );
-    }
+    sprintf( description, "%06ld_skeleton", id );
+    sink.AddSegment( "skeleton", tgSegment(start->GetPosition(), end->GetPosition()), description );
     
     // dump start vertex
-    if ( startv_lid ) {
-        sprintf( description, "%06ld_start_v", id );
-        SGGeod gStart = SGGeod::fromDeg( CGAL::to_double(vStart.x()), CGAL::to_double(vStart.y()) );
-        tgShapefile::FromGeod( startv_lid, gStart, description );    
-    }
+    sprintf( description, "%06ld_start_v", id );
+    SGGeod gStart = SGGeod::fromDeg( CGAL::to_double(vStart.x()), CGAL::to_double(vStart.y()) );
+    sink.AddPoint( "startv", gStart, description );
 
     // dump the constraints
-    if ( constraints_lid ) {
-        for ( unsigned int pos=0; pos<NUM_CONSTRAINTS; pos++ ) {
-            for ( unsigned int c=0; c<constraints[pos].size(); c++ ) {
-                constraints[pos][c].toShapefile( constraints_lid );
-            }
+    for ( unsigned int pos=0; pos<NUM_CONSTRAINTS; pos++ ) {
+        for ( unsigned int c=0; c<constraints[pos].size(); c++ ) {
+            sink.AddConstraint( "constraints", constraints[pos][c] );
         }
     }
-    
-    // dump the poly
-//    if ( poly_lid ) {
-//        sprintf( description, "%06ld_poly", id );
-//        poly.toShapefile( poly_lid, description );
-//    }
-
 }
 
 tgRay tgIntersectionEdgeInfo::GetDirectionRay(void) const
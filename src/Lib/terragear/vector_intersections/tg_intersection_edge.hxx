@@ -9,6 +9,7 @@
 #include <terragear/polygon_set/tg_polygon_set.hxx>
 
 #include "tg_constraint.hxx"
+#include "tg_intersection_debug.hxx"
 
 typedef int (*tgIntersectionGeneratorTexInfoCb)(unsigned int info, bool cap, std::string& material, double& atlas_startu, double& atlas_endu, double& atlas_startv, double& atlas_endv, double& v_dist);
 
@@ -83,6 +84,7 @@ typedef std::map<double, tgintersectionedgeinfo_vector>     tgintersectionedgein
 #define FLAGS_INTERSECT_CONSTRAINTS_COMPLETE       (0x00000003)
 
 #define FLAGS_TEXTURED                             (0x00000004)
+#define FLAGS_GENERATE_FAILED                      (0x00000008)
 
 
 
@@ -142,7 +144,7 @@ public:
     edgeArrPoint GetStart( bool originating ) const;
     
     void AddConstraint( ConstraintPos_e pos, tgConstraint cons );
-    void DumpArrangement( OGRLayer* skeleton_lid, OGRLayer* constraints_lid, OGRLayer* startv_lid, OGRLayer* poly_lid );
+    void DumpArrangement( tgIntersectionDebugSink& sink );
     
     tgIntersectionEdge* Split( bool originating, tgIntersectionNode* newNode );
     
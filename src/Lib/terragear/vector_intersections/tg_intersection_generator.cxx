@@ -34,7 +34,19 @@ void tgIntersectionGenerator::ToShapefile( const char* prefix )
 #endif    
 }
 
+// a run that throws still flushes ( or drops ) its diagnostics - the ring
+// sink keeps them for exactly this case
 void tgIntersectionGenerator::Execute( void )
+{
+    try {
+        Generate();
+    } catch ( ... ) {
+        debug->Complete( false );
+        throw;
+    }
+}
+
+void tgIntersectionGenerator::Generate( void )
 {
     if ( !segNet.empty() ) {
         // Segnet has all of the edges and nodes in an arrangement : clean it
@@ -92,16 +104,12 @@ void tgIntersectionGenerator::Execute( void )
             nodelist[i]->CompleteSpecialIntersections();
         }
 
-        // dump the edges
-        // Open the datasource, skeleton, and constraints layers
-        void* dsid             = tgShapefile::OpenDatasource( debugDatabase );
-        void* skeleton_lid     = tgShapefile::OpenLayer( dsid, "skeleton", tgShapefile::LT_LINE );
-        void* constraints_lid  = tgShapefile::OpenLayer( dsid, "constraints", tgShapefile::LT_LINE );
-        void* startv_lid       = tgShapefile::OpenLayer( dsid, "startv", tgShapefile::LT_POINT );
-        for (tgintersectionedge_it it = edgelist.begin(); it != edgelist.end(); it++) {
-            (*it)->DumpArrangement( (OGRLayer*)skeleton_lid, (OGRLayer*)constraints_lid, (OGRLayer*)startv_lid, NULL );
+        // dump the edges' skeleton, constraints and start vertex
+        if ( debug->Enabled() ) {
+            for (tgintersectionedge_it it = edgelist.begin(); it != edgelist.end(); it++) {
+                (*it)->DumpArrangement( *debug );
+            }
         }
-        tgShapefile::CloseDatasource( dsid );
         
         // Generate the edge from each node
         SG_LOG(SG_GENERAL, LOG_INTERSECTION, "tgIntersectionGenerator::Execute:GenerateEdges");
@@ -110,13 +118,6 @@ void tgIntersectionGenerator::Execute( void )
             nodelist[i]->GenerateEdges();
         }
 
-        dsid                   = tgShapefile::OpenDatasource( debugDatabase );
-        void* poly_lid         = tgShapefile::OpenLayer( dsid, "polys", tgShapefile::LT_POLY );
-        for (tgintersectionedge_it it = edgelist.begin(); it != edgelist.end(); it++) {
-            (*it)->DumpArrangement(NULL, NULL, NULL, (OGRLayer*)poly_lid );
-        }
-        tgShapefile::CloseDatasource( dsid );
-        
 #if 0        
         // Remove any edges that didn't get intersected
         // verifty all edges have been intersected
@@ -166,9 +167,18 @@ void tgIntersectionGenerator::Execute( void )
             }
         }
 
+        bool ok = true;
         for (tgintersectionedge_it it = edgelist.begin(); it != edgelist.end(); it++) {
-            (*it)->Verify( FLAGS_TEXTURED );
+            if ( !(*it)->Verify( FLAGS_TEXTURED ) ) {
+                ok = false;
+            }
+            if ( (*it)->flags & FLAGS_GENERATE_FAILED ) {
+                ok = false;
+            }
         }
+        
+        // flush ( or drop ) the diagnostics of this run
+        debug->Complete( ok );
 
 #if 0        
         if ( flags & IG_DEBUG_COMPLETE ) {
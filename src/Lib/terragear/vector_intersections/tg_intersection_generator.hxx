@@ -4,16 +4,29 @@
 #include "tg_intersection_node.hxx"
 #include "tg_intersection_edge.hxx"
 #include "tg_segmentnetwork.hxx"
+#include "tg_intersection_debug.hxx"
 
 // intersection generator and segment network flags
 #define IG_DEBUG_COMPLETE       (0x01)
 
 class tgIntersectionGenerator {
 public:
-    tgIntersectionGenerator(const char* dbg, unsigned int cln_f, unsigned int int_f, tgIntersectionGeneratorTexInfoCb cb) : segNet(cln_f, dbg), texInfoCb(cb), flags(int_f)  {
+    tgIntersectionGenerator(const char* dbg, unsigned int cln_f, unsigned int int_f, tgIntersectionGeneratorTexInfoCb cb) : segNet(cln_f, dbg), texInfoCb(cb), flags(int_f), debug(tgIntersectionNullSink::Get())  {
         strcpy(  debugDatabase, dbg );
     }
     
+    // where the diagnostic features of the next Execute go.  The sink is
+    // not owned, and defaults to the null sink.
+    void                                SetDebugSink( tgIntersectionDebugSink* sink ) {
+        debug = sink ? sink : tgIntersectionNullSink::Get();
+        segNet.SetDebugSink( debug );
+    }
+
+    // clean the segment network in cells - see tgSegmentNetwork::SetPartitions
+    void                                SetCleanPartitions( double cell_size, double overlap, unsigned int num_threads ) {
+        segNet.SetPartitions( cell_size, overlap, num_threads );
+    }
+
     void                                Insert( const SGGeod& s, const SGGeod& e, double w, int z, unsigned int t );
     void                                Execute( void );
     tgintersectionedge_it               edges_begin( void )  { return edgelist.begin(); }
@@ -21,6 +34,7 @@ public:
     int                                 edges_size( void )   { return edgelist.size(); }
     
 private:
+    void                                Generate( void );
     void                                ToShapefile( const char* prefix );
 
     tgSegmentNetwork                    segNet;
@@ -30,6 +44,7 @@ private:
     tgIntersectionGeneratorTexInfoCb    texInfoCb;
     char                                debugDatabase[256];
     unsigned int                        flags;    
+    tgIntersectionDebugSink*            debug;
 };
 
 #endif /* __TG_INTERSECTION_GENERATOR_HXX__ */
\ No newline at end of file
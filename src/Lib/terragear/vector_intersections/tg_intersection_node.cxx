@@ -1,3 +1,5 @@
+#include <atomic>
+
 #include <simgear/sg_inlines.h>
 
 #include "tg_polygon.hxx"
@@ -6,10 +8,12 @@
 #include "tg_intersection_edge.hxx"
 #include "tg_misc.hxx"
 
+// one id sequence for nodes made either way, shared by every vector-decode
+// thread
+static std::atomic<unsigned int> cur_id( 1 );
+
 tgIntersectionNode::tgIntersectionNode( const SGGeod& pos )
 {
-    static unsigned int cur_id = 1;
-    
     position = pos;
     position2 = edgeArrPoint( pos.getLongitudeDeg(), pos.getLatitudeDeg() );
     
@@ -21,8 +25,6 @@ tgIntersectionNode::tgIntersectionNode( const SGGeod& pos )
 
 tgIntersectionNode::tgIntersectionNode( const edgeArrPoint& pos )
 {
-    static unsigned int cur_id = 1;
-    
     position = SGGeod::fromDeg( CGAL::to_double( pos.x() ), CGAL::to_double( pos.y() ) );
     position2 = pos;
     
@@ -3,6 +3,10 @@
 
 #include <stack>
 
+#include <boost/unordered_map.hpp>
+
+#include <terragear/tg_unique_geod.hxx>
+
 #include "tg_intersection_edge.hxx"
 
 // forward declarations
@@ -72,90 +76,95 @@ private:
 };
 typedef std::vector<tgIntersectionNode*> tgintersectionnode_list;
 
+// The nodes of the intersection network.  Two locations are the same node
+// if SGGeod_isEqual2D says so, and the first node added wins.
+//
+// Looking up a location used to compare it with every node - Execute adds
+// both ends of every segment, so building the network was quadratic in the
+// number of nodes.  Now each node's position is registered twice :
+//  - by its exact lon / lat, so a location already seen ( the common case -
+//    segments share their endpoints ) is a single hash lookup.
+//  - in a tgSpatialHashSet with the isEqual2D epsilon, for locations within
+//    the epsilon of a node, but not on it.
+// The spatial hash hands out indices in insertion order, so they are the
+// indices into nodes.
 class tgIntersectionNodeList {
 public:
-    tgIntersectionNodeList() {
+    tgIntersectionNodeList() : grid( PROXIMITY_EPSILON ) {
         nodes.clear();
     }
-    
+
     tgIntersectionNode* Get( const SGGeod& loc ) {
-        tgIntersectionNode* node = NULL;
-        
-        for ( unsigned int i=0; i<nodes.size(); i++ ) {
-            if ( SGGeod_isEqual2D(nodes[i]->GetPosition(), loc) ) {
-                node = nodes[i];
-                break;
-            }
-        }
-        
-        if ( node == NULL ) {
-            node = new tgIntersectionNode( loc );
-            nodes.push_back( node );
-        }
-        
-        return node;
+        return Add( loc );
     }
 
     tgIntersectionNode* Add( const SGGeod& loc ) {
-        tgIntersectionNode* node = NULL;
-        
-        for ( unsigned int i=0; i<nodes.size(); i++ ) {
-            if ( SGGeod_isEqual2D(nodes[i]->GetPosition(), loc) ) {
-                node = nodes[i];
-                break;
-            }
-        }
-        
-        if ( node == NULL ) {
-            node = new tgIntersectionNode( loc );
-            nodes.push_back( node );
+        int index = Find( loc );
+
+        if ( index < 0 ) {
+            return Insert( new tgIntersectionNode( loc ) );
         }
-        
-        return node;
+
+        return nodes[index];
     }
 
     tgIntersectionNode* Add( const edgeArrPoint& loc ) {
-        tgIntersectionNode* node = NULL;
-        
-        SGGeod gPos = SGGeod::fromDeg( CGAL::to_double(loc.x()), CGAL::to_double(loc.y()) );
-        for ( unsigned int i=0; i<nodes.size(); i++ ) {
-            if ( SGGeod_isEqual2D(nodes[i]->GetPosition(), gPos) ) {
-                node = nodes[i];
-                break;
-            }
-        }
-        
-        if ( node == NULL ) {
-            node = new tgIntersectionNode( loc );
-            nodes.push_back( node );
+        SGGeod gPos  = SGGeod::fromDeg( CGAL::to_double(loc.x()), CGAL::to_double(loc.y()) );
+        int    index = Find( gPos );
+
+        if ( index < 0 ) {
+            return Insert( new tgIntersectionNode( loc ) );
         }
-        
-        return node;
+
+        return nodes[index];
     }
-    
+
     bool IsNode( const SGGeod& loc ) {
-        bool isnode = false;
-        
-        for ( unsigned int i=0; i<nodes.size(); i++ ) {
-            if ( SGGeod_isEqual2D(nodes[i]->GetPosition(), loc) ) {
-                isnode = true;
-                break;
-            }
-        }
-        
-        return isnode;
+        return ( Find( loc ) >= 0 );
     }
-    
+
     unsigned int size(void) const {
         return nodes.size();
     }
-        
+
     tgIntersectionNode* operator[]( int index ) {
         return nodes[index];
     }
-    
+
 private:
-    tgintersectionnode_list    nodes;    
+    typedef std::pair<double, double>                                                   exactKey;
+    typedef boost::unordered_map<exactKey, unsigned int, boost::hash<exactKey> >       exactMap;
+
+    static exactKey GetKey( const SGGeod& loc ) {
+        return exactKey( loc.getLongitudeDeg(), loc.getLatitudeDeg() );
+    }
+
+    int Find( const SGGeod& loc ) const {
+        // a node with exactly this position is the first match : a node
+        // is only added when no earlier node is within the epsilon of it
+        exactMap::const_iterator it = exact.find( GetKey( loc ) );
+        if ( it != exact.end() ) {
+            return it->second;
+        }
+
+        return grid.find( loc );
+    }
+
+    tgIntersectionNode* Insert( tgIntersectionNode* node ) {
+        SGGeod pos = node->GetPosition();
+
+        exact.insert( std::make_pair( GetKey( pos ), (unsigned int)nodes.size() ) );
+        grid.add( pos );
+        nodes.push_back( node );
+
+        return node;
+    }
+
+    tgintersectionnode_list    nodes;
+
+    // PROXIMITY_EPSILON is the isEqual2D epsilon
+    tgSpatialHashSet<SGGeod, SGGeodHashTraits>  grid;
+    exactMap                                    exact;
 };
 
 #endif /* __TG_INTERSECTION_NODE_HXX__ */
\ No newline at end of file
@@ -2,18 +2,25 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
 
 #include <CGAL/assertions.h>
 #include <CGAL/squared_distance_2.h>
 
 #include <simgear/math/SGMath.hxx>
 #include <simgear/debug/logstream.hxx>
+#include <simgear/threads/SGThread.hxx>
+#include <simgear/threads/SGGuard.hxx>
 
 #include "tg_segmentnetwork.hxx"
 #include "tg_cluster.hxx"
 #include "tg_shapefile.hxx"
 #include "tg_cgal.hxx"
 
+#include <terragear/tg_unique_geod.hxx>
+
 #define LOG_STAGES              SG_DEBUG
 #define LOG_CLUSTERS            SG_DEBUG
 #define LOG_FINGER_REMOVAL      SG_DEBUG
@@ -21,7 +28,8 @@
 #define LOG_SHORT_EDGES         SG_DEBUG
 #define LOG_FIX_SHORT_SEGMENT   SG_DEBUG
 
-tgSegmentNetwork::tgSegmentNetwork( unsigned int cf, const std::string debugRoot ) : invalid_vh()
+tgSegmentNetwork::tgSegmentNetwork( unsigned int cf, const std::string debugRoot ) : invalid_vh(), debug(tgIntersectionNullSink::Get()),
+    partition_size(0.0), partition_overlap(0.0), partition_threads(1)
 {
     clean_flags = cf;
 
@@ -41,7 +49,10 @@ void tgSegmentNetwork::Add( const SGGeod& source, const SGGeod& target, double w
 
     //std::cout << "Adding from " << source << " to " << target << std::endl;
     
-    if ( clean_flags ) {
+    if ( clean_flags && partition_size > 0.0 ) {
+        // the cells are built once all segments are known
+        input.push_back( segnetEdge( source, target, width, zorder, type ) );
+    } else if ( clean_flags ) {
         segnetPoint snSource( source.getLongitudeDeg(), source.getLatitudeDeg() );
         segnetPoint snTarget( target.getLongitudeDeg(), target.getLatitudeDeg() );
 
@@ -63,7 +74,9 @@ void tgSegmentNetwork::Execute( void )
 
     SG_LOG(SG_GENERAL, SG_INFO, "Done" );    
     
-    if ( clean_flags ) {
+    if ( clean_flags && partition_size > 0.0 ) {
+        ExecutePartitioned();
+    } else if ( clean_flags ) {
         // first, cluster the nodes
         SG_LOG(SG_GENERAL, SG_INFO, "tgSegmentNetwork::Cluster" );    
         Cluster();    
@@ -92,6 +105,273 @@ void tgSegmentNetwork::Execute( void )
     }
 }
 
+void tgSegmentNetwork::SetPartitions( double cell_size, double overlap, unsigned int num_threads )
+{
+    partition_size    = cell_size;
+    partition_overlap = overlap;
+    partition_threads = num_threads ? num_threads : 1;
+}
+
+// Partitioned cleaning
+//
+// The input is split into a grid of cells.  A cell is cleaned with every
+// segment whose bounding box comes within the overlap of it, plus every
+// segment within the overlap of those - so the far end of a long segment
+// through the cell is cleaned with its neighbours as well.
+//
+// Each cell keeps the cleaned edges whose midpoint lies in it, so every
+// edge is taken from exactly one cell.  As long as no cleaning step reaches
+// further than the overlap ( clustering and finger extension work within a
+// few meters ), an edge comes out of its cell the same as it would from
+// the whole network.
+//
+// The kept edges are then stitched in cell order : their ends go through a
+// UniqueSGGeodSet, so edges from different cells that meet at a node share
+// the same ( first seen ) position.
+namespace {
+
+class segnetCell
+{
+public:
+    segnetCell( int x, int y ) : ix(x), iy(y) {}
+
+    int                         ix, iy;
+    std::vector<unsigned int>   near;      // input within the overlap of the cell
+    std::vector<unsigned int>   segments;  // and within the overlap of those
+    segnetedge_list             output;
+};
+
+// The cells share the network's sink.  Sinks aren't thread safe, so the
+// cleaners write through this, one feature at a time.  A segment in the
+// overlap of several cells may be reported by each of them.  The network's
+// owner completes the run, so Complete isn't passed on.
+class segnetSharedSink : public tgIntersectionDebugSink
+{
+public:
+    segnetSharedSink( tgIntersectionDebugSink* s ) : tgIntersectionDebugSink( s->Enabled() ), sink(s) {}
+
+    virtual void AddPoint( const char* layer, const SGGeod& pt, const std::string& description ) {
+        SGGuard<SGMutex> g(lock);
+        sink->AddPoint( layer, pt, description );
+    }
+    virtual void AddSegment( const char* layer, const tgSegment& seg, const std::string& description ) {
+        SGGuard<SGMutex> g(lock);
+        sink->AddSegment( layer, seg, description );
+    }
+    virtual void AddConstraint( const char* layer, const tgConstraint& cons ) {
+        SGGuard<SGMutex> g(lock);
+        sink->AddConstraint( layer, cons );
+    }
+    virtual void Complete( bool ok ) {}
+
+private:
+    tgIntersectionDebugSink*    sink;
+    SGMutex                     lock;
+};
+
+typedef std::pair<int, int>                         segnetCellKey;     // row, column
+typedef std::map<segnetCellKey, segnetCell*>        segnetCellMap;
+
+class segnetGrid
+{
+public:
+    segnetGrid( double x, double y, double s ) : min_x(x), min_y(y), size(s) {}
+
+    int Column( double x ) const { return (int)std::floor( ( x - min_x ) / size ); }
+    int Row( double y ) const    { return (int)std::floor( ( y - min_y ) / size ); }
+
+    double min_x, min_y, size;
+};
+
+struct segnetBox
+{
+    segnetBox( const segnetEdge& e, double margin ) {
+        min_x = std::min( e.start.getLongitudeDeg(), e.end.getLongitudeDeg() ) - margin;
+        max_x = std::max( e.start.getLongitudeDeg(), e.end.getLongitudeDeg() ) + margin;
+        min_y = std::min( e.start.getLatitudeDeg(),  e.end.getLatitudeDeg() )  - margin;
+        max_y = std::max( e.start.getLatitudeDeg(),  e.end.getLatitudeDeg() )  + margin;
+    }
+
+    void expand( const segnetBox& o ) {
+        min_x = std::min( min_x, o.min_x );
+        max_x = std::max( max_x, o.max_x );
+        min_y = std::min( min_y, o.min_y );
+        max_y = std::max( max_y, o.max_y );
+    }
+
+    bool intersects( const segnetBox& o ) const {
+        return ( min_x <= o.max_x && o.min_x <= max_x && min_y <= o.max_y && o.min_y <= max_y );
+    }
+
+    double min_x, min_y, max_x, max_y;
+};
+
+// The cells to clean.  Threads take the next cell until none are left.
+class segnetCellQueue
+{
+public:
+    segnetCellQueue( const segnetCellMap& cells ) : next(0) {
+        for ( segnetCellMap::const_iterator it = cells.begin(); it != cells.end(); it++ ) {
+            queue.push_back( it->second );
+        }
+    }
+
+    segnetCell* pop( void ) {
+        SGGuard<SGMutex> g(lock);
+
+        if ( next >= queue.size() ) {
+            return NULL;
+        }
+        return queue[next++];
+    }
+
+private:
+    std::vector<segnetCell*>    queue;
+    unsigned int                next;
+    SGMutex                     lock;
+};
+
+class segnetCleaner : public SGThread
+{
+public:
+    segnetCleaner( segnetCellQueue& q, const segnetedge_list& in, const segnetGrid& g, unsigned int cf, tgIntersectionDebugSink* dbg ) :
+        queue(q), input(in), grid(g), clean_flags(cf), debug(dbg) {}
+
+private:
+    virtual void run() {
+        segnetCell* cell;
+
+        while ( ( cell = queue.pop() ) != NULL ) {
+            tgSegmentNetwork net( clean_flags, "" );
+            net.SetDebugSink( debug );
+
+            // add in input order, like the whole network would
+            for ( unsigned int i=0; i<cell->segments.size(); i++ ) {
+                const segnetEdge& e = input[cell->segments[i]];
+                net.Add( e.start, e.end, e.width, e.zorder, e.type );
+            }
+            net.Execute();
+
+            for ( segnetedge_it it = net.output_begin(); it != net.output_end(); it++ ) {
+                double mid_x = 0.5 * ( it->start.getLongitudeDeg() + it->end.getLongitudeDeg() );
+                double mid_y = 0.5 * ( it->start.getLatitudeDeg()  + it->end.getLatitudeDeg() );
+
+                if ( grid.Column( mid_x ) == cell->ix && grid.Row( mid_y ) == cell->iy ) {
+                    cell->output.push_back( *it );
+                }
+            }
+        }
+    }
+
+    segnetCellQueue&        queue;
+    const segnetedge_list&  input;
+    const segnetGrid&       grid;
+    unsigned int            clean_flags;
+    tgIntersectionDebugSink* debug;
+};
+
+}
+
+void tgSegmentNetwork::ExecutePartitioned( void )
+{
+    segnetCellMap   cells;
+
+    // grid origin at the lower left of the input
+    double min_x =  std::numeric_limits<double>::infinity();
+    double min_y =  std::numeric_limits<double>::infinity();
+    for ( unsigned int i=0; i<input.size(); i++ ) {
+        segnetBox box( input[i], 0.0 );
+        min_x = std::min( min_x, box.min_x );
+        min_y = std::min( min_y, box.min_y );
+    }
+    segnetGrid grid( min_x, min_y, partition_size );
+
+    // each segment is near the cells its bounding box, grown by the
+    // overlap, touches
+    for ( unsigned int i=0; i<input.size(); i++ ) {
+        segnetBox box( input[i], partition_overlap );
+
+        for ( int r = grid.Row( box.min_y ); r <= grid.Row( box.max_y ); r++ ) {
+            for ( int c = grid.Column( box.min_x ); c <= grid.Column( box.max_x ); c++ ) {
+                segnetCell*& cell = cells[segnetCellKey( r, c )];
+                if ( !cell ) {
+                    cell = new segnetCell( c, r );
+                }
+                cell->near.push_back( i );
+            }
+        }
+    }
+
+    // then add the segments near the cell's segments
+    for ( segnetCellMap::iterator it = cells.begin(); it != cells.end(); it++ ) {
+        segnetCell* cell = it->second;
+        segnetBox   reach( input[cell->near[0]], partition_overlap );
+
+        for ( unsigned int i=1; i<cell->near.size(); i++ ) {
+            reach.expand( segnetBox( input[cell->near[i]], partition_overlap ) );
+        }
+
+        // anything touching reach is near one of the cells reach covers
+        for ( int r = grid.Row( reach.min_y ); r <= grid.Row( reach.max_y ); r++ ) {
+            for ( int c = grid.Column( reach.min_x ); c <= grid.Column( reach.max_x ); c++ ) {
+                segnetCellMap::const_iterator other = cells.find( segnetCellKey( r, c ) );
+                if ( other == cells.end() ) {
+                    continue;
+                }
+
+                for ( unsigned int i=0; i<other->second->near.size(); i++ ) {
+                    unsigned int idx = other->second->near[i];
+                    if ( reach.intersects( segnetBox( input[idx], 0.0 ) ) ) {
+                        cell->segments.push_back( idx );
+                    }
+                }
+            }
+        }
+
+        std::sort( cell->segments.begin(), cell->segments.end() );
+        cell->segments.erase( std::unique( cell->segments.begin(), cell->segments.end() ), cell->segments.end() );
+    }
+
+    unsigned int num_threads = std::min( partition_threads, (unsigned int)cells.size() );
+
+    SG_LOG(SG_GENERAL, SG_INFO, "tgSegmentNetwork::ExecutePartitioned - cleaning " << input.size() << " segments in " << cells.size() << " cells with " << num_threads << " threads" );
+
+    segnetCellQueue                 queue( cells );
+    segnetSharedSink                shared( debug );
+    std::vector<segnetCleaner*>     cleaners;
+    for ( unsigned int i=0; i<num_threads; i++ ) {
+        segnetCleaner* cleaner = new segnetCleaner( queue, input, grid, clean_flags, &shared );
+        cleaner->start();
+        cleaners.push_back( cleaner );
+    }
+
+    for ( unsigned int i=0; i<cleaners.size(); i++ ) {
+        cleaners[i]->join();
+        delete cleaners[i];
+    }
+
+    // stitch the cells together, in row / column order
+    UniqueSGGeodSet nodes;
+
+    output.clear();
+    for ( segnetCellMap::iterator it = cells.begin(); it != cells.end(); it++ ) {
+        segnetCell* cell = it->second;
+
+        for ( segnetedge_it eit = cell->output.begin(); eit != cell->output.end(); eit++ ) {
+            unsigned int s = nodes.add( eit->start );
+            unsigned int e = nodes.add( eit->end );
+
+            if ( s != e ) {
+                output.push_back( segnetEdge( nodes[s], nodes[e], eit->width, eit->zorder, eit->type ) );
+            }
+        }
+
+        delete cell;
+    }
+
+    input.clear();
+}
+
 bool tgSegmentNetwork::IsVertexHandleInList( segnetVertexHandle h, std::list<segnetVertexHandle>& vertexList )
 {
     std::list<segnetVertexHandle>::iterator it;
@@ -172,14 +452,13 @@ void tgSegmentNetwork::ClusterVertex( segnetPoint newTargPoint,
                         SG_LOG(SG_GENERAL, SG_INFO, "tgSegmentNetwork::ClusterVertex edge already in del list" );
                     }
                 
-#if 1                
-                    SGGeod s = SGGeod::fromDeg( CGAL::to_double( cur_edge->source()->point().x() ),
-                                                CGAL::to_double( cur_edge->source()->point().y() ) );
-                    SGGeod e = SGGeod::fromDeg( CGAL::to_double( cur_edge->target()->point().x() ),
-                                                CGAL::to_double( cur_edge->target()->point().y() ) );
-                    tgSegment delseg(s, e);
-                    tgShapefile::FromSegment( delseg, true, datasource, "delete", desc );
-#endif
+                    if ( debug->Enabled() ) {
+                        SGGeod s = SGGeod::fromDeg( CGAL::to_double( cur_edge->source()->point().x() ),
+                                                    CGAL::to_double( cur_edge->source()->point().y() ) );
+                        SGGeod e = SGGeod::fromDeg( CGAL::to_double( cur_edge->target()->point().x() ),
+                                                    CGAL::to_double( cur_edge->target()->point().y() ) );
+                        debug->AddSegment( "delete", tgSegment(s, e), "cluster_delete" );
+                    }
                 
                 } else {
                     SG_LOG(SG_GENERAL, SG_INFO, "tgSegmentNetwork::ClusterVertex Need to modify this edge" );
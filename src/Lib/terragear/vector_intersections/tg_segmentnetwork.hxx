@@ -29,6 +29,7 @@
 #include <CGAL/Snap_rounding_2.h>
 
 #include <terragear/tg_cgal.hxx>
+#include "tg_intersection_debug.hxx"
 
 // the network arrangement
 class segnetEdge 
@@ -142,6 +143,13 @@ public:
     void      Execute( void );
     
     void      DumpPolys( void );
+    void      SetDebugSink( tgIntersectionDebugSink* sink ) { debug = sink; }
+
+    // Clean the network in square cells of cell_size degrees, instead of in
+    // one arrangement.  Each cell is cleaned on its own, with every segment
+    // within overlap degrees of it, on up to num_threads threads.  A
+    // cell_size of 0 ( the default ) cleans the whole network at once.
+    void      SetPartitions( double cell_size, double overlap, unsigned int num_threads );
     void      ToShapefiles( const char* prefix );
     
     segnetedge_it output_begin( void ) { return output.begin(); }
@@ -150,7 +158,9 @@ public:
     
     bool empty( void ) const 
     { 
-        if ( clean_flags ) {
+        if ( clean_flags && partition_size > 0.0 ) {
+            return input.empty();
+        } else if ( clean_flags ) {
             return (arr.number_of_edges() == 0); 
         } else {
             return output.empty();
@@ -165,6 +175,7 @@ private:
     void      FixShortSegments( void );
     void      RemoveColinearSegments( void );
     void      GenerateOutput( void );
+    void      ExecutePartitioned( void );
     
     bool      ArbitraryRayShoot( const segnetVertexHandle trg, double course, double dist, segnetPoint& minPoint, unsigned int finger_id, const char* dirname) const;
     
@@ -199,6 +210,13 @@ private:
     
     
     char               datasource[128];
+    tgIntersectionDebugSink* debug;
+
+    // partitioned cleaning - the input is kept until Execute
+    segnetedge_list    input;
+    double             partition_size;
+    double             partition_overlap;
+    unsigned int       partition_threads;
 };
 
 #if 0
@@ -31,6 +31,8 @@
 #include <simgear/debug/logstream.hxx>
 #include <simgear/io/lowlevel.hxx>
 #include <simgear/misc/sg_path.hxx>
+#include <simgear/threads/SGThread.hxx>
+#include <simgear/threads/SGGuard.hxx>
 
 #include <Lib/terragear/tg_rectangle.hxx>
 
@@ -40,6 +42,9 @@
 #include <ogr_spatialref.h>
 
 #include <boost/scoped_array.hpp>
+#include <boost/thread.hpp>
+
+#include <vector>
 
 /*
  * A simple benchmark using a 5x5 degree package
@@ -63,6 +68,11 @@
  * gdalchop: 172s 167s 169s, mean: 169s, 0.212s/bucket
  *
  * - Ralf Gerlich
+ *
+ * Buckets are now chopped on --threads worker threads.  Each thread has
+ * its own dataset handles, and reuses the transformer and warp operation
+ * of an image across buckets instead of creating them for every
+ * bucket / image pair.
  */
 
 struct SimpleRasterTransformerInfo {
@@ -103,6 +113,8 @@ int SimpleRasterTransformer(void *pTransformerArg,
     return success;
 }
 
+// Image metadata shared by all threads.  The dataset is only opened here
+// to determine the bounds - each thread reads through its own ImageReader.
 class ImageInfo {
 public:
     ImageInfo(GDALDataset *dataset);
@@ -121,26 +133,28 @@ public:
     }
 
     const char* GetDescription() const {
-        return dataset->GetDescription();
+        return description.c_str();
     }
 
-    int GetColStepArcsec() {
+    int GetColStepArcsec() const {
         return pxSizeX * 3600;
     }
 
-    int GetRowStepArcsec() {
+    int GetRowStepArcsec() const {
         return pxSizeY * 3600;
     }
 
-    void GetDataChunk(int *buffer,
-                      double x, double y,
-                      double colstep, double rowstep,
-                      int w, int h,
-                      int srcband = 1, int nodata = -32768);
+    double GetPixelSizeX() const {
+        return pxSizeX;
+    }
+
+    double GetPixelSizeY() const {
+        return pxSizeY;
+    }
 
 protected:
-    /* The dataset */
-    GDALDataset *dataset;
+    /* The dataset name, for reopening */
+    std::string description;
 
     /* Source spatial reference system */
     OGRSpatialReference srs;
@@ -162,7 +176,7 @@ protected:
 };
 
 ImageInfo::ImageInfo(GDALDataset *dataset) :
-    dataset(dataset),
+    description(dataset->GetDescription()),
     srs(dataset->GetProjectionRef())
 {
     OGRSpatialReference wgs84SRS;
@@ -227,12 +241,86 @@ ImageInfo::ImageInfo(GDALDataset *dataset) :
            " e=" << east << " w=" << west);
 }
 
-void ImageInfo::GetDataChunk(int *buffer,
-                             double x, double y,
-                             double colstep, double rowstep,
-                             int w, int h,
-                             int srcband, int nodata)
+// Per thread reader for one image.  GDAL dataset handles and transformers
+// are not thread safe, so every thread opens its own handle.  The
+// GenImgProj transformer and the warp operation only depend on the image,
+// so they are created once, on the first bucket the image covers, and
+// reused for every following bucket - only the WGS84 -> array grid part
+// of the transformation changes per bucket.  Asking for another band sets
+// them up again.
+class ImageReader {
+public:
+    ImageReader(const ImageInfo* info) :
+        info(info),
+        dataset(NULL),
+        band(0),
+        operation(NULL)
+    {
+        xformData.pfnTransformer = GDALGenImgProjTransform;
+        xformData.pTransformerArg = NULL;
+    }
+
+    ~ImageReader();
+
+    // only the band's own nodata value marks source pixels without data -
+    // nodata is unused.  returns false if the image couldn't be opened, or
+    // the warp failed
+    bool GetDataChunk(int *buffer,
+                      double x, double y,
+                      double colstep, double rowstep,
+                      int w, int h,
+                      int srcband = 1, int nodata = -32768);
+
+private:
+    bool Open(int srcband);
+    void Close();
+
+    const ImageInfo*            info;
+    GDALDataset*                dataset;
+    int                         band;
+
+    SimpleRasterTransformerInfo xformData;
+    GDALWarpOperation*          operation;
+};
+
+ImageReader::~ImageReader()
+{
+    Close();
+}
+
+void ImageReader::Close()
+{
+    delete operation;
+    operation = NULL;
+
+    if (xformData.pTransformerArg) {
+        GDALDestroyGenImgProjTransformer( xformData.pTransformerArg );
+        xformData.pTransformerArg = NULL;
+    }
+    if (dataset) {
+        GDALClose( dataset );
+        dataset = NULL;
+    }
+    band = 0;
+}
+
+bool ImageReader::Open(int srcband)
 {
+    dataset = (GDALDataset*)GDALOpen(info->GetDescription(), GA_ReadOnly);
+
+    if (dataset == NULL) {
+        SG_LOG(SG_GENERAL, SG_ALERT,
+               "Could not open dataset '" << info->GetDescription() << "'"
+               ":" << CPLGetLastErrorMsg());
+        return false;
+    }
+
+    if (srcband < 1 || srcband > dataset->GetRasterCount()) {
+        SG_LOG(SG_GENERAL, SG_ALERT,
+               "Dataset '" << info->GetDescription() << "' has no band " << srcband);
+        return false;
+    }
+
     OGRSpatialReference wgs84SRS;
 
     wgs84SRS.SetWellKnownGeogCS( "EPSG:4326" );
@@ -241,7 +329,6 @@ void ImageInfo::GetDataChunk(int *buffer,
     wgs84SRS.exportToWkt(&wgs84WKT);
 
     /* Setup a raster transformation from WGS84 to raster coordinates of the array files */
-    SimpleRasterTransformerInfo xformData;
     xformData.pTransformerArg = GDALCreateGenImgProjTransformer(
         dataset, NULL,
         NULL, wgs84WKT,
@@ -249,13 +336,14 @@ void ImageInfo::GetDataChunk(int *buffer,
         0.0,
         1);
 
-    xformData.pfnTransformer = GDALGenImgProjTransform;
-    xformData.x0 = x - pxSizeX * 0.5;
-    xformData.y0 = y - pxSizeY * 0.5;
-    xformData.col_step = colstep;
-    xformData.row_step = rowstep;
+    CPLFree( wgs84WKT );
 
-    // TODO: check if this image can actually cover part of the chunk
+    if (xformData.pTransformerArg == NULL) {
+        SG_LOG(SG_GENERAL, SG_ALERT,
+               "Could not create transformer for dataset '" << info->GetDescription() << "'"
+               ":" << CPLGetLastErrorMsg());
+        return false;
+    }
 
     /* establish the full source to target transformation */
     GDALWarpOptions *psWarpOptions = GDALCreateWarpOptions();
@@ -282,31 +370,70 @@ void ImageInfo::GetDataChunk(int *buffer,
     psWarpOptions->eResampleAlg = GRA_NearestNeighbour;
     psWarpOptions->eWorkingDataType = GDT_Int32;
 
+    // the operation keeps a pointer to xformData, so updating the grid
+    // origin before each warp is enough to retarget it
     psWarpOptions->pfnTransformer = SimpleRasterTransformer;
     psWarpOptions->pTransformerArg = &xformData;
 
-    GDALWarpOperation oOperation;
-    oOperation.Initialize( psWarpOptions );
-
-    /* do the warp */
-    if (oOperation.WarpRegionToBuffer(0, 0, w, h, buffer, GDT_Int32) != CE_None) {
-        SG_LOG(SG_GENERAL, SG_ALERT,
-               "Could not warp to buffer on dataset '" << GetDescription() << "'"
-               ":" << CPLGetLastErrorMsg());
-    }
+    operation = new GDALWarpOperation;
+    CPLErr err = operation->Initialize( psWarpOptions );
 
-    /* clean up */
+    /* Initialize copies the options - clean up */
     psWarpOptions->panSrcBands = NULL;
     psWarpOptions->panDstBands = NULL;
     psWarpOptions->padfSrcNoDataReal = NULL;
     psWarpOptions->padfSrcNoDataImag = NULL;
     psWarpOptions->padfDstNoDataReal = NULL;
 
-    GDALDestroyGenImgProjTransformer( xformData.pTransformerArg );
     GDALDestroyWarpOptions( psWarpOptions );
+
+    if (err != CE_None) {
+        SG_LOG(SG_GENERAL, SG_ALERT,
+               "Could not initialize warp operation for dataset '" << info->GetDescription() << "'"
+               ":" << CPLGetLastErrorMsg());
+        return false;
+    }
+
+    band = srcband;
+
+    return true;
+}
+
+bool ImageReader::GetDataChunk(int *buffer,
+                               double x, double y,
+                               double colstep, double rowstep,
+                               int w, int h,
+                               int srcband, int nodata)
+{
+    if (band != srcband) {
+        Close();
+        if (!Open(srcband)) {
+            Close();
+            return false;
+        }
+    }
+
+    xformData.x0 = x - info->GetPixelSizeX() * 0.5;
+    xformData.y0 = y - info->GetPixelSizeY() * 0.5;
+    xformData.col_step = colstep;
+    xformData.row_step = rowstep;
+
+    /* do the warp */
+    if (operation->WarpRegionToBuffer(0, 0, w, h, buffer, GDT_Int32) != CE_None) {
+        SG_LOG(SG_GENERAL, SG_ALERT,
+               "Could not warp to buffer on dataset '" << info->GetDescription() << "'"
+               ":" << CPLGetLastErrorMsg());
+        return false;
+    }
+
+    return true;
 }
 
-void write_bucket(const std::string& work_dir, SGBucket bucket,
+// SGPath::create_dir fails if another thread creates the same directory
+// in the middle of it
+SGMutex dir_lock;
+
+bool write_bucket(const std::string& work_dir, SGBucket bucket,
                   int* buffer,
                   int min_x, int min_y,
                   int span_x, int span_y,
@@ -317,14 +444,18 @@ void write_bucket(const std::string& work_dir, SGBucket bucket,
     std::string path = work_dir + "/" + base;
     SGPath sgp( path );
     sgp.append( "dummy" );
-    sgp.create_dir( 0755 );
+
+    {
+        SGGuard<SGMutex> g(dir_lock);
+        sgp.create_dir( 0755 );
+    }
 
     std::string array_file = path + "/" + bucket.gen_index_str() + ".arr.gz";
 
     gzFile fp;
     if ( (fp = gzopen(array_file.c_str(), "wb9")) == NULL ) {
         SG_LOG(SG_GENERAL, SG_ALERT, "cannot open " << array_file << " for writing!");
-        exit(-1);
+        return false;
     }
 
     int32_t header = 0x54474152; // 'TGAR'
@@ -340,10 +471,14 @@ void write_bucket(const std::string& work_dir, SGBucket bucket,
     }
 
     gzclose(fp);
+
+    return true;
 }
 
-void process_bucket(const SGPath& work_dir, SGBucket bucket,
-                    ImageInfo* images[], int imagecount,
+// returns false if an image couldn't be read or the bucket couldn't be written
+bool process_bucket(const SGPath& work_dir, SGBucket bucket,
+                    ImageInfo* images[], ImageReader* readers[], int imagecount,
+                    int col_step, int row_step,
                     bool forceWrite = false)
 {
     double bnorth, bsouth, beast, bwest;
@@ -364,17 +499,6 @@ void process_bucket(const SGPath& work_dir, SGBucket bucket,
     min_x = (int)(bwest * 3600.0);
     min_y = (int)(bsouth * 3600.0);
 
-    // Determine minimum common arcsec steps across images
-    int col_step = -1, row_step = -1;
-    for (int i = 0; i < imagecount; i++) {
-        if ( images[i]->GetColStepArcsec() > col_step ) {
-            col_step = images[i]->GetColStepArcsec();
-        }
-        if ( images[i]->GetRowStepArcsec() > row_step ) {
-            row_step = images[i]->GetRowStepArcsec();
-        }
-    }
-
     span_x = (bucket.get_width() * 3600 / col_step) + 1;
     span_y = (bucket.get_height() * 3600 / row_step) + 1;
 
@@ -385,10 +509,12 @@ void process_bucket(const SGPath& work_dir, SGBucket bucket,
 
     for (int i = 0; i < imagecount; i++) {
         if ( images[i]->GetBoundingBox().intersects(BucketBounds) ) {
-            images[i]->GetDataChunk(buffer.get(),
-                                    bwest, bsouth,
-                                    col_step / 3600.0, row_step / 3600.0,
-                                    span_x, span_y );
+            if ( !readers[i]->GetDataChunk(buffer.get(),
+                                           bwest, bsouth,
+                                           col_step / 3600.0, row_step / 3600.0,
+                                           span_x, span_y ) ) {
+                return false;
+            }
         }
     }
 
@@ -410,25 +536,149 @@ void process_bucket(const SGPath& work_dir, SGBucket bucket,
         SG_LOG(SG_GENERAL, SG_INFO, "    there is not enough data available to cover this cell (limit for non-covered cells is " << nodataPercLimit << "%)");
         /* don't write out if not forced to */
         if (!forceWrite)
-            return;
+            return true;
     }
 
     /* ...and write it out */
-    write_bucket(work_dir.str(), bucket,
+    return write_bucket(work_dir.str(), bucket,
                  buffer.get(),
                  min_x, min_y,
                  span_x, span_y,
                  col_step, row_step);
 }
 
+// The buckets to chop.  Threads take the next bucket until none are left.
+class BucketQueue {
+public:
+    BucketQueue() : next(0) {}
+
+    void push(const SGBucket& b) {
+        buckets.push_back(b);
+    }
+
+    // hand out no more buckets
+    void abort() {
+        SGGuard<SGMutex> g(lock);
+        next = buckets.size();
+    }
+
+    unsigned int size() const {
+        return buckets.size();
+    }
+
+    bool pop(SGBucket& b) {
+        SGGuard<SGMutex> g(lock);
+
+        if (next >= buckets.size()) {
+            return false;
+        }
+
+        b = buckets[next++];
+        return true;
+    }
+
+private:
+    std::vector<SGBucket>   buckets;
+    unsigned int            next;
+    SGMutex                 lock;
+};
+
+class Chopper : public SGThread
+{
+public:
+    Chopper(const SGPath& wd, BucketQueue& q,
+            ImageInfo* imgs[], int count,
+            int cs, int rs, bool fw) :
+        work_dir(wd), queue(q),
+        images(imgs), imagecount(count),
+        col_step(cs), row_step(rs), forceWrite(fw),
+        failed(false)
+    {
+        for (int i = 0; i < imagecount; i++) {
+            readers.push_back( new ImageReader(images[i]) );
+        }
+    }
+
+    ~Chopper() {
+        for (unsigned int i = 0; i < readers.size(); i++) {
+            delete readers[i];
+        }
+    }
+
+    // set when a bucket failed - read once joined
+    bool hasFailed() const { return failed; }
+    const SGBucket& failedBucket() const { return failure; }
+
+private:
+    virtual void run();
+
+    SGPath                      work_dir;
+    BucketQueue&                queue;
+    ImageInfo**                 images;
+    int                         imagecount;
+    int                         col_step, row_step;
+    bool                        forceWrite;
+
+    // this thread's dataset handles and warpers
+    std::vector<ImageReader*>   readers;
+
+    bool                        failed;
+    SGBucket                    failure;
+};
+
+void Chopper::run()
+{
+    SGBucket bucket;
+
+    while (queue.pop(bucket)) {
+        if (!process_bucket(work_dir, bucket,
+                            images, &readers[0], imagecount,
+                            col_step, row_step,
+                            forceWrite)) {
+            // the other threads finish their current bucket and stop
+            failed = true;
+            failure = bucket;
+            queue.abort();
+        }
+    }
+}
+
+void usage(const char* progname)
+{
+    SG_LOG(SG_GENERAL, SG_ALERT,
+           "Usage " << progname << " [--threads[=N]] <work_dir> <datasetname...> [-- <bucket-idx> ...]");
+    exit(-1);
+}
+
 int main(int argc, const char **argv)
 {
     sglog().setLogLevels( SG_ALL, SG_INFO );
 
+    const char* progname = argv[0];
+    int num_threads = 1;
+
+    // options come before the work dir
+    while ( argc > 1 && !strncmp(argv[1], "--", 2) && strcmp(argv[1], "--") ) {
+        std::string arg = argv[1];
+
+        if (arg.find("--threads=") == 0) {
+            num_threads = atoi( arg.substr(10).c_str() );
+        } else if (arg.find("--threads") == 0) {
+            num_threads = boost::thread::hardware_concurrency();
+        } else {
+            usage(progname);
+        }
+
+        argv++;
+        argc--;
+    }
+
     if ( argc < 3 ) {
-        SG_LOG(SG_GENERAL, SG_ALERT,
-               "Usage " << argv[0] << " <work_dir> <datasetname...> [-- <bucket-idx> ...]");
-        exit(-1);
+        usage(progname);
+    }
+
+    if ( num_threads < 1 ) {
+        num_threads = 1;
     }
 
     SGPath work_dir(argv[1]);
@@ -467,7 +717,7 @@ int main(int argc, const char **argv)
     for (int i = 0; i < datasetcount; i++) {
         GDALDataset* dataset;
 
-        dataset = (GDALDataset*)GDALOpenShared(datasetnames[i], GA_ReadOnly);
+        dataset = (GDALDataset*)GDALOpen(datasetnames[i], GA_ReadOnly);
 
         if (dataset == NULL) {
             SG_LOG(SG_GENERAL, SG_ALERT,
@@ -478,6 +728,9 @@ int main(int argc, const char **argv)
 
         images[i] = new ImageInfo(dataset);
 
+        // the chopper threads open their own handles
+        GDALClose(dataset);
+
         double inorth, isouth, ieast, iwest;
         images[i]->GetBounds(inorth, isouth, ieast, iwest);
 
@@ -489,6 +742,17 @@ int main(int argc, const char **argv)
 
     SG_LOG(SG_GENERAL, SG_INFO, "Bounds of all datasets: n=" << north << " s=" << south << " e=" << east << " w=" << west);
 
+    // Determine minimum common arcsec steps across images
+    int col_step = -1, row_step = -1;
+    for (int i = 0; i < datasetcount; i++) {
+        if ( images[i]->GetColStepArcsec() > col_step ) {
+            col_step = images[i]->GetColStepArcsec();
+        }
+        if ( images[i]->GetRowStepArcsec() > row_step ) {
+            row_step = images[i]->GetRowStepArcsec();
+        }
+    }
+
     /*
      * Step 2: If no tiles were specified, go through all tiles contained in
      *         the common bounds of all datasets and find those which have
@@ -497,6 +761,9 @@ int main(int argc, const char **argv)
      *         all of them. Warn if no sufficient coverage (non-null pixels) is
      *         available.
      */
+    BucketQueue queue;
+    bool forceWrite;
+
     if (tilecount == 0) {
         /*
          * No tiles were specified, so we determine the common bounds of all
@@ -513,21 +780,52 @@ int main(int argc, const char **argv)
 
         for (int x = 0; x <= dx; x++) {
             for (int y = 0; y <= dy; y++) {
-                SGBucket bucket = start.sibling(x, y);
-
-                process_bucket(work_dir, bucket, images.get(), datasetcount);
+                queue.push( start.sibling(x, y) );
             }
         }
+
+        forceWrite = false;
     } else {
         /*
          * Tiles were specified, so process them and warn if not enough
          * data is available, but write them in any case.
          */
         for (int i = 0; i < tilecount; i++) {
-            SGBucket bucket(atol(tilenames[i]));
+            queue.push( SGBucket(atol(tilenames[i])) );
+        }
+
+        forceWrite = true;
+    }
+
+    if ( (unsigned int)num_threads > queue.size() ) {
+        num_threads = std::max( queue.size(), 1u );
+    }
+
+    SG_LOG(SG_GENERAL, SG_INFO, "Chopping " << queue.size() << " buckets with " << num_threads << " threads");
 
-            process_bucket(work_dir, bucket, images.get(), datasetcount, true);
+    std::vector<Chopper *> choppers;
+    for (int i = 0; i < num_threads; i++) {
+        Chopper* chopper = new Chopper( work_dir, queue, images.get(), datasetcount, col_step, row_step, forceWrite );
+        chopper->start();
+        choppers.push_back( chopper );
+    }
+
+    bool failed = false;
+    for (unsigned int i = 0; i < choppers.size(); i++) {
+        choppers[i]->join();
+        if (choppers[i]->hasFailed()) {
+            SG_LOG(SG_GENERAL, SG_ALERT, "Failed chopping bucket " << choppers[i]->failedBucket());
+            failed = true;
         }
+        delete choppers[i];
+    }
+
+    for (int i = 0; i < datasetcount; i++) {
+        delete images[i];
+    }
+
+    if (failed) {
+        exit(1);
     }
 
     return 0;
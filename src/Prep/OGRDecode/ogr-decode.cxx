@@ -24,6 +24,8 @@
 
 #include <string>
 #include <map>
+#include <deque>
+#include <vector>
 
 #include <boost/thread.hpp>
 #include <ogrsf_frmts.h>
@@ -31,7 +33,7 @@
 
 #include <simgear/compiler.h>
 #include <simgear/threads/SGThread.hxx>
-#include <simgear/threads/SGQueue.hxx>
+#include <simgear/threads/SGGuard.hxx>
 #include <simgear/debug/logstream.hxx>
 #include <simgear/math/sg_geodesy.hxx>
 #include <simgear/misc/sg_path.hxx>
@@ -64,12 +66,74 @@ string attribute_query;
 bool use_spatial_query=false;
 double spat_min_x, spat_min_y, spat_max_x, spat_max_y;
 int num_threads = 1;
+int batch_size = 256;
+int queue_batches = 0;  // ==0 => 4 per thread
 bool save_shapefiles=false;
 std::string ds_name=".";
 
 const double gSnap = 0.00000001;      // approx 1 mm
 
-SGLockedQueue<OGRFeature *> global_workQueue;
+// Features are read on the main thread and handed to the decoders in
+// batches.  The queue holds a bounded number of batches - once it is full
+// the reader blocks until a decoder takes one, so the number of features in
+// memory is limited no matter how large the layer is.
+class FeatureQueue
+{
+public:
+    typedef std::vector<OGRFeature *> Batch;
+
+    FeatureQueue( unsigned int max ) : maxBatches(max), closed(false) {}
+
+    // blocks while the queue is full
+    void push( Batch& batch ) {
+        SGGuard<SGMutex> g(lock);
+
+        while ( batches.size() >= maxBatches ) {
+            notFull.wait( lock );
+        }
+
+        batches.push_back( Batch() );
+        batches.back().swap( batch );
+        notEmpty.signal();
+    }
+
+    // blocks while the queue is empty.  returns false once the queue is
+    // closed and drained
+    bool pop( Batch& batch ) {
+        SGGuard<SGMutex> g(lock);
+
+        while ( batches.empty() && !closed ) {
+            notEmpty.wait( lock );
+        }
+
+        if ( batches.empty() ) {
+            return false;
+        }
+
+        batch.swap( batches.front() );
+        batches.pop_front();
+        notFull.signal();
+
+        return true;
+    }
+
+    // no more batches will be pushed
+    void close( void ) {
+        SGGuard<SGMutex> g(lock);
+
+        closed = true;
+        notEmpty.broadcast();
+    }
+
+private:
+    std::deque<Batch>   batches;
+    unsigned int        maxBatches;
+    bool                closed;
+
+    SGMutex             lock;
+    SGWaitCondition     notEmpty;
+    SGWaitCondition     notFull;
+};
 
 /* very GDAL specific here... */
 inline static bool is_ocean_area( const std::string &area ) {
@@ -87,24 +151,34 @@ inline static bool is_null_area( const std::string& area ) {
 class Decoder : public SGThread
 {
 public:
-    Decoder( OGRCoordinateTransformation *poct, int atf, int pwf, int lwf, tgChopper& c ) : chopper(c) {
+    Decoder( OGRCoordinateTransformation *poct, int atf, int pwf, int lwf, FeatureQueue& q, tgChopper& c ) : queue(q), chopper(c) {
         poCT = poct;
         area_type_field = atf;
         point_width_field = pwf;
         line_width_field = lwf;
     }
 
+    ~Decoder() {
+        OCTDestroyCoordinateTransformation ( poCT );
+    }
+
 private:
     virtual void run();
 
+    void processFeature(OGRFeature* poFeature);
+
     void processPoint(OGRPoint* poGeometry, const string& area_type, int width );
     void processLineString(OGRLineString* poGeometry, const string& area_type, int width, int with_texture );
     void processPolygon(OGRPolygon* poGeometry, const string& area_type );
 
 private:
-    // The transformation for each geometry object
+    // The transformation for each geometry object - one per decoder, as
+    // OGRCoordinateTransformation is not thread safe
     OGRCoordinateTransformation *poCT;
 
+    // The features to decode
+    FeatureQueue& queue;
+
     // Store the reults per tile
     tgChopper& chopper;
 
@@ -219,140 +293,148 @@ void Decoder::processPolygon(OGRPolygon* poGeometry, const string& area_type )
 
 void Decoder::run()
 {
+    FeatureQueue::Batch batch;
+
     // as long as we have geometry to parse, do so
-    while (!global_workQueue.empty()) {
-        OGRFeature *poFeature = global_workQueue.pop();
-        // SG_LOG( SG_GENERAL, SG_INFO, " remaining features is " << global_workQueue.size() );
-
-        if ( poFeature ) {
-            OGRGeometry *poGeometry = poFeature->GetGeometryRef();
-
-            if (poGeometry==NULL) {
-                SG_LOG( SG_GENERAL, SG_INFO, "Found feature without geometry!" );
-                if (!continue_on_errors) {
-                    SG_LOG( SG_GENERAL, SG_ALERT, "Aborting!" );
-                    exit( 1 );
-                } else {
-                    continue;
-                }
-            }
+    while ( queue.pop( batch ) ) {
+        for (unsigned int i=0; i<batch.size(); i++) {
+            processFeature( batch[i] );
+            OGRFeature::DestroyFeature( batch[i] );
+        }
+        batch.clear();
+    }
+}
 
-            OGRwkbGeometryType geoType=wkbFlatten(poGeometry->getGeometryType());
-            if (geoType!=wkbPoint && geoType!=wkbMultiPoint &&
-                geoType!=wkbLineString && geoType!=wkbMultiLineString &&
-                geoType!=wkbPolygon && geoType!=wkbMultiPolygon) {
-                    SG_LOG( SG_GENERAL, SG_INFO, "Unknown feature" );
-                    continue;
-            }
+void Decoder::processFeature(OGRFeature* poFeature)
+{
+    if ( !poFeature ) {
+        return;
+    }
 
-            string area_type_name=area_type;
-            if (area_type_field!=-1) {
-                area_type_name=poFeature->GetFieldAsString(area_type_field);
-            }
+    OGRGeometry *poGeometry = poFeature->GetGeometryRef();
 
-            if ( is_ocean_area(area_type_name) ) {
-                // interior of polygon is ocean, holes are islands
+    if (poGeometry==NULL) {
+        SG_LOG( SG_GENERAL, SG_INFO, "Found feature without geometry!" );
+        if (!continue_on_errors) {
+            SG_LOG( SG_GENERAL, SG_ALERT, "Aborting!" );
+            exit( 1 );
+        } else {
+            return;
+        }
+    }
 
-                SG_LOG(  SG_GENERAL, SG_ALERT, "Ocean area ... SKIPPING!" );
+    OGRwkbGeometryType geoType=wkbFlatten(poGeometry->getGeometryType());
+    if (geoType!=wkbPoint && geoType!=wkbMultiPoint &&
+        geoType!=wkbLineString && geoType!=wkbMultiLineString &&
+        geoType!=wkbPolygon && geoType!=wkbMultiPolygon) {
+            SG_LOG( SG_GENERAL, SG_INFO, "Unknown feature" );
+            return;
+    }
+
+    string area_type_name=area_type;
+    if (area_type_field!=-1) {
+        area_type_name=poFeature->GetFieldAsString(area_type_field);
+    }
 
-                // Ocean data now comes from GSHHS so we want to ignore
-                // all other ocean data
-                continue;
-            } else if ( is_void_area(area_type_name) ) {
-                // interior is ????
+    if ( is_ocean_area(area_type_name) ) {
+        // interior of polygon is ocean, holes are islands
 
-                // skip for now
-                SG_LOG(  SG_GENERAL, SG_ALERT, "Void area ... SKIPPING!" );
+        SG_LOG(  SG_GENERAL, SG_ALERT, "Ocean area ... SKIPPING!" );
 
-                continue;
-            } else if ( is_null_area(area_type_name) ) {
-                // interior is ????
+        // Ocean data now comes from GSHHS so we want to ignore
+        // all other ocean data
+        return;
+    } else if ( is_void_area(area_type_name) ) {
+        // interior is ????
 
-                // skip for now
-                SG_LOG(  SG_GENERAL, SG_ALERT, "Null area ... SKIPPING!" );
+        // skip for now
+        SG_LOG(  SG_GENERAL, SG_ALERT, "Void area ... SKIPPING!" );
 
-                continue;
-            }
+        return;
+    } else if ( is_null_area(area_type_name) ) {
+        // interior is ????
 
-            poGeometry->transform( poCT );
-
-            switch (geoType) {
-            case wkbPoint: {
-                SG_LOG( SG_GENERAL, SG_DEBUG, "Point feature" );
-                int width=point_width;
-                if (point_width_field!=-1) {
-                    width=poFeature->GetFieldAsInteger(point_width_field);
-                    if (width == 0) {
-                        width=point_width;
-                    }
-                }
-                processPoint((OGRPoint*)poGeometry, area_type_name, width);
-                break;
-            }
-            case wkbMultiPoint: {
-                SG_LOG( SG_GENERAL, SG_DEBUG, "MultiPoint feature" );
-                int width=point_width;
-                if (point_width_field!=-1) {
-                    width=poFeature->GetFieldAsInteger(point_width_field);
-                    if (width == 0) {
-                        width=point_width;
-                    }
-                }
-                OGRMultiPoint* multipt=(OGRMultiPoint*)poGeometry;
-                for (int i=0;i<multipt->getNumGeometries();i++) {
-                    processPoint((OGRPoint*)(multipt->getGeometryRef(i)), area_type_name, width);
-                }
-                break;
-            }
-            case wkbLineString: {
-                SG_LOG( SG_GENERAL, SG_DEBUG, "LineString feature" );
-                int width=line_width;
-                if (line_width_field!=-1) {
-                    width=poFeature->GetFieldAsInteger(line_width_field);
-                    if (width == 0) {
-                        width=line_width;
-                    }
-                }
-
-                processLineString((OGRLineString*)poGeometry, area_type_name, width, texture_lines);
-                break;
-            }
-            case wkbMultiLineString: {
-                SG_LOG( SG_GENERAL, SG_DEBUG, "MultiLineString feature" );
-                int width=line_width;
-                if (line_width_field!=-1) {
-                    width=poFeature->GetFieldAsInteger(line_width_field);
-                    if (width == 0) {
-                        width=line_width;
-                    }
-                }
-
-                OGRMultiLineString* multilines=(OGRMultiLineString*)poGeometry;
-                for (int i=0;i<multilines->getNumGeometries();i++) {
-                    processLineString((OGRLineString*)(multilines->getGeometryRef(i)), area_type_name, width, texture_lines);
-                }
-                break;
+        // skip for now
+        SG_LOG(  SG_GENERAL, SG_ALERT, "Null area ... SKIPPING!" );
+
+        return;
+    }
+
+    poGeometry->transform( poCT );
+
+    switch (geoType) {
+    case wkbPoint: {
+        SG_LOG( SG_GENERAL, SG_DEBUG, "Point feature" );
+        int width=point_width;
+        if (point_width_field!=-1) {
+            width=poFeature->GetFieldAsInteger(point_width_field);
+            if (width == 0) {
+                width=point_width;
             }
-            case wkbPolygon: {
-                SG_LOG( SG_GENERAL, SG_DEBUG, "Polygon feature" );
-                processPolygon((OGRPolygon*)poGeometry, area_type_name);
-                break;
+        }
+        processPoint((OGRPoint*)poGeometry, area_type_name, width);
+        break;
+    }
+    case wkbMultiPoint: {
+        SG_LOG( SG_GENERAL, SG_DEBUG, "MultiPoint feature" );
+        int width=point_width;
+        if (point_width_field!=-1) {
+            width=poFeature->GetFieldAsInteger(point_width_field);
+            if (width == 0) {
+                width=point_width;
             }
-            case wkbMultiPolygon: {
-                SG_LOG( SG_GENERAL, SG_DEBUG, "MultiPolygon feature" );
-                OGRMultiPolygon* multipoly=(OGRMultiPolygon*)poGeometry;
-                for (int i=0;i<multipoly->getNumGeometries();i++) {
-                    processPolygon((OGRPolygon*)(multipoly->getGeometryRef(i)), area_type_name);
-                }
-                break;
+        }
+        OGRMultiPoint* multipt=(OGRMultiPoint*)poGeometry;
+        for (int i=0;i<multipt->getNumGeometries();i++) {
+            processPoint((OGRPoint*)(multipt->getGeometryRef(i)), area_type_name, width);
+        }
+        break;
+    }
+    case wkbLineString: {
+        SG_LOG( SG_GENERAL, SG_DEBUG, "LineString feature" );
+        int width=line_width;
+        if (line_width_field!=-1) {
+            width=poFeature->GetFieldAsInteger(line_width_field);
+            if (width == 0) {
+                width=line_width;
             }
-            default:
-                /* Ignore unhandled objects */
-                break;
+        }
+
+        processLineString((OGRLineString*)poGeometry, area_type_name, width, texture_lines);
+        break;
+    }
+    case wkbMultiLineString: {
+        SG_LOG( SG_GENERAL, SG_DEBUG, "MultiLineString feature" );
+        int width=line_width;
+        if (line_width_field!=-1) {
+            width=poFeature->GetFieldAsInteger(line_width_field);
+            if (width == 0) {
+                width=line_width;
             }
+        }
 
-            OGRFeature::DestroyFeature( poFeature );
+        OGRMultiLineString* multilines=(OGRMultiLineString*)poGeometry;
+        for (int i=0;i<multilines->getNumGeometries();i++) {
+            processLineString((OGRLineString*)(multilines->getGeometryRef(i)), area_type_name, width, texture_lines);
+        }
+        break;
+    }
+    case wkbPolygon: {
+        SG_LOG( SG_GENERAL, SG_DEBUG, "Polygon feature" );
+        processPolygon((OGRPolygon*)poGeometry, area_type_name);
+        break;
+    }
+    case wkbMultiPolygon: {
+        SG_LOG( SG_GENERAL, SG_DEBUG, "MultiPolygon feature" );
+        OGRMultiPolygon* multipoly=(OGRMultiPolygon*)poGeometry;
+        for (int i=0;i<multipoly->getNumGeometries();i++) {
+            processPolygon((OGRPolygon*)(multipoly->getGeometryRef(i)), area_type_name);
         }
+        break;
+    }
+    default:
+        /* Ignore unhandled objects */
+        break;
     }
 }
 
@@ -413,8 +495,6 @@ void processLayer(OGRLayer* poLayer, tgChopper& results )
 
     oTargetSRS.SetWellKnownGeogCS( "WGS84" );
 
-    OGRCoordinateTransformation *poCT = OGRCreateCoordinateTransformation(oSourceSRS, &oTargetSRS);
-
     /* setup attribute and spatial queries */
     if (use_spatial_query) {
         double trans_min_x,trans_min_y,trans_max_x,trans_max_y;
@@ -442,29 +522,53 @@ void processLayer(OGRLayer* poLayer, tgChopper& results )
         }
     }
 
-    // Generate the work queue for this layer
+    // Start the decoders first, so they work while we read
+    // this just generates all the tgPolygons
+    int threads = ( num_threads > 0 ) ? num_threads : 1;
+    FeatureQueue queue( ( queue_batches > 0 ) ? queue_batches : 4 * threads );
+
+    std::vector<Decoder *> decoders;
+    for (int i=0; i<threads; i++) {
+        OGRCoordinateTransformation *poCT = OGRCreateCoordinateTransformation(oSourceSRS, &oTargetSRS);
+        if (poCT == NULL) {
+            SG_LOG( SG_GENERAL, SG_ALERT, "Could not create transformation from layer " << layername << " to WGS84" );
+            exit( 1 );
+        }
+
+        Decoder* decoder = new Decoder( poCT, area_type_field, point_width_field, line_width_field, queue, results );
+        decoder->start();
+        decoders.push_back( decoder );
+    }
+
+    // Stream the layer to the decoders
+    FeatureQueue::Batch batch;
     OGRFeature *poFeature;
+    long num_features = 0;
+
+    batch.reserve( batch_size );
     poLayer->SetNextByIndex(start_record);
     while ( ( poFeature = poLayer->GetNextFeature()) != NULL )
     {
-        global_workQueue.push( poFeature );
-    }
+        batch.push_back( poFeature );
+        num_features++;
 
-    // Now process the workqueue with threads
-    // this just generates all the tgPolygons
-    std::vector<Decoder *> decoders;
-    for (int i=0; i<num_threads; i++) {
-        Decoder* decoder = new Decoder( poCT, area_type_field, point_width_field, line_width_field, results );
-        decoder->start();
-        decoders.push_back( decoder );
+        if ( (int)batch.size() >= batch_size ) {
+            queue.push( batch );
+            batch.reserve( batch_size );
+        }
+    }
+    if ( !batch.empty() ) {
+        queue.push( batch );
     }
+    queue.close();
+
+    SG_LOG( SG_GENERAL, SG_INFO, "Read " << num_features << " features from layer " << layername );
 
     // Then wait until they are finished
     for (unsigned int i=0; i<decoders.size(); i++) {
         decoders[i]->join();
+        delete decoders[i];
     }
-
-    OCTDestroyCoordinateTransformation ( poCT );
 }
 
 void usage(char* progname) {
@@ -502,6 +606,10 @@ void usage(char* progname) {
     SG_LOG( SG_GENERAL, SG_ALERT, "        Enable multithreading with user specified number of threads" );
     SG_LOG( SG_GENERAL, SG_ALERT, "--all-threads" );
     SG_LOG( SG_GENERAL, SG_ALERT, "        Enable multithreading with all available cpu cores" );
+    SG_LOG( SG_GENERAL, SG_ALERT, "--batch-size features" );
+    SG_LOG( SG_GENERAL, SG_ALERT, "        Number of features handed to a thread at a time (default 256)" );
+    SG_LOG( SG_GENERAL, SG_ALERT, "--queue-size batches" );
+    SG_LOG( SG_GENERAL, SG_ALERT, "        Maximum number of batches read ahead (default 4 per thread)" );
     SG_LOG( SG_GENERAL, SG_ALERT, "" );
     SG_LOG( SG_GENERAL, SG_ALERT, "<work_dir>" );
     SG_LOG( SG_GENERAL, SG_ALERT, "        Directory to put the polygon files in" );
@@ -618,6 +726,23 @@ int main( int argc, char **argv ) {
             num_threads=boost::thread::hardware_concurrency(); 
             argv+=1;
             argc-=1;
+        } else if (!strcmp(argv[1],"--batch-size")) {
+            if (argc<3) {
+                usage(progname);
+            }
+            batch_size=atoi(argv[2]);
+            if (batch_size < 1) {
+                batch_size = 1;
+            }
+            argv+=2;
+            argc-=2;
+        } else if (!strcmp(argv[1],"--queue-size")) {
+            if (argc<3) {
+                usage(progname);
+            }
+            queue_batches=atoi(argv[2]);
+            argv+=2;
+            argc-=2;
         } else if (!strcmp(argv[1],"--debug")) {
             argv++;
             argc--;
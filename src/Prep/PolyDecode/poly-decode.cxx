@@ -566,5 +566,7 @@ int main( int argc, char **argv ) {
 
     GDALClose(poDS);
 
+    results.logStats();
+
     return 0;
 }
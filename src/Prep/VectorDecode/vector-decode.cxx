@@ -20,6 +20,8 @@
 // Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
 //
 
+#include <algorithm>
+#include <fstream>
 #include <string>
 #include <map>
 #include <limits>
@@ -27,10 +29,11 @@
 #include <boost/thread.hpp>
 
 #include <ogrsf_frmts.h>
+#include <gdal_priv.h>
 
 #include <simgear/compiler.h>
 #include <simgear/threads/SGThread.hxx>
-#include <simgear/threads/SGQueue.hxx>
+#include <simgear/threads/SGGuard.hxx>
 #include <simgear/debug/logstream.hxx>
 #include <simgear/math/sg_geodesy.hxx>
 #include <simgear/misc/sg_path.hxx>
@@ -53,7 +56,6 @@
 
 using std::string;
 
-int line_width=50;
 string line_width_col;
 string area_type="Default";
 string area_type_col;
@@ -64,6 +66,8 @@ bool use_attribute_query=false;
 string attribute_query;
 bool use_spatial_query=false;
 double spat_min_x, spat_min_y, spat_max_x, spat_max_y;
+string debug_mode="none";
+unsigned int debug_ring_size=10000;
 
 struct areaDef 
 {
@@ -112,18 +116,21 @@ void processLineString(OGRLineString* poGeometry, unsigned int idx, int width, i
     }
 }
 
-void processLayer(OGRLayer* poLayer, const SGBucket& bucket, tgChopper& results, unsigned int idx, tgIntersectionGenerator* pig )
+// runs on the decoder threads - returns false on an error that should stop
+// the decode, for the main thread to report
+bool processLayer(OGRLayer* poLayer, const SGBucket& bucket, unsigned int idx, tgIntersectionGenerator* pig )
 {
     int feature_count=poLayer->GetFeatureCount();
     int zorder;
     
     if (feature_count!=-1 && start_record>0 && start_record>=feature_count) {
         SG_LOG( SG_GENERAL, SG_ALERT, "Layer has only " << feature_count << " records, but start record is set to " << start_record );
-        exit( 1 );
+        return false;
     }
     
-    // first, get default width
-    line_width = areaDefs[idx].width;
+    // first, get default width - local, as the layers of other buckets
+    // are processed on other threads
+    int line_width = areaDefs[idx].width;
     
     /* determine the indices of the required columns */
     OGRFeatureDefn *poFDefn = poLayer->GetLayerDefn();
@@ -135,7 +142,7 @@ void processLayer(OGRLayer* poLayer, const SGBucket& bucket, tgChopper& results,
         if (line_width_field==-1) {
             SG_LOG( SG_GENERAL, SG_ALERT, "Field " << line_width_col << " for line-width not found in layer" );
         if (!continue_on_errors)
-            exit( 1 );
+            return false;
         }
     }
 
@@ -145,7 +152,7 @@ void processLayer(OGRLayer* poLayer, const SGBucket& bucket, tgChopper& results,
 
     if (oSourceSRS == NULL) {
         SG_LOG( SG_GENERAL, SG_ALERT, "Layer " << layername << " has no defined spatial reference system" );
-        exit( 1 );
+        return false;
     }
 
     char* srsWkt;
@@ -166,6 +173,13 @@ void processLayer(OGRLayer* poLayer, const SGBucket& bucket, tgChopper& results,
 
     poCTinverse = OGRCreateCoordinateTransformation(&oTargetSRS, oSourceSRS);
 
+    if ( poCT == NULL || poCTinverse == NULL ) {
+        SG_LOG( SG_GENERAL, SG_ALERT, "Could not create transformation from layer " << layername << " to WGS84" );
+        OCTDestroyCoordinateTransformation ( poCT );
+        OCTDestroyCoordinateTransformation ( poCTinverse );
+        return false;
+    }
+
     SGGeod min, max;
     min = bucket.get_corner( SG_BUCKET_SW );
     max = bucket.get_corner( SG_BUCKET_NE );
@@ -182,8 +196,10 @@ void processLayer(OGRLayer* poLayer, const SGBucket& bucket, tgChopper& results,
                                   trans_max_x, trans_max_y);
 
     OGRFeature *poFeature;
+    bool        ok = true;
+
     poLayer->SetNextByIndex(start_record);
-    for ( ; (poFeature = poLayer->GetNextFeature()) != NULL; OGRFeature::DestroyFeature( poFeature ) )
+    for ( ; ok && (poFeature = poLayer->GetNextFeature()) != NULL; OGRFeature::DestroyFeature( poFeature ) )
     {
         OGRGeometry *poGeometry;
 
@@ -193,10 +209,9 @@ void processLayer(OGRLayer* poLayer, const SGBucket& bucket, tgChopper& results,
             SG_LOG( SG_GENERAL, SG_INFO, "Found feature without geometry!" );
             if (!continue_on_errors) {
                 SG_LOG( SG_GENERAL, SG_ALERT, "Aborting!" );
-                exit( 1 );
-            } else {
-                continue;
+                ok = false;
             }
+            continue;
         }
 
         assert(poGeometry!=NULL);
@@ -241,7 +256,7 @@ void processLayer(OGRLayer* poLayer, const SGBucket& bucket, tgChopper& results,
 
             OGRMultiLineString* multils=(OGRMultiLineString*)poGeometry;
             for (int i=0;i<multils->getNumGeometries();i++) {
-                processLineString((OGRLineString*)poGeometry, idx, width, zorder, pig);
+                processLineString((OGRLineString*)multils->getGeometryRef(i), idx, width, zorder, pig);
             }
             break;
         }
@@ -252,6 +267,202 @@ void processLayer(OGRLayer* poLayer, const SGBucket& bucket, tgChopper& results,
     }
 
     OCTDestroyCoordinateTransformation ( poCT );
+    OCTDestroyCoordinateTransformation ( poCTinverse );
+
+    return ok;
+}
+
+// decode the layers of all areaDefs that fall in the bucket, and write the
+// resulting polygons into the bucket's work dir.  returns false if a layer
+// couldn't be decoded
+bool decodeBucket( const SGBucket& bucket, const std::vector<GDALDataset*>& datasets, const std::string& work_dir )
+{
+    char debugdir[128];
+
+    SG_LOG( SG_GENERAL, SG_ALERT, "Decode bucket " << bucket.gen_index_str() );
+    sprintf( debugdir, "./vectordecode/%s", bucket.gen_index_str().c_str() );
+
+    tgIntersectionGenerator* pig = new tgIntersectionGenerator( debugdir, 0, 1, GetTextureInfo );
+    tgChopper results( work_dir, bucket.gen_index() );
+
+    // diagnostics are off unless asked for - the sinks only create the
+    // debug directory when they write to it
+    tgIntersectionDebugSink* sink = NULL;
+    if ( debug_mode == "ogr" ) {
+        sink = new tgIntersectionOgrSink( debugdir );
+    } else if ( debug_mode == "ring" ) {
+        sink = new tgIntersectionRingSink( debugdir, debug_ring_size );
+    }
+    pig->SetDebugSink( sink );
+
+    bool ok = true;
+    for ( unsigned int i=0; ok && i<areaDefs.size(); i++ ) {
+        GDALDataset *poDS = datasets[i];
+
+        if( poDS != NULL ) {
+            OGRLayer  *poLayer;
+            for (int j=0; ok && j<poDS->GetLayerCount(); j++) {
+                poLayer = poDS->GetLayer(j);
+                ok = processLayer(poLayer, bucket, i, pig );
+            }
+        }
+    }
+
+    if ( !ok ) {
+        delete pig;
+        delete sink;
+        return false;
+    }
+
+    // add some additional Variables to the intersection generator
+    // cleaning parameters
+    // texture mode
+    // simplify parameters
+    // and add some data access
+    // get skeleton segments
+    // get skin segments
+    // delta height info may be needed....
+    // maybe needs a new class entirely based on intersectiongenerator.
+
+    // we have all of the data - execute the intersection generator
+    // don't clean the OSM map data - as we don't want to generate intersections
+    // that don't really exist ( bridges and tunnels )
+    // OSM data should have correct intersection nodes already.
+    // - they need them to do routing.
+    pig->Execute();
+
+    // now retreive the polygons in reverse z-order.  store them in lists
+    std::map<int, tgPolygonSetList> polygons;
+
+    for ( tgintersectionedge_it it = pig->edges_begin(); it != pig->edges_end(); it++ ) {
+        polygons[(*it)->GetZorder()].push_back( (*it)->GetPoly("complete") );
+    }
+
+    // clip them in z order
+    tgAccumulator accum;
+    std::map<int, tgPolygonSetList>::reverse_iterator pmap_it;
+
+    for ( pmap_it = polygons.rbegin(); pmap_it != polygons.rend(); pmap_it++ ) {
+        std::vector<tgPolygonSet>::iterator poly_it;
+        for ( poly_it = (*pmap_it).second.begin(); poly_it != (*pmap_it).second.end(); poly_it++ ) {
+            tgPolygonSet current = (*poly_it);
+
+            accum.Diff_and_Add_cgal( current );
+
+            // only add to output list if the clip left us with a polygon.
+            // the chopper writes each chunk as it's added
+            if ( !current.isEmpty() ) {
+                results.Add( current );
+            }
+        }
+    }
+
+    delete pig;
+    delete sink;
+
+    return true;
+}
+
+// The buckets to decode.  Threads take the next bucket until none are left.
+class BucketQueue {
+public:
+    BucketQueue() : next(0) {}
+
+    void push(const SGBucket& b) {
+        buckets.push_back(b);
+    }
+
+    unsigned int size() const {
+        return buckets.size();
+    }
+
+    bool pop(SGBucket& b) {
+        SGGuard<SGMutex> g(lock);
+
+        if (next >= buckets.size()) {
+            return false;
+        }
+
+        b = buckets[next++];
+        return true;
+    }
+
+    // a decoder failed - hand out no more buckets
+    void abort() {
+        SGGuard<SGMutex> g(lock);
+
+        next = buckets.size();
+    }
+
+private:
+    std::vector<SGBucket>   buckets;
+    unsigned int            next;
+    SGMutex                 lock;
+};
+
+// Each decoder opens every datasource once, and keeps the handles for all
+// of the buckets it decodes.  OGR layers hold the spatial filter and read
+// position, so the handles can't be shared between threads.
+class VectorDecoder : public SGThread
+{
+public:
+    VectorDecoder( const std::string& dd, const std::string& wd, BucketQueue& q ) :
+        work_dir(wd), queue(q), failed(false)
+    {
+        for ( unsigned int i=0; i<areaDefs.size(); i++ ) {
+            char pathname[256];
+
+            sprintf( pathname, "%s/%s", dd.c_str(), areaDefs[i].datasource.c_str() );
+            SG_LOG( SG_GENERAL, SG_DEBUG, "Opening datasource " << pathname << " for reading." );
+
+            GDALDataset* poDS = (GDALDataset*)GDALOpenEx( pathname, GDAL_OF_VECTOR, NULL, NULL, NULL );
+            if ( poDS == NULL ) {
+                SG_LOG( SG_GENERAL, SG_ALERT, "Failed opening datasource " << pathname );
+            }
+            datasets.push_back( poDS );
+        }
+    }
+
+    ~VectorDecoder() {
+        for ( unsigned int i=0; i<datasets.size(); i++ ) {
+            if ( datasets[i] ) {
+                GDALClose( datasets[i] );
+            }
+        }
+    }
+
+    // set if a bucket failed to decode - checked once joined
+    bool hasFailed() const {
+        return failed;
+    }
+
+    const SGBucket& failedBucket() const {
+        return failed_bucket;
+    }
+
+private:
+    virtual void run();
+
+    std::string                 work_dir;
+    BucketQueue&                queue;
+    bool                        failed;
+    SGBucket                    failed_bucket;
+
+    // this thread's dataset handles - one per areaDef
+    std::vector<GDALDataset*>   datasets;
+};
+
+void VectorDecoder::run()
+{
+    SGBucket bucket;
+
+    while ( queue.pop(bucket) ) {
+        if ( !decodeBucket( bucket, datasets, work_dir ) ) {
+            failed        = true;
+            failed_bucket = bucket;
+            queue.abort();
+        }
+    }
 }
 
 void usage(char* progname) {
@@ -285,6 +496,13 @@ void usage(char* progname) {
     SG_LOG( SG_GENERAL, SG_ALERT, "        spatial query extents" );
     SG_LOG( SG_GENERAL, SG_ALERT, "--texture-lines" );
     SG_LOG( SG_GENERAL, SG_ALERT, "        Enable textured lines" );
+    SG_LOG( SG_GENERAL, SG_ALERT, "--debug=none|ogr|ring" );
+    SG_LOG( SG_GENERAL, SG_ALERT, "        Write the intersection diagnostics of each bucket to ./vectordecode :" );
+    SG_LOG( SG_GENERAL, SG_ALERT, "        never ( default ), always, or only for buckets that fail" );
+    SG_LOG( SG_GENERAL, SG_ALERT, "--debug-ring-size=N" );
+    SG_LOG( SG_GENERAL, SG_ALERT, "        Number of features kept for --debug=ring ( default is 10000 )" );
+    SG_LOG( SG_GENERAL, SG_ALERT, "--threads[=N]" );
+    SG_LOG( SG_GENERAL, SG_ALERT, "        Decode N buckets at once ( default is one per core )" );
     SG_LOG( SG_GENERAL, SG_ALERT, "" );
     SG_LOG( SG_GENERAL, SG_ALERT, "<work_dir>" );
     SG_LOG( SG_GENERAL, SG_ALERT, "        Directory to put the polygon files in" );
@@ -367,6 +585,10 @@ int main( int argc, char **argv ) {
             work_dir = arg.substr(11);
         } else if (arg.find("--config=") == 0) {
             config = arg.substr(9);
+        } else if (arg.find("--debug=") == 0) {
+            debug_mode = arg.substr(8);
+        } else if (arg.find("--debug-ring-size=") == 0) {
+            debug_ring_size = atoi( arg.substr(18).c_str() );
         } else if (arg.find("--threads=") == 0) {
             num_threads = atoi( arg.substr(10).c_str() );
         } else if (arg.find("--threads") == 0) {
@@ -374,6 +596,15 @@ int main( int argc, char **argv ) {
         }
     }
 
+    if ( num_threads < 1 ) {
+        num_threads = 1;
+    }
+
+    if ( debug_mode != "none" && debug_mode != "ogr" && debug_mode != "ring" ) {
+        SG_LOG( SG_GENERAL, SG_ALERT, "Unknown debug mode '" << debug_mode << "'" );
+        usage(progname);
+    }
+
     SG_LOG( SG_GENERAL, SG_ALERT, "vector-decode version " << getTGVersion() << "\n" );
     
     if (argc<4) {
@@ -431,99 +662,47 @@ int main( int argc, char **argv ) {
     
     SG_LOG( SG_GENERAL, SG_ALERT, "Area extents: is covered by " << bucketList.size() << " buckets" );
 
-    // I don't think this is threadsafe - pre create the workdir tree
+    // SGPath::create_dir isn't threadsafe - pre create the workdir tree
+    // before the decoders start writing into it
     CreateWorkDirs( work_dir, bucketList);
-        
-    // as long as we have buckets to parse, do so
-    for (unsigned int i=0; i<bucketList.size(); i++) {
-        SGBucket bucket = bucketList[i];
-        char debugdir[128];
 
-        SG_LOG( SG_GENERAL, SG_ALERT, "Decode bucket " << bucket.gen_index_str() );        
-        sprintf( debugdir, "./vectordecode/%s", bucket.gen_index_str().c_str() );
+    if ( debug_mode != "none" ) {
+        SGPath( "./vectordecode/dummy" ).create_dir( 0755 );
+    }
         
-        tgIntersectionGenerator* pig = new tgIntersectionGenerator( debugdir, 0, 1, GetTextureInfo );
-        tgChopper results( work_dir, bucket.gen_index() );
+    if ( (unsigned int)num_threads > bucketList.size() ) {
+        num_threads = std::max( (unsigned int)bucketList.size(), 1u );
+    }
 
-        GDALDataset *poDS;        
-        for ( unsigned int i=0; i<areaDefs.size(); i++ ) {
-            char pathname[256];
-            
-            sprintf( pathname, "%s/%s", data_dir.c_str(), areaDefs[i].datasource.c_str() );
-            SG_LOG( SG_GENERAL, SG_ALERT, "Opening datasource " << pathname << " for reading." );
-            poDS = (GDALDataset*)GDALOpenEx( pathname, GDAL_OF_VECTOR, NULL, NULL, NULL );
-
-            if( poDS != NULL ) {
-                OGRLayer  *poLayer;
-                for (int j=0;j<poDS->GetLayerCount();j++) {
-                    poLayer = poDS->GetLayer(j);
-                    processLayer(poLayer, bucket, results, i, pig );
-                }
-                
-                GDALClose( poDS );
-            } else {
-                SG_LOG( SG_GENERAL, SG_ALERT, "Failed opening datasource " << pathname );
-            }
-        }        
-        
-        // add some additional Variables to the intersection generator
-        // cleaning parameters
-        // texture mode
-        // simplify parameters
-        // and add some data access
-        // get skeleton segments
-        // get skin segments
-        // delta height info may be needed....
-        // maybe needs a new class entirely based on intersectiongenerator.
-        
-        // we have all of the data - execute the intersection generator
-        // don't clean the OSM map data - as we don't want to generate intersections
-        // that don't really exist ( bridges and tunnels )
-        // OSM data should have correct intersection nodes already.
-        // - they need them to do routing.        
-        // lockOgr->lock();
-        pig->Execute();
-        
-        // now retreive the polygons in reverse z-order.  store them in lists
-        std::map<int, tgPolygonSetList*> polygons;
-        
-        for ( tgintersectionedge_it it = pig->edges_begin(); it != pig->edges_end(); it++ ) {
-            tgPolygonSet poly = (*it)->GetPoly("complete");
-            int          zo   = (*it)->GetZorder();
-            
-            if ( polygons.find( zo ) == polygons.end() ) {
-                // add new polygon list at this zorder
-                polygons[zo] = new tgPolygonSetList;
-            }
-            polygons[zo]->push_back( poly );
-        }
-        
-        // clip them in z order
-        tgAccumulator accum;    
-        std::map<int, tgPolygonSetList*>::reverse_iterator pmap_it;
-        
-        for ( pmap_it = polygons.rbegin(); pmap_it != polygons.rend(); pmap_it++ ) {
-            std::vector<tgPolygonSet>::iterator poly_it;            
-            for ( poly_it = (*pmap_it).second->begin(); poly_it != (*pmap_it).second->end(); poly_it++ ) {
-                tgPolygonSet current = (*poly_it);
-                //current.RemoveDups();
+    BucketQueue queue;
+    for ( unsigned int i=0; i<bucketList.size(); i++ ) {
+        queue.push( bucketList[i] );
+    }
 
-	        SGTimeStamp stamp;
-                stamp.stamp();
+    SG_LOG( SG_GENERAL, SG_ALERT, "Decoding " << queue.size() << " buckets with " << num_threads << " threads" );
 
-                accum.Diff_and_Add_cgal( current );
-                
-                // only add to output list if the clip left us with a polygon
-                if ( !current.isEmpty() ) {
-                    results.Add( current, stamp );
-                }
-            }
+    std::vector<VectorDecoder *> decoders;
+    for ( int i=0; i<num_threads; i++ ) {
+        VectorDecoder* decoder = new VectorDecoder( data_dir, work_dir, queue );
+        decoder->start();
+        decoders.push_back( decoder );
+    }
+
+    bool failed = false;
+    for ( unsigned int i=0; i<decoders.size(); i++ ) {
+        decoders[i]->join();
+
+        if ( decoders[i]->hasFailed() ) {
+            SG_LOG( SG_GENERAL, SG_ALERT, "Decoding bucket " << decoders[i]->failedBucket().gen_index_str() << " failed" );
+            failed = true;
         }
-        
-        results.Save(false);
-        
-        delete pig;
+        delete decoders[i];
     }
-    
+
+    if ( failed ) {
+        SG_LOG( SG_GENERAL, SG_ALERT, "Aborting!" );
+        return 1;
+    }
+
     return 0;
 }
@@ -0,0 +1,344 @@
+// tgArrayVoidBench.cxx -- compare the tgArray void filling algorithms
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// Writes synthetic elevation arrays with different void patterns, then
+// loads each one and fills the voids with every tgArray::VoidFillMethod,
+// reporting the time taken, and the mean error against the surface the
+// voids were cut out of.
+//
+// Then checks VOID_FILL_NEAREST against a brute force fill, which searches
+// every sample for every void, on smaller arrays of check_size.  Each void
+// must get the value of a sample at the nearest distance ( ties can go
+// either way ).  Returns non zero if any don't.
+//
+// usage: tgArrayVoidBench <work_dir> [size] [queries] [check_size]
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include <simgear/compiler.h>
+#include <simgear/constants.h>
+#include <simgear/bucket/newbucket.hxx>
+#include <simgear/debug/logstream.hxx>
+#include <simgear/io/lowlevel.hxx>
+#include <simgear/misc/sg_path.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+#include <terragear/tg_array.hxx>
+
+typedef enum {
+    PATTERN_SCATTERED,      // 5% single cell voids
+    PATTERN_LAKE,           // one large round void in the middle
+    PATTERN_SHADOW,         // long diagonal radar shadow bands
+    PATTERN_EDGE,           // the eastern half is void
+    NUM_PATTERNS
+} VoidPattern;
+
+static const char* patternNames[NUM_PATTERNS] = {
+    "scattered", "lake", "shadow", "edge"
+};
+
+// smooth terrain to cut the voids from
+static int surface( int col, int row )
+{
+    return (int)( 500.0 + 300.0 * sin( col * 0.013 ) * cos( row * 0.021 ) + 0.05 * col );
+}
+
+static bool isVoid( VoidPattern pattern, int col, int row, int size, unsigned long& seed )
+{
+    switch ( pattern ) {
+        case PATTERN_SCATTERED:
+            seed = seed * 1103515245 + 12345;
+            return ( (seed / 65536) % 100 ) < 5;
+
+        case PATTERN_LAKE: {
+            double dx = col - size * 0.5;
+            double dy = row - size * 0.5;
+            return ( dx * dx + dy * dy ) < ( size * 0.3 ) * ( size * 0.3 );
+        }
+
+        case PATTERN_SHADOW:
+            return ( ( col + 2 * row ) % ( size / 4 + 1 ) ) < size / 20 + 1;
+
+        case PATTERN_EDGE:
+            return col >= size / 2;
+
+        default:
+            return false;
+    }
+}
+
+// write the array in the format gdalchop / hgtchop produce
+static bool writeArray( const std::string& base, const SGBucket& b, VoidPattern pattern, int size )
+{
+    gzFile fp;
+    if ( (fp = gzopen( (base + ".arr.gz").c_str(), "wb1" )) == NULL ) {
+        SG_LOG(SG_GENERAL, SG_ALERT, "cannot open " << base << ".arr.gz for writing!");
+        return false;
+    }
+
+    int           step = 1;
+    unsigned long seed = 1;
+
+    int32_t header = 0x54474152; // 'TGAR'
+    sgWriteLong(fp, header);
+    sgWriteInt(fp, (int)( b.get_corner( SG_BUCKET_SW ).getLongitudeDeg() * 3600.0 ));
+    sgWriteInt(fp, (int)( b.get_corner( SG_BUCKET_SW ).getLatitudeDeg()  * 3600.0 ));
+    sgWriteInt(fp, size); sgWriteInt(fp, step);
+    sgWriteInt(fp, size); sgWriteInt(fp, step);
+
+    for ( int x = 0; x < size; ++x ) {
+        for ( int y = 0; y < size; ++y ) {
+            sgWriteShort(fp, isVoid( pattern, x, y, size, seed ) ? -32768 : surface( x, y ) );
+        }
+    }
+
+    gzclose(fp);
+    return true;
+}
+
+static void runMethod( const std::string& base, const SGBucket& b, VoidPattern pattern, int size,
+                       tgArray::VoidFillMethod method, const char* name, int queries )
+{
+    tgArray array;
+
+    if ( !array.open( base ) ) {
+        SG_LOG(SG_GENERAL, SG_ALERT, "cannot open " << base );
+        return;
+    }
+    array.parse( b );
+
+    // count the voids, and time closest_nonvoid_elev on the unfilled array
+    unsigned long seed  = 1;
+    int           voids = 0;
+    for ( int x = 0; x < size; ++x ) {
+        for ( int y = 0; y < size; ++y ) {
+            if ( isVoid( pattern, x, y, size, seed ) ) {
+                voids++;
+            }
+        }
+    }
+
+    SGTimeStamp start = SGTimeStamp::now();
+    for ( int i = 0; i < queries; i++ ) {
+        double lon = array.get_originx() + ( (i * 7919) % size ) * array.get_col_step();
+        double lat = array.get_originy() + ( (i * 104729) % size ) * array.get_row_step();
+        array.closest_nonvoid_elev( lon, lat );
+    }
+    double queryTime = ( SGTimeStamp::now() - start ).toSecs();
+
+    start = SGTimeStamp::now();
+    array.remove_voids( method );
+    double fillTime = ( SGTimeStamp::now() - start ).toSecs();
+
+    // error of the filled cells against the original surface
+    double error = 0.0;
+    seed = 1;
+    for ( int x = 0; x < size; ++x ) {
+        for ( int y = 0; y < size; ++y ) {
+            if ( isVoid( pattern, x, y, size, seed ) ) {
+                error += fabs( (double)( array.get_array_elev( x, y ) - surface( x, y ) ) );
+            }
+        }
+    }
+
+    SG_LOG(SG_GENERAL, SG_ALERT, patternNames[pattern] << " / " << name << " : " <<
+           voids << " voids filled in " << fillTime << "s, mean error " << ( voids ? error / voids : 0.0 ) << "m, " <<
+           queries << " closest_nonvoid_elev in " << queryTime << "s" );
+
+    array.close();
+}
+
+// squared distance between two samples, with the same column scaling as
+// remove_voids_nearest
+static double sampleDist( int c0, int r0, int c1, int r1, double wx, double wy )
+{
+    double dx = wx * ( c0 - c1 );
+    double dy = wy * ( r0 - r1 );
+
+    return dx * dx + dy * dy;
+}
+
+// fill every void from the nearest sample, by checking all of them
+static void bruteForceFill( const std::vector<int>& in, int cols, int rows, double wx, double wy,
+                            std::vector<int>& out, std::vector<double>& dist )
+{
+    std::vector<int> samples;
+
+    for ( int k = 0; k < cols * rows; k++ ) {
+        if ( in[k] > -9000 ) {
+            samples.push_back( k );
+        }
+    }
+
+    out  = in;
+    dist.assign( cols * rows, 0.0 );
+
+    for ( int k = 0; k < cols * rows; k++ ) {
+        if ( in[k] > -9000 ) {
+            continue;
+        }
+
+        double best = std::numeric_limits<double>::max();
+        for ( unsigned int s = 0; s < samples.size(); s++ ) {
+            double d = sampleDist( k / rows, k % rows, samples[s] / rows, samples[s] % rows, wx, wy );
+            if ( d < best ) {
+                best   = d;
+                out[k] = in[samples[s]];
+            }
+        }
+        dist[k] = best;
+    }
+}
+
+// is there a sample at distance d from void k with value elev
+static bool haveTie( const std::vector<int>& in, int cols, int rows, double wx, double wy,
+                     int k, double d, int elev )
+{
+    for ( int s = 0; s < cols * rows; s++ ) {
+        if ( in[s] > -9000 && in[s] == elev &&
+             sampleDist( k / rows, k % rows, s / rows, s % rows, wx, wy ) <= d * ( 1.0 + 1e-9 ) ) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int checkNearest( const std::string& base, const SGBucket& b, VoidPattern pattern, int size )
+{
+    tgArray array;
+
+    if ( !array.open( base ) ) {
+        SG_LOG(SG_GENERAL, SG_ALERT, "cannot open " << base );
+        return 1;
+    }
+    array.parse( b );
+
+    int cols = array.get_cols();
+    int rows = array.get_rows();
+
+    // as remove_voids_nearest - columns are closer together away from the equator
+    double lat = ( array.get_originy() + 0.5 * rows * array.get_row_step() ) / 3600.0;
+    double wx  = array.get_col_step() * cos( lat * SGD_DEGREES_TO_RADIANS );
+    double wy  = array.get_row_step();
+
+    std::vector<int> in( cols * rows );
+    for ( int x = 0; x < cols; ++x ) {
+        for ( int y = 0; y < rows; ++y ) {
+            in[x * rows + y] = array.get_array_elev( x, y );
+        }
+    }
+
+    std::vector<int>    brute;
+    std::vector<double> dist;
+
+    SGTimeStamp start = SGTimeStamp::now();
+    bruteForceFill( in, cols, rows, wx, wy, brute, dist );
+    double bruteTime = ( SGTimeStamp::now() - start ).toSecs();
+
+    start = SGTimeStamp::now();
+    array.remove_voids( tgArray::VOID_FILL_NEAREST );
+    double nearestTime = ( SGTimeStamp::now() - start ).toSecs();
+
+    int voids      = 0;
+    int mismatches = 0;
+    for ( int k = 0; k < cols * rows; k++ ) {
+        if ( in[k] > -9000 ) {
+            continue;
+        }
+        voids++;
+
+        int elev = array.get_array_elev( k / rows, k % rows );
+        if ( elev != brute[k] && !haveTie( in, cols, rows, wx, wy, k, dist[k], elev ) ) {
+            if ( mismatches < 10 ) {
+                SG_LOG(SG_GENERAL, SG_ALERT, "  " << patternNames[pattern] << " : void " << k / rows << ", " << k % rows <<
+                       " filled with " << elev << ", nearest sample is " << brute[k] );
+            }
+            mismatches++;
+        }
+    }
+
+    SG_LOG(SG_GENERAL, SG_ALERT, patternNames[pattern] << " check, " << size << " x " << size << " : " <<
+           voids << " voids, brute force " << bruteTime << "s, nearest " << nearestTime << "s, " <<
+           mismatches << " mismatches" );
+
+    array.close();
+
+    return mismatches;
+}
+
+int main( int argc, char **argv )
+{
+    sglog().setLogLevels( SG_ALL, SG_INFO );
+
+    if ( argc < 2 ) {
+        SG_LOG(SG_GENERAL, SG_ALERT, "Usage " << argv[0] << " <work_dir> [size] [queries]");
+        exit(-1);
+    }
+
+    std::string work_dir = argv[1];
+    int         size     = ( argc > 2 ) ? atoi( argv[2] ) : 1201;
+    int         queries  = ( argc > 3 ) ? atoi( argv[3] ) : 1000;
+    int         check    = ( argc > 4 ) ? atoi( argv[4] ) : 151;
+
+    if ( size < 16 ) {
+        size = 16;
+    }
+    if ( check < 16 ) {
+        check = 16;
+    }
+
+    SGPath sgp( work_dir );
+    sgp.append( "dummy" );
+    sgp.create_dir( 0755 );
+
+    SGBucket b( SGGeod::fromDeg( -120.1, 35.1 ) );
+
+    for ( int p = 0; p < NUM_PATTERNS; p++ ) {
+        std::string base = work_dir + "/voids_" + patternNames[p];
+
+        if ( !writeArray( base, b, (VoidPattern)p, size ) ) {
+            exit(1);
+        }
+
+        runMethod( base, b, (VoidPattern)p, size, tgArray::VOID_FILL_LINES,   "lines",   queries );
+        runMethod( base, b, (VoidPattern)p, size, tgArray::VOID_FILL_NEAREST, "nearest", queries );
+    }
+
+    int mismatches = 0;
+    for ( int p = 0; p < NUM_PATTERNS; p++ ) {
+        std::string base = work_dir + "/check_" + patternNames[p];
+
+        if ( !writeArray( base, b, (VoidPattern)p, check ) ) {
+            exit(1);
+        }
+
+        mismatches += checkNearest( base, b, (VoidPattern)p, check );
+    }
+
+    if ( mismatches ) {
+        SG_LOG(SG_GENERAL, SG_ALERT, "FAILED : " << mismatches << " voids not filled from the nearest sample" );
+        return 1;
+    }
+
+    return 0;
+}
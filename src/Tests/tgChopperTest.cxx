@@ -292,6 +292,8 @@ int main( int argc, char **argv ) {
 
     GDALClose(poDS);
 
+    results.logStats();
+
     char resDatasource[64];
     sprintf(resDatasource, "./%s", resultname.c_str() );
     
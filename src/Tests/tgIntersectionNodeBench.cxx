@@ -0,0 +1,186 @@
+// tgIntersectionNodeBench.cxx -- time the intersection node registry
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// Builds a synthetic dense grid of roads - <roads> east / west roads
+// crossing <roads> north / south roads - and
+//  - adds both ends of every grid segment to a tgIntersectionNodeList, the
+//    way tgIntersectionGenerator::Execute does, slightly jittered so some
+//    ends are only within the isEqual2D epsilon of their node.  The result
+//    is checked against, and timed with, a linear search of the nodes.
+//  - runs the whole tgIntersectionGenerator on the same roads.
+//
+// usage: tgIntersectionNodeBench [roads] [spacing_deg]
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <simgear/compiler.h>
+#include <simgear/debug/logstream.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+#include <terragear/tg_misc.hxx>
+#include <terragear/vector_intersections/tg_intersection_generator.hxx>
+
+static int GetTextureInfo( unsigned int type, bool cap, std::string& material, double& atlas_startu, double& atlas_endu, double& atlas_startv, double& atlas_endv, double& v_dist )
+{
+    material     = "Road";
+    atlas_startu = 0.0;
+    atlas_endu   = 1.0;
+    atlas_startv = 0.0;
+    atlas_endv   = 1.0;
+    v_dist       = 10.0;
+
+    return 0;
+}
+
+// the segment ends of the grid, in the order Execute would add them
+static void gridSegments( int roads, double spacing, std::vector<SGGeod>& ends )
+{
+    unsigned long seed = 1;
+
+    for ( int r = 0; r < roads; r++ ) {
+        for ( int c = 0; c < roads-1; c++ ) {
+            for ( int dir = 0; dir < 2; dir++ ) {
+                for ( int end = 0; end < 2; end++ ) {
+                    double along  = ( c + end ) * spacing;
+                    double across = r * spacing;
+
+                    // a tenth of the epsilon of jitter on some of the ends
+                    seed = seed * 1103515245 + 12345;
+                    double jitter = ( ( seed / 65536 ) % 3 ) * 0.0000001 - 0.0000001;
+
+                    if ( dir == 0 ) {
+                        ends.push_back( SGGeod::fromDeg( -120.0 + along + jitter, 35.0 + across ) );
+                    } else {
+                        ends.push_back( SGGeod::fromDeg( -120.0 + across, 35.0 + along + jitter ) );
+                    }
+                }
+            }
+        }
+    }
+}
+
+static tgIntersectionNode* linearFind( const std::vector<tgIntersectionNode*>& nodes, const SGGeod& loc )
+{
+    for ( unsigned int i=0; i<nodes.size(); i++ ) {
+        if ( SGGeod_isEqual2D( nodes[i]->GetPosition(), loc ) ) {
+            return nodes[i];
+        }
+    }
+
+    return NULL;
+}
+
+static bool benchNodeList( int roads, double spacing )
+{
+    std::vector<SGGeod> ends;
+    SGTimeStamp         start, end;
+
+    gridSegments( roads, spacing, ends );
+
+    // hashed registry
+    tgIntersectionNodeList              nodelist;
+    std::vector<tgIntersectionNode*>    found;
+
+    start.stamp();
+    for ( unsigned int i=0; i<ends.size(); i++ ) {
+        found.push_back( nodelist.Add( ends[i] ) );
+    }
+    end.stamp();
+
+    long hashed = ( end - start ).toUSecs();
+
+    // linear search over the same nodes - the old implementation
+    std::vector<tgIntersectionNode*> linear;
+    bool ok = true;
+
+    start.stamp();
+    for ( unsigned int i=0; i<ends.size(); i++ ) {
+        tgIntersectionNode* node = linearFind( linear, ends[i] );
+        if ( node == NULL ) {
+            node = nodelist[linear.size()];
+            linear.push_back( node );
+        }
+
+        if ( node != found[i] ) {
+            ok = false;
+        }
+    }
+    end.stamp();
+
+    long scanned = ( end - start ).toUSecs();
+
+    SG_LOG(SG_GENERAL, SG_ALERT, roads << "x" << roads << " grid : " << ends.size() << " segment ends, " << nodelist.size() << " nodes" );
+    SG_LOG(SG_GENERAL, SG_ALERT, "  hashed " << hashed / 1000 << " ms, linear " << scanned / 1000 << " ms" );
+
+    if ( !ok || linear.size() != nodelist.size() ) {
+        SG_LOG(SG_GENERAL, SG_ALERT, "  MISMATCH : linear search found " << linear.size() << " nodes" );
+        return false;
+    }
+
+    return true;
+}
+
+static void benchGenerator( int roads, double spacing )
+{
+    tgIntersectionGenerator* pig = new tgIntersectionGenerator( "./intersectionbench", 0, 0, GetTextureInfo );
+    SGTimeStamp              start, end;
+
+    for ( int r = 0; r < roads; r++ ) {
+        double across = r * spacing;
+        SGGeod ew0 = SGGeod::fromDeg( -120.0, 35.0 + across );
+        SGGeod ew1 = SGGeod::fromDeg( -120.0 + ( roads-1 ) * spacing, 35.0 + across );
+        SGGeod ns0 = SGGeod::fromDeg( -120.0 + across, 35.0 );
+        SGGeod ns1 = SGGeod::fromDeg( -120.0 + across, 35.0 + ( roads-1 ) * spacing );
+
+        // the roads cross between their nodes - the network finds the
+        // intersections
+        pig->Insert( ew0, ew1, 8.0, 0, 0 );
+        pig->Insert( ns0, ns1, 8.0, 0, 0 );
+    }
+
+    start.stamp();
+    pig->Execute();
+    end.stamp();
+
+    SG_LOG(SG_GENERAL, SG_ALERT, "  generator " << ( end - start ).toUSecs() / 1000 << " ms, " << pig->edges_size() << " edges" );
+
+    delete pig;
+}
+
+int main( int argc, char **argv )
+{
+    sglog().setLogLevels( SG_ALL, SG_ALERT );
+
+    int    roads   = ( argc > 1 ) ? atoi( argv[1] ) : 60;
+    double spacing = ( argc > 2 ) ? atof( argv[2] ) : 0.001;
+
+    if ( roads < 2 ) {
+        roads = 2;
+    }
+
+    // the linear search grows with the square of the grid size
+    bool ok = true;
+    for ( int n = std::max( roads / 4, 2 ); n <= roads; n *= 2 ) {
+        ok = benchNodeList( n, spacing ) && ok;
+    }
+
+    benchGenerator( roads, spacing );
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
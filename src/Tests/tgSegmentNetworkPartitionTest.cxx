@@ -0,0 +1,206 @@
+// tgSegmentNetworkPartitionTest.cxx -- check that cleaning a segment network
+//                                      in cells matches cleaning it whole
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// Builds a synthetic network of airport markings with clean flags 1, as
+// genapts850 does for its linear features, and cleans it
+//  - in one arrangement
+//  - in cells, on one thread
+//  - in cells, on <threads> threads
+// The cleaned edges must be the same each time.
+//
+// The network is made so that crossings land on both sides of, and right
+// on, the cell borders :
+//  - east / west and north / south lines spanning several cells, split
+//    into pieces whose ends don't line up with the cells.  Some lines lie
+//    exactly on a cell border.
+//  - long diagonals, each a single segment.  Their midpoint is in one cell,
+//    and they cross the lines in many others.
+//  - short spurs ending a little short of, or a little past, a line on a
+//    cell border, for clustering and finger extension.
+//
+// usage: tgSegmentNetworkPartitionTest [cell_size_deg] [threads]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include <simgear/compiler.h>
+#include <simgear/debug/logstream.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+#include <terragear/vector_intersections/tg_segmentnetwork.hxx>
+
+#define ORIGIN_LON      (-120.0)
+#define ORIGIN_LAT      (35.0)
+#define NUM_CELLS       (5)
+
+// matching edge ends may differ by this much, in degrees
+#define END_EPSILON     (0.0000001)
+
+static SGGeod point( double x, double y )
+{
+    return SGGeod::fromDeg( ORIGIN_LON + x, ORIGIN_LAT + y );
+}
+
+static void buildNetwork( double cell, std::vector<segnetEdge>& network )
+{
+    double extent = NUM_CELLS * cell;
+
+    // the lines - the first of each direction on the lower left border of the
+    // grid, which is the lower left of the input.  Pieces are 1.3 cells long,
+    // starting at a different offset on each line
+    for ( int l = 0; l < 2 * NUM_CELLS; l++ ) {
+        double across = ( l % 4 == 0 ) ? ( l / 2 ) * cell : ( l * 0.5 + 0.17 ) * cell;
+        double along  = -( l % 3 ) * 0.4 * cell;
+
+        while ( along < extent ) {
+            double from = std::max( along, 0.0 );
+            double to   = std::min( along + 1.3 * cell, extent );
+
+            network.push_back( segnetEdge( point( from, across ), point( to, across ), 0.15, 0, 1 ) );
+            network.push_back( segnetEdge( point( across, from ), point( across, to ), 0.15, 0, 1 ) );
+            along += 1.3 * cell;
+        }
+    }
+
+    // the diagonals - one segment each, across most of the grid
+    network.push_back( segnetEdge( point( 0.23 * cell, 0.31 * cell ), point( 4.61 * cell, 3.87 * cell ), 0.15, 0, 1 ) );
+    network.push_back( segnetEdge( point( 4.72 * cell, 0.12 * cell ), point( 0.44 * cell, 4.93 * cell ), 0.15, 0, 1 ) );
+    network.push_back( segnetEdge( point( 0.05 * cell, 2.71 * cell ), point( 3.33 * cell, 0.08 * cell ), 0.15, 0, 1 ) );
+
+    // the spurs - from the cell to the west of a border line, ending a
+    // little short of it or a little past it
+    for ( int c = 2; c < NUM_CELLS; c += 2 ) {
+        double border = c * cell;
+
+        for ( int s = 0; s < 2; s++ ) {
+            double y     = ( c - 1.6 + s * 1.1 ) * cell;
+            double reach = s ? 0.000001 : -0.000001;
+
+            network.push_back( segnetEdge( point( border - 0.6 * cell, y ), point( border + reach, y ), 0.15, 0, 1 ) );
+        }
+    }
+}
+
+static long clean( const std::vector<segnetEdge>& network, double cell, unsigned int threads, std::vector<segnetEdge>& cleaned )
+{
+    SGTimeStamp      start, end;
+    tgSegmentNetwork net( 1, "partition_test" );
+
+    if ( cell > 0.0 ) {
+        net.SetPartitions( cell, 0.0001, threads );
+    }
+
+    start.stamp();
+    for ( unsigned int i = 0; i < network.size(); i++ ) {
+        net.Add( network[i].start, network[i].end, network[i].width, network[i].zorder, network[i].type );
+    }
+    net.Execute();
+    end.stamp();
+
+    cleaned.assign( net.output_begin(), net.output_end() );
+
+    return ( end - start ).toUSecs();
+}
+
+static bool sameEnd( const SGGeod& a, const SGGeod& b )
+{
+    return ( fabs( a.getLongitudeDeg() - b.getLongitudeDeg() ) < END_EPSILON &&
+             fabs( a.getLatitudeDeg()  - b.getLatitudeDeg() )  < END_EPSILON );
+}
+
+static bool sameEdge( const segnetEdge& a, const segnetEdge& b )
+{
+    return ( sameEnd( a.start, b.start ) && sameEnd( a.end, b.end ) ) ||
+           ( sameEnd( a.start, b.end )   && sameEnd( a.end, b.start ) );
+}
+
+// edges of a missing from b
+static unsigned int missing( const std::vector<segnetEdge>& a, const std::vector<segnetEdge>& b, const char* from )
+{
+    unsigned int count = 0;
+
+    for ( unsigned int i = 0; i < a.size(); i++ ) {
+        bool found = false;
+
+        for ( unsigned int j = 0; j < b.size() && !found; j++ ) {
+            found = sameEdge( a[i], b[j] );
+        }
+
+        if ( !found ) {
+            SG_LOG( SG_GENERAL, SG_ALERT, "  edge " << a[i].start << " - " << a[i].end << " missing from " << from );
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static unsigned int compare( const std::vector<segnetEdge>& whole, const std::vector<segnetEdge>& cells, const char* name )
+{
+    unsigned int mismatches = 0;
+
+    if ( whole.size() != cells.size() ) {
+        SG_LOG( SG_GENERAL, SG_ALERT, "  " << name << " : " << cells.size() << " edges, whole network " << whole.size() );
+        mismatches++;
+    }
+
+    mismatches += missing( whole, cells, name );
+    mismatches += missing( cells, whole, "whole network" );
+
+    return mismatches;
+}
+
+int main( int argc, char **argv )
+{
+    double       cell    = 0.01;
+    unsigned int threads = 4;
+
+    sglog().setLogLevels( SG_ALL, SG_ALERT );
+
+    if ( argc > 1 ) {
+        cell = atof( argv[1] );
+    }
+    if ( argc > 2 ) {
+        threads = atoi( argv[2] );
+    }
+
+    std::vector<segnetEdge> network;
+    buildNetwork( cell, network );
+
+    std::vector<segnetEdge> whole, single, threaded;
+    long whole_time    = clean( network, 0.0,  1,       whole );
+    long single_time   = clean( network, cell, 1,       single );
+    long threaded_time = clean( network, cell, threads, threaded );
+
+    SG_LOG( SG_GENERAL, SG_ALERT, network.size() << " segments, " << whole.size() << " cleaned edges" );
+    SG_LOG( SG_GENERAL, SG_ALERT, "  whole network        " << whole_time / 1000 << " ms" );
+    SG_LOG( SG_GENERAL, SG_ALERT, "  cells, 1 thread      " << single_time / 1000 << " ms" );
+    SG_LOG( SG_GENERAL, SG_ALERT, "  cells, " << threads << " threads     " << threaded_time / 1000 << " ms" );
+
+    unsigned int mismatches = compare( whole, single, "cells, 1 thread" ) +
+                              compare( whole, threaded, "cells, threaded" );
+
+    if ( mismatches ) {
+        SG_LOG( SG_GENERAL, SG_ALERT, "FAILED : " << mismatches << " mismatches" );
+        return EXIT_FAILURE;
+    }
+
+    SG_LOG( SG_GENERAL, SG_ALERT, "PASSED" );
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,229 @@
+// tgSpatialHashTest.cxx -- check the tolerance of the tg_unique_* sets
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// Adds points that straddle the old rounding boundaries and the grid cell
+// boundaries of tgSpatialHashSet, and checks that points closer than
+// PROXIMITY_EPSILON are merged, points further apart are not, and that the
+// insertion indices are stable.  Checks that a TGNetNode set keeps the data
+// of the first node added.  Finally compares a few thousand random
+// points against a brute force search.
+//
+// usage: tgSpatialHashTest
+
+#include <cstdlib>
+#include <vector>
+
+#include <simgear/debug/logstream.hxx>
+#include <simgear/math/SGMath.hxx>
+
+#include <terragear/tg_unique_geod.hxx>
+#include <terragear/tg_unique_vec2f.hxx>
+#include <terragear/tg_unique_vec3d.hxx>
+#include <terragear/tg_unique_tgnetnode.hxx>
+
+static int failures = 0;
+
+#define CHECK( cond )                                                       \
+    if ( !( cond ) ) {                                                      \
+        SG_LOG(SG_GENERAL, SG_ALERT, "FAILED line " << __LINE__ << " : " #cond ); \
+        failures++;                                                         \
+    }
+
+// one tenth of the epsilon
+static const double tenth = PROXIMITY_EPSILON / 10.0;
+
+static void testRoundingBoundary( void )
+{
+    UniqueSGGeodSet nodes;
+
+    // 0.000005 is where the old hash rounded up or down - these are 2e-7
+    // apart, but used to be kept as two nodes
+    unsigned int a = nodes.add( SGGeod::fromDeg( -120.000005 - tenth, 35.0 ) );
+    unsigned int b = nodes.add( SGGeod::fromDeg( -120.000005 + tenth, 35.0 ) );
+
+    CHECK( a == 0 );
+    CHECK( b == a );
+    CHECK( nodes.size() == 1 );
+
+    // same in latitude, on the other side of the equator
+    unsigned int c = nodes.add( SGGeod::fromDeg( 10.0, -0.000005 - tenth ) );
+    unsigned int d = nodes.add( SGGeod::fromDeg( 10.0, -0.000005 + tenth ) );
+
+    CHECK( c == 1 );
+    CHECK( d == c );
+    CHECK( nodes.size() == 2 );
+}
+
+static void testCellBoundary( void )
+{
+    UniqueSGGeodSet nodes;
+
+    // the cells are PROXIMITY_EPSILON wide - straddle the cell corner at
+    // the origin, where floor() changes sign, in both coordinates
+    unsigned int a = nodes.add( SGGeod::fromDeg(  tenth,  tenth ) );
+    CHECK( nodes.add( SGGeod::fromDeg( -tenth,  tenth ) ) == a );
+    CHECK( nodes.add( SGGeod::fromDeg(  tenth, -tenth ) ) == a );
+    CHECK( nodes.add( SGGeod::fromDeg( -tenth, -tenth ) ) == a );
+    CHECK( nodes.size() == 1 );
+
+    // and a cell corner away from the origin
+    double lon = 7.0 * PROXIMITY_EPSILON + 45.0;
+    double lat = 3.0 * PROXIMITY_EPSILON - 60.0;
+
+    unsigned int b = nodes.add( SGGeod::fromDeg( lon - tenth, lat + tenth ) );
+    CHECK( nodes.find( SGGeod::fromDeg( lon + tenth, lat - tenth ) ) == (int)b );
+    CHECK( nodes.find( SGGeod::fromDeg( lon + 8 * tenth, lat - tenth ) ) == (int)b );
+    CHECK( nodes.size() == 2 );
+}
+
+static void testTolerance( void )
+{
+    UniqueSGGeodSet nodes;
+
+    unsigned int a = nodes.add( SGGeod::fromDeg( 12.5, 47.25 ) );
+
+    // just inside, and just outside the epsilon in one coordinate
+    CHECK( nodes.find( SGGeod::fromDeg( 12.5 + 0.9 * PROXIMITY_EPSILON, 47.25 ) ) == (int)a );
+    CHECK( nodes.find( SGGeod::fromDeg( 12.5, 47.25 - 0.9 * PROXIMITY_EPSILON ) ) == (int)a );
+    CHECK( nodes.find( SGGeod::fromDeg( 12.5 + 1.5 * PROXIMITY_EPSILON, 47.25 ) ) == -1 );
+    CHECK( nodes.find( SGGeod::fromDeg( 12.5, 47.25 + 2.5 * PROXIMITY_EPSILON ) ) == -1 );
+
+    // points two cells away are new nodes
+    unsigned int b = nodes.add( SGGeod::fromDeg( 12.5 + 2.5 * PROXIMITY_EPSILON, 47.25 ) );
+    CHECK( b == 1 );
+    CHECK( nodes.size() == 2 );
+}
+
+static void testStableIndex( void )
+{
+    UniqueSGGeodSet nodes;
+
+    // two nodes 1.6 epsilon apart, and a point within epsilon of both -
+    // the first node added wins, whichever cell is probed first
+    unsigned int a = nodes.add( SGGeod::fromDeg( 1.0 + 0.8 * PROXIMITY_EPSILON, 2.0 ) );
+    unsigned int b = nodes.add( SGGeod::fromDeg( 1.0 - 0.8 * PROXIMITY_EPSILON, 2.0 ) );
+
+    CHECK( a == 0 );
+    CHECK( b == 1 );
+    CHECK( nodes.add( SGGeod::fromDeg( 1.0, 2.0 ) ) == a );
+
+    // indices don't move as more nodes are added
+    for ( int i = 0; i < 1000; i++ ) {
+        nodes.add( SGGeod::fromDeg( -30.0 + i * 0.001, 20.0 ) );
+    }
+    CHECK( nodes.find( SGGeod::fromDeg( 1.0 - 0.8 * PROXIMITY_EPSILON, 2.0 ) ) == (int)b );
+    CHECK( nodes.find( SGGeod::fromDeg( -30.0 + 500 * 0.001, 20.0 ) ) == 502 );
+    CHECK( nodes[502].getLongitudeDeg() == -30.0 + 500 * 0.001 );
+    CHECK( nodes.size() == 1002 );
+}
+
+static void testVectors( void )
+{
+    UniqueSGVec3dSet vec3d;
+
+    // all three coordinates must match
+    unsigned int a = vec3d.add( SGVec3d( 4000000.000005 - tenth, -1.0, 5000000.0 ) );
+    CHECK( vec3d.add( SGVec3d( 4000000.000005 + tenth, -1.0, 5000000.0 ) ) == a );
+    CHECK( vec3d.find( SGVec3d( 4000000.000005, -1.0 + 2.0 * PROXIMITY_EPSILON, 5000000.0 ) ) == -1 );
+    CHECK( vec3d.get_list().size() == 1 );
+
+    UniqueSGVec2fSet vec2f;
+
+    unsigned int b = vec2f.add( SGVec2f( 0.25f, 0.75f ) );
+    CHECK( vec2f.add( SGVec2f( 0.25f, 0.75f ) ) == b );
+    CHECK( vec2f.add( SGVec2f( 0.5f, 0.75f ) ) == 1 );
+}
+
+static void testNetNodes( void )
+{
+    UniqueTGNetNodeSet nodes;
+    TGNetEdge          edge;
+
+    edge.material  = "pa_taxiway";
+    edge.width     = 10;
+    edge.start_pos = SGGeod::fromDeg( -120.000005 - tenth, 35.0 );
+    edge.end_pos   = SGGeod::fromDeg( -120.001, 35.0 );
+
+    TGNetNode first( edge.start_pos );
+    first.AddEdgeOriginating( edge, edge.end_pos );
+
+    // merged across the old rounding boundary - the first node, with its
+    // edges, is the one kept
+    unsigned int a = nodes.add( first );
+    unsigned int b = nodes.add( TGNetNode( SGGeod::fromDeg( -120.000005 + tenth, 35.0 ) ) );
+
+    CHECK( b == a );
+    CHECK( nodes.size() == 1 );
+    CHECK( nodes[a].GetEdges().size() == 1 );
+    CHECK( nodes.find( TGNetNode( edge.end_pos ) ) == -1 );
+}
+
+// compare with an exhaustive search over points packed a few cells apart
+static void testBruteForce( void )
+{
+    UniqueSGGeodSet     nodes;
+    std::vector<SGGeod> points;
+    unsigned long       seed = 1;
+
+    for ( int i = 0; i < 5000; i++ ) {
+        seed = seed * 1103515245 + 12345;
+        double lon = -0.00002 + ( (seed / 65536) % 4000 ) * tenth;
+        seed = seed * 1103515245 + 12345;
+        double lat =  0.00002 - ( (seed / 65536) % 4000 ) * tenth;
+
+        SGGeod p = SGGeod::fromDeg( lon, lat );
+        int    expected = -1;
+
+        for ( unsigned int j = 0; j < points.size(); j++ ) {
+            if ( fabs( points[j].getLongitudeDeg() - lon ) < PROXIMITY_EPSILON &&
+                 fabs( points[j].getLatitudeDeg()  - lat ) < PROXIMITY_EPSILON ) {
+                expected = j;
+                break;
+            }
+        }
+
+        unsigned int index = nodes.add( p );
+        if ( expected < 0 ) {
+            CHECK( index == points.size() );
+            points.push_back( p );
+        } else {
+            CHECK( index == (unsigned int)expected );
+        }
+    }
+
+    CHECK( nodes.size() == points.size() );
+}
+
+int main( int argc, char **argv )
+{
+    sglog().setLogLevels( SG_ALL, SG_INFO );
+
+    testRoundingBoundary();
+    testCellBoundary();
+    testTolerance();
+    testStableIndex();
+    testVectors();
+    testNetNodes();
+    testBruteForce();
+
+    if ( failures ) {
+        SG_LOG(SG_GENERAL, SG_ALERT, failures << " checks failed" );
+        return EXIT_FAILURE;
+    }
+
+    SG_LOG(SG_GENERAL, SG_ALERT, "all checks passed" );
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,283 @@
+// tgTesselateBench.cxx -- time tgPolygon::Tesselate with and without the
+//                         inexact kernel
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// Loads the polygons of each datasource given - e.g. the chopped
+// genapts850 output in work/AirportArea/<bucket dir> - and tesselates them
+//  - with the exact kernel only, the old behaviour.
+//  - with the inexact kernel first, falling back to the exact kernel.
+// Both runs must produce the same number of triangles, covering the same
+// area, for each polygon.  The fallback ratio and times are reported.
+//
+// Without a datasource, a synthetic set of airport like polygons is used :
+// runways, pavements with holes, curved taxiways, and a few self
+// intersecting outlines that need the exact kernel.
+//
+// usage: tgTesselateBench [datasource ...]
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include <ogrsf_frmts.h>
+#include <gdal_priv.h>
+
+#include <simgear/compiler.h>
+#include <simgear/constants.h>
+#include <simgear/debug/logstream.hxx>
+#include <simgear/math/sg_geodesy.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+#include <terragear/tg_polygon.hxx>
+
+// polygons are in WGS84, as genapts850 writes them
+static tgContour ringToContour( OGRLinearRing* ring, bool hole )
+{
+    tgContour contour;
+
+    // shapefile rings are closed - skip the repeated first point
+    int count = ring->getNumPoints();
+    if ( count > 1 && ring->getX(0) == ring->getX(count-1) && ring->getY(0) == ring->getY(count-1) ) {
+        count--;
+    }
+
+    for ( int i = 0; i < count; i++ ) {
+        contour.AddNode( SGGeod::fromDeg( ring->getX(i), ring->getY(i) ) );
+    }
+    contour.SetHole( hole );
+
+    return contour;
+}
+
+static void addPolygon( OGRPolygon* poGeometry, tgpolygon_list& polys )
+{
+    tgPolygon poly;
+
+    poly.AddContour( ringToContour( poGeometry->getExteriorRing(), false ) );
+    for ( int i = 0; i < poGeometry->getNumInteriorRings(); i++ ) {
+        poly.AddContour( ringToContour( poGeometry->getInteriorRing(i), true ) );
+    }
+    poly.SetId( polys.size() );
+
+    polys.push_back( poly );
+}
+
+static void loadDatasource( const char* path, tgpolygon_list& polys )
+{
+    GDALDataset* poDS = (GDALDataset*)GDALOpenEx( path, GDAL_OF_VECTOR, NULL, NULL, NULL );
+    if ( poDS == NULL ) {
+        SG_LOG( SG_GENERAL, SG_ALERT, "Failed opening datasource " << path );
+        return;
+    }
+
+    for ( int l = 0; l < poDS->GetLayerCount(); l++ ) {
+        OGRLayer*   poLayer = poDS->GetLayer(l);
+        OGRFeature* poFeature;
+
+        poLayer->ResetReading();
+        while ( ( poFeature = poLayer->GetNextFeature() ) != NULL ) {
+            OGRGeometry* poGeometry = poFeature->GetGeometryRef();
+
+            if ( poGeometry ) {
+                switch ( wkbFlatten( poGeometry->getGeometryType() ) ) {
+                    case wkbPolygon:
+                        addPolygon( (OGRPolygon*)poGeometry, polys );
+                        break;
+
+                    case wkbMultiPolygon: {
+                        OGRMultiPolygon* multi = (OGRMultiPolygon*)poGeometry;
+                        for ( int i = 0; i < multi->getNumGeometries(); i++ ) {
+                            addPolygon( (OGRPolygon*)multi->getGeometryRef(i), polys );
+                        }
+                        break;
+                    }
+
+                    default:
+                        break;
+                }
+            }
+
+            OGRFeature::DestroyFeature( poFeature );
+        }
+    }
+
+    GDALClose( poDS );
+}
+
+// a rectangle of length x width meters, centered on center
+static tgContour rectangle( const SGGeod& center, double heading, double length, double width, bool hole )
+{
+    tgContour contour;
+    double    corners[4][2] = { { -0.5, -0.5 }, { 0.5, -0.5 }, { 0.5, 0.5 }, { -0.5, 0.5 } };
+
+    for ( int i = 0; i < 4; i++ ) {
+        double along  = corners[i][0] * length;
+        double across = corners[i][1] * width;
+        double dist   = sqrt( along*along + across*across );
+        double course = heading + atan2( across, along ) * SGD_RADIANS_TO_DEGREES;
+
+        contour.AddNode( SGGeodesy::direct( center, course, dist ) );
+    }
+    contour.SetHole( hole );
+
+    return contour;
+}
+
+static void syntheticPolygons( tgpolygon_list& polys )
+{
+    for ( int apt = 0; apt < 400; apt++ ) {
+        SGGeod center  = SGGeod::fromDeg( -120.0 + ( apt % 20 ) * 0.1, 35.0 + ( apt / 20 ) * 0.1 );
+        double heading = ( apt * 37 ) % 180;
+        tgPolygon poly;
+
+        // runway
+        poly.AddContour( rectangle( center, heading, 3000.0, 45.0, false ) );
+        poly.SetId( polys.size() );
+        polys.push_back( poly );
+
+        // apron, with a building in it
+        SGGeod apron = SGGeodesy::direct( center, heading + 90.0, 300.0 );
+        poly = tgPolygon();
+        poly.AddContour( rectangle( apron, heading, 600.0, 200.0, false ) );
+        poly.AddContour( rectangle( apron, heading, 100.0, 50.0, true ) );
+        poly.SetId( polys.size() );
+        polys.push_back( poly );
+
+        // a taxiway curving from the runway to the apron
+        tgContour inner, outer;
+        for ( int i = 0; i <= 32; i++ ) {
+            double course = heading + i * 90.0 / 32;
+            inner.AddNode( SGGeodesy::direct( apron, course, 180.0 ) );
+            outer.AddNode( SGGeodesy::direct( apron, course, 200.0 ) );
+        }
+        for ( int i = outer.GetSize()-1; i >= 0; i-- ) {
+            inner.AddNode( outer.GetNode(i) );
+        }
+        poly = tgPolygon();
+        poly.AddContour( inner );
+        poly.SetId( polys.size() );
+        polys.push_back( poly );
+
+        // every tenth airport has a badly drawn outline that crosses itself
+        if ( apt % 10 == 0 ) {
+            tgContour outline = rectangle( center, heading, 4000.0, 800.0, false );
+
+            // the last two corners swapped make a bowtie
+            tgContour crossed;
+            crossed.AddNode( outline.GetNode(0) );
+            crossed.AddNode( outline.GetNode(1) );
+            crossed.AddNode( outline.GetNode(3) );
+            crossed.AddNode( outline.GetNode(2) );
+
+            poly = tgPolygon();
+            poly.AddContour( crossed );
+            poly.SetId( polys.size() );
+            polys.push_back( poly );
+        }
+    }
+}
+
+static double triangleArea( const tgPolygon& poly )
+{
+    double area = 0.0;
+
+    for ( unsigned int t = 0; t < poly.Triangles(); t++ ) {
+        SGGeod p0 = poly.GetTriNode( t, 0 );
+        SGGeod p1 = poly.GetTriNode( t, 1 );
+        SGGeod p2 = poly.GetTriNode( t, 2 );
+
+        area += fabs( ( p1.getLongitudeDeg() - p0.getLongitudeDeg() ) * ( p2.getLatitudeDeg() - p0.getLatitudeDeg() ) -
+                      ( p2.getLongitudeDeg() - p0.getLongitudeDeg() ) * ( p1.getLatitudeDeg() - p0.getLatitudeDeg() ) ) / 2.0;
+    }
+
+    return area;
+}
+
+static long tesselate( tgpolygon_list& polys, bool exact )
+{
+    SGTimeStamp start, end;
+
+    tgPolygon::SetTesselateExact( exact );
+    tgPolygon::ResetTesselateStats();
+
+    start.stamp();
+    for ( unsigned int i = 0; i < polys.size(); i++ ) {
+        polys[i].Tesselate( false );
+    }
+    end.stamp();
+
+    return ( end - start ).toUSecs();
+}
+
+int main( int argc, char **argv )
+{
+    sglog().setLogLevels( SG_ALL, SG_ALERT );
+
+    tgpolygon_list corpus;
+
+    if ( argc > 1 ) {
+        GDALAllRegister();
+
+        for ( int i = 1; i < argc; i++ ) {
+            loadDatasource( argv[i], corpus );
+        }
+    } else {
+        syntheticPolygons( corpus );
+    }
+
+    if ( corpus.empty() ) {
+        SG_LOG( SG_GENERAL, SG_ALERT, "No polygons to tesselate" );
+        return EXIT_FAILURE;
+    }
+
+    unsigned int nodes = 0;
+    for ( unsigned int i = 0; i < corpus.size(); i++ ) {
+        nodes += corpus[i].TotalNodes();
+    }
+
+    tgpolygon_list exact   = corpus;
+    tgpolygon_list inexact = corpus;
+
+    long exact_time   = tesselate( exact, true );
+    long inexact_time = tesselate( inexact, false );
+
+    unsigned long fast, fallback;
+    tgPolygon::GetTesselateStats( fast, fallback );
+
+    // the same triangles should come out either way
+    unsigned int mismatches = 0;
+    for ( unsigned int i = 0; i < corpus.size(); i++ ) {
+        double a = triangleArea( exact[i] );
+        double b = triangleArea( inexact[i] );
+
+        if ( exact[i].Triangles() != inexact[i].Triangles() || fabs( a - b ) > 1e-9 * a ) {
+            SG_LOG( SG_GENERAL, SG_ALERT, "  poly " << i << " : exact " << exact[i].Triangles() << " triangles, inexact " << inexact[i].Triangles() );
+            mismatches++;
+        }
+    }
+
+    SG_LOG( SG_GENERAL, SG_ALERT, corpus.size() << " polygons, " << nodes << " nodes" );
+    SG_LOG( SG_GENERAL, SG_ALERT, "  exact   " << exact_time / 1000 << " ms" );
+    SG_LOG( SG_GENERAL, SG_ALERT, "  inexact " << inexact_time / 1000 << " ms : " << fast << " polygons, " << fallback << " fell back to exact ( " <<
+                                  100.0 * fallback / ( fast + fallback ) << "% )" );
+
+    if ( mismatches ) {
+        SG_LOG( SG_GENERAL, SG_ALERT, "  MISMATCH : " << mismatches << " polygons differ" );
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}